@@ -0,0 +1,544 @@
+/*
+ * Filename: capper.c
+ *
+ * Purpose: libcapper API (capper.h) on top of the wrsort internals
+ *
+ * An event keeps two contexts: the entries as ingested, and a copy of them
+ * rated by capper_event_compute(), the way -sweep rates each grid point.
+ * Once rated, a submission, Disq: change or withdrawal is carried over to
+ * the copy by collate_update(), which redoes only what the change reaches;
+ * settings lines make compute start over from the ingested entries.
+ */
+#include "wrsort.h"
+#include "capper.h"
+
+/************************************************/
+/* data types */
+
+struct _capper_db {
+    player_db_t *db;
+    int events; // live events, which point into the player pool
+};
+
+struct _capper_event {
+    capper_db_t *cdb;
+    context_t *parsed; // entries as ingested
+    context_t *ctx;    // rated copy of parsed
+    int computed;      // ctx is current
+    int committed;
+};
+
+/************************************************/
+/* functions */
+
+int
+capper_api_version(void)
+{
+    return CAPPER_API_VERSION;
+}
+
+void
+capper_free(void *buf)
+{
+    free(buf);
+}
+
+/************************************************/
+// player DB
+
+capper_db_t *
+capper_db_create(void)
+{
+    capper_db_t *cdb = calloc(1, sizeof(capper_db_t));
+
+    if (!cdb) {
+        return 0;
+    }
+    cdb->db = player_db_create();
+    if (!cdb->db) {
+        free(cdb);
+        return 0;
+    }
+    return cdb;
+}
+
+void
+capper_db_free(capper_db_t *cdb)
+{
+    if (cdb) {
+        player_db_free(cdb->db);
+        free(cdb);
+    }
+}
+
+int
+capper_db_load(capper_db_t *cdb, const char *text, size_t len)
+{
+    if (!cdb || (!text && len)) {
+        return CAPPER_ERR_ARG;
+    }
+    if (cdb->events) {
+        return CAPPER_ERR_STATE;
+    }
+    init_players(cdb->db);
+    cdb->db->binary = FALSE;
+    if (len == 0) {
+        return cdb->db->player_cnt;
+    }
+    // the readers only read the image, as they do a read-only mapping
+    if (db_read_image(cdb->db, (char *)text, len) < 0) {
+        return CAPPER_ERR_PARSE;
+    }
+    return cdb->db->player_cnt;
+}
+
+// capper_db_write: the DB into a buffer, as text or a binary snapshot
+int
+capper_db_write(capper_db_t *cdb, char **text, size_t *len, int binary)
+{
+    FILE *file;
+    int count;
+
+    if (!cdb || !text || !len) {
+        return CAPPER_ERR_ARG;
+    }
+    file = open_memstream(text, len);
+    if (!file) {
+        return CAPPER_ERR_NOMEM;
+    }
+    if (binary) {
+        count = db_write_binary(cdb->db, file);
+    } else {
+        count = db_write(cdb->db, file);
+    }
+    if (fclose(file) || count != cdb->db->player_cnt) {
+        free(*text);
+        *text = 0;
+        *len = 0;
+        return CAPPER_ERR_NOMEM;
+    }
+    return CAPPER_OK;
+}
+
+int
+capper_db_serialize(capper_db_t *cdb, char **text, size_t *len)
+{
+    return capper_db_write(cdb, text, len, FALSE);
+}
+
+int
+capper_db_serialize_binary(capper_db_t *cdb, char **buf, size_t *len)
+{
+    return capper_db_write(cdb, buf, len, TRUE);
+}
+
+int
+capper_db_player_count(capper_db_t *cdb)
+{
+    if (!cdb) {
+        return CAPPER_ERR_ARG;
+    }
+    return cdb->db->player_cnt;
+}
+
+void
+capper_player_fill(capper_db_t *cdb, player_t *p, capper_player_t *out)
+{
+    memset(out, 0, sizeof(capper_player_t));
+    out->id = p->id;
+    snprintf(out->psn, sizeof(out->psn), "%s", p->psn);
+    snprintf(out->name, sizeof(out->name), "%s", p->name);
+    snprintf(out->country, sizeof(out->country), "%s", p->country);
+    out->div = p->div;
+    out->sub_div = p->sub_div;
+    out->rookie = player_is_rookie(cdb->db, p->id);
+    out->rating = p->rating;
+    out->real_rating = p->real_rating;
+    out->total_weight = p->total_weight;
+    out->event_count = p->event_count;
+    out->dq_count = p->dq_count;
+    out->verified_count = p->verified_count;
+}
+
+int
+capper_player_by_id(capper_db_t *cdb, unsigned id, capper_player_t *out)
+{
+    player_t *p;
+
+    if (!cdb || !out) {
+        return CAPPER_ERR_ARG;
+    }
+    p = player_get(cdb->db, id);
+    if (id == NULL_PLAYER || !p || !p->valid) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    capper_player_fill(cdb, p, out);
+    return CAPPER_OK;
+}
+
+int
+capper_player_by_psn(capper_db_t *cdb, const char *psn, capper_player_t *out)
+{
+    player_t *p;
+
+    if (!cdb || !psn || !out) {
+        return CAPPER_ERR_ARG;
+    }
+    p = player_lookup_by_psn(cdb->db, (char *)psn);
+    if (!p || !p->valid) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    capper_player_fill(cdb, p, out);
+    return CAPPER_OK;
+}
+
+/************************************************/
+// events
+
+capper_event_t *
+capper_event_create(capper_db_t *cdb)
+{
+    capper_event_t *ev;
+
+    if (!cdb) {
+        return 0;
+    }
+    ev = calloc(1, sizeof(capper_event_t));
+    if (!ev) {
+        return 0;
+    }
+    ev->cdb = cdb;
+    ev->parsed = context_create(cdb->db);
+    ev->ctx = context_create(cdb->db);
+    if (!ev->parsed || !ev->ctx) {
+        context_free(ev->parsed);
+        context_free(ev->ctx);
+        free(ev);
+        return 0;
+    }
+    ev->parsed->echo = 0; // nothing goes to the caller's stdout
+    ev->ctx->echo = 0;
+    cdb->events++;
+    return ev;
+}
+
+void
+capper_event_free(capper_event_t *ev)
+{
+    if (ev) {
+        ev->cdb->events--;
+        context_free(ev->parsed);
+        context_free(ev->ctx);
+        free(ev);
+    }
+}
+
+int
+capper_event_parse(capper_event_t *ev, const char *text, size_t len)
+{
+    FILE *file;
+
+    if (!ev || (!text && len)) {
+        return CAPPER_ERR_ARG;
+    }
+    if (ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    if (len == 0) {
+        return ev->parsed->entry_cnt;
+    }
+    // same line splitting as an event file
+    file = fmemopen((char *)text, len, "r");
+    if (!file) {
+        return CAPPER_ERR_NOMEM;
+    }
+    scan_event(ev->parsed, file);
+    fclose(file);
+    ev->computed = FALSE;
+    return ev->parsed->entry_cnt;
+}
+
+// capper_event_update
+// carry one entry change over to the rated copy, if there is one
+void
+capper_event_update(capper_event_t *ev, unsigned player_id, entry_t *next)
+{
+    if (ev->computed && ev->ctx->run_mode == RUN_MODE_EVENT) {
+        collate_update(ev->ctx, player_id, next);
+    } else {
+        ev->computed = FALSE;
+    }
+}
+
+// a submission field is pasted into an event line, so it must be one word:
+// whitespace would let it carry labels of its own
+int
+capper_word(const char *str)
+{
+    return (*str && !strpbrk(str, " \t\r\n\f\v"));
+}
+
+int
+capper_event_submit(capper_event_t *ev, const char *psn, const char *time, const char *disq)
+{
+    char line[MAX_LINE_LEN];
+    entry_t *entry, *prior;
+    unsigned count;
+
+    if (!ev || !psn || !time) {
+        return CAPPER_ERR_ARG;
+    }
+    if (ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    if (strlen(psn) >= MAX_NAME_LEN || strpbrk(psn, "\"\r\n")) {
+        return CAPPER_ERR_ARG;
+    }
+    if (!capper_word(time) || (disq && !capper_word(disq))) {
+        return CAPPER_ERR_ARG;
+    }
+    entry = entry_get(ev->parsed, ev->parsed->entry_cnt);
+    if (!entry) {
+        return CAPPER_ERR_NOMEM;
+    }
+    memset(entry, 0, sizeof(entry_t));
+    snprintf(line, MAX_LINE_LEN, "PSN: \"%s\" Time: %s Disq: %s\n", psn, time, disq ? disq : "ok");
+    count = ev->parsed->entry_cnt;
+    event_process_line(ev->parsed, line, entry);
+    if (ev->parsed->entry_cnt == count) {
+        return CAPPER_ERR_PARSE;
+    }
+    prior = entry_find(ev->parsed, entry);
+    if (prior != entry) { // resubmitted: the new entry takes the old one's place
+        *prior = *entry;
+        ev->parsed->entry_cnt--;
+    }
+    capper_event_update(ev, prior->player_id, prior);
+    return ev->parsed->entry_cnt;
+}
+
+int
+capper_event_disq(capper_event_t *ev, const char *psn, const char *disq)
+{
+    player_t *p;
+    entry_t key, *entry;
+
+    if (!ev || !psn || !disq) {
+        return CAPPER_ERR_ARG;
+    }
+    if (ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    p = player_lookup_by_psn(ev->cdb->db, (char *)psn);
+    if (!p) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    key.player_id = p->id;
+    entry = entry_find(ev->parsed, &key);
+    if (!entry) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    entry->dq = dq_parse((char *)disq);
+    capper_event_update(ev, entry->player_id, entry);
+    return CAPPER_OK;
+}
+
+int
+capper_event_withdraw(capper_event_t *ev, const char *psn)
+{
+    player_t *p;
+    int idx;
+
+    if (!ev || !psn) {
+        return CAPPER_ERR_ARG;
+    }
+    if (ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    p = player_lookup_by_psn(ev->cdb->db, (char *)psn);
+    if (!p) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    idx = entry_index(ev->parsed, p->id);
+    if (idx < 0) {
+        return CAPPER_ERR_NOT_FOUND;
+    }
+    entry_remove(ev->parsed, idx);
+    capper_event_update(ev, p->id, 0);
+    return ev->parsed->entry_cnt;
+}
+
+int
+capper_event_compute(capper_event_t *ev)
+{
+    if (!ev) {
+        return CAPPER_ERR_ARG;
+    }
+    if (ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    if (ev->computed) {
+        return CAPPER_OK; // entry changes since were carried over
+    }
+    context_copy(ev->ctx, ev->parsed);
+    if (ev->ctx->run_mode == RUN_MODE_EVENT) {
+        collate_stats(ev->ctx);
+    }
+    ev->computed = TRUE;
+    return CAPPER_OK;
+}
+
+int
+capper_event_info(capper_event_t *ev, capper_event_info_t *out)
+{
+    context_t *ctx;
+
+    if (!ev || !out) {
+        return CAPPER_ERR_ARG;
+    }
+    ctx = (ev->computed ? ev->ctx : ev->parsed);
+    memset(out, 0, sizeof(capper_event_info_t));
+    out->week = ctx->event.week;
+    out->season = ctx->event.season;
+    out->final = (ctx->event.status == STATUS_FINAL);
+    out->report = (ctx->run_mode == RUN_MODE_REPORT);
+    out->entry_cnt = ctx->entry_cnt;
+    out->weight = ctx->event.weight;
+    out->squeeze = ctx->event.squeeze;
+    out->scoot = ctx->event.scoot;
+    snprintf(out->description, sizeof(out->description), "%s", ctx->event.description);
+    snprintf(out->outfile, sizeof(out->outfile), "%s", ctx->event.outfile);
+    snprintf(out->statfile, sizeof(out->statfile), "%s", ctx->event.statfile);
+    return CAPPER_OK;
+}
+
+int
+capper_event_standings(capper_event_t *ev, int div, capper_standing_t *out, unsigned max)
+{
+    entry_iter_t iter;
+    entry_t *e;
+    capper_standing_t *s;
+    unsigned count = 0;
+
+    if (!ev || div < DIV_ALL || div > DIV_COUNT || (!out && max)) {
+        return CAPPER_ERR_ARG;
+    }
+    if (!ev->computed) {
+        return CAPPER_ERR_STATE;
+    }
+    for (e = entry_get_first(ev->ctx, &iter, ev->ctx->ov_head, div, ITER_DQ_ALL); e; e = entry_get_next(&iter)) {
+        if (count < max) {
+            s = &out[count];
+            memset(s, 0, sizeof(capper_standing_t));
+            s->player_id = e->player_id;
+            snprintf(s->psn, sizeof(s->psn), "%s", e->player->psn);
+            s->div = entry_div(e);
+            s->place = e->place;
+            s->overall_place = e->overall_place;
+            s->points = e->points;
+            s->dq = !dq_ok(e->dq);
+            s->time_ms = time_to_usec(&e->time);
+            s->rating = e->rating;
+            s->hcp_delta = e->hcp_delta;
+            s->prov_div = e->prov_div;
+        }
+        count++;
+    }
+    return count;
+}
+
+int
+capper_event_thresholds(capper_event_t *ev, int div, capper_threshold_t *out)
+{
+    stat_t *stat;
+
+    if (!ev || !out || div < 1 || div > DIV_COUNT) {
+        return CAPPER_ERR_ARG;
+    }
+    if (!ev->computed) {
+        return CAPPER_ERR_STATE;
+    }
+    stat = &ev->ctx->div_stat[div];
+    memset(out, 0, sizeof(capper_threshold_t));
+    out->count = stat->count;
+    out->par_ms = time_to_usec(&stat->par);
+    out->gold_ms = time_to_usec(&stat->gold);
+    out->silver_ms = time_to_usec(&stat->silver);
+    out->bronze_ms = time_to_usec(&stat->bronze);
+    return CAPPER_OK;
+}
+
+int
+capper_event_render(capper_event_t *ev, capper_render_e what, char **text, size_t *len)
+{
+    context_t *ctx;
+    event_status_e status;
+    FILE *file;
+
+    if (!ev || !text || !len) {
+        return CAPPER_ERR_ARG;
+    }
+    if (!ev->computed) {
+        return CAPPER_ERR_STATE;
+    }
+    ctx = ev->ctx;
+    file = open_memstream(text, len);
+    if (!file) {
+        return CAPPER_ERR_NOMEM;
+    }
+    if (ctx->run_mode == RUN_MODE_REPORT) {
+        if (what == CAPPER_RENDER_RESULTS) {
+            // a final report promotes as it prints; leave that to commit
+            status = ctx->event.status;
+            ctx->event.status = STATUS_PROVISIONAL;
+            dump_promotion_report(ctx, file, FALSE);
+            ctx->event.status = status;
+        }
+    } else if (ctx->run_mode == RUN_MODE_EVENT) {
+        if (what == CAPPER_RENDER_RESULTS && ctx->event.week == EVENT_QUALIFIER) {
+            dump_qualifier(ctx, file);
+        } else if (what == CAPPER_RENDER_RESULTS) {
+            dump_event(ctx, file);
+        } else {
+            dump_stats(ctx, file, what == CAPPER_RENDER_STATS);
+        }
+    }
+    if (fclose(file)) {
+        free(*text);
+        *text = 0;
+        *len = 0;
+        return CAPPER_ERR_NOMEM;
+    }
+    return CAPPER_OK;
+}
+
+int
+capper_event_commit(capper_event_t *ev)
+{
+    context_t *ctx;
+    FILE *file;
+
+    if (!ev) {
+        return CAPPER_ERR_ARG;
+    }
+    if (!ev->computed || ev->committed) {
+        return CAPPER_ERR_STATE;
+    }
+    ctx = ev->ctx;
+    if (ctx->run_mode == RUN_MODE_REPORT) {
+        if (ctx->event.status != STATUS_FINAL) {
+            return CAPPER_OK; // a preview: wrsort leaves the DB alone too
+        }
+        file = fopen("/dev/null", "w");
+        if (!file) {
+            return CAPPER_ERR_NOMEM;
+        }
+        dump_promotion_report(ctx, file, FALSE);
+        fclose(file);
+    } else if (ctx->run_mode == RUN_MODE_DB_FIX) {
+        fix_all_weight(ctx->db, ctx->echo);
+    }
+    db_update(ctx);
+    ev->committed = TRUE;
+    return CAPPER_OK;
+}
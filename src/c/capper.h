@@ -0,0 +1,159 @@
+/*
+ * Filename: capper.h
+ *
+ * Purpose: libcapper, the WRS handicapper as an in-process library
+ *
+ * Everything works on in-memory structures: a DB is loaded from a buffer,
+ * submissions are fed in as text, results are queried as structs or
+ * rendered into buffers, and the DB is serialized back into a buffer.
+ * No temp files, no subprocess.
+ *
+ * Handles are opaque.  The structs below only ever grow at the end, and
+ * CAPPER_API_VERSION is bumped when they do.
+ *
+ * Calls on one DB, and on events against it, must not overlap: parsing an
+ * event creates and renames players.  Separate DBs are independent.
+ */
+#ifndef CAPPER_H
+#define CAPPER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CAPPER_API __attribute__((visibility("default")))
+#else
+#define CAPPER_API
+#endif
+
+#define CAPPER_API_VERSION 5
+#define CAPPER_NAME_LEN 32
+
+// return codes: counts are >= 0, errors are < 0
+#define CAPPER_OK 0
+#define CAPPER_ERR_NOMEM -1
+#define CAPPER_ERR_ARG -2       // null handle/buffer, bad division
+#define CAPPER_ERR_PARSE -3     // submission rejected (e.g. racer not registered)
+#define CAPPER_ERR_NOT_FOUND -4 // no such player
+#define CAPPER_ERR_STATE -5     // not computed yet, or already committed
+
+typedef struct _capper_db capper_db_t;       // player DB
+typedef struct _capper_event capper_event_t; // one event rated against a DB
+
+typedef enum {
+    CAPPER_RENDER_RESULTS, // the outfile: results post, qualifier or promotion report
+    CAPPER_RENDER_STATS,   // the statfile: stats with per division detail
+    CAPPER_RENDER_SUMMARY, // the stats summary wrsort prints to stdout
+} capper_render_e;
+
+typedef struct _capper_player {
+    unsigned id;
+    char psn[CAPPER_NAME_LEN];
+    char name[CAPPER_NAME_LEN];    // GTPlanet user name
+    char country[CAPPER_NAME_LEN];
+    int div;                       // 0 until placed
+    int sub_div;                   // 0 gold, 1 silver, 2 bronze
+    int rookie;
+    double rating;
+    double real_rating;
+    double total_weight;
+    unsigned event_count;
+    unsigned dq_count;
+    unsigned verified_count;
+} capper_player_t;
+
+typedef struct _capper_event_info {
+    int week;          // 0 is the qualifier
+    int season;
+    int final;         // Event_Status: Final
+    int report;        // a promotion report rather than a race
+    unsigned entry_cnt;
+    double weight;
+    double squeeze;    // as used, after any auto adjust once computed
+    double scoot;
+    char description[128];
+    char outfile[128];  // Outfile:/Statfile: of the event text (v2)
+    char statfile[128];
+} capper_event_info_t;
+
+// one entry of an event, as placed by capper_event_compute()
+typedef struct _capper_standing {
+    unsigned player_id;
+    char psn[CAPPER_NAME_LEN];
+    int div;            // division the entry is placed in
+    int place;          // in its division, 0 if disqualified
+    int overall_place;
+    int points;
+    int dq;             // 0 if the entry counts
+    long time_ms;
+    double rating;      // event rating
+    double hcp_delta;   // rating against the racer's handicap
+    int prov_div;       // provisional division, from the time alone (v5)
+} capper_standing_t;
+
+// a division's time limits, for the entries of an event
+typedef struct _capper_threshold {
+    unsigned count;     // good entries placed in the division
+    long par_ms;        // fastest time of the division
+    long gold_ms;
+    long silver_ms;
+    long bronze_ms;     // slowest time of the division
+} capper_threshold_t;
+
+CAPPER_API int capper_api_version(void);
+CAPPER_API void capper_free(void *buf); // buffers returned by this library
+
+// capper_db_*: the player DB
+CAPPER_API capper_db_t *capper_db_create(void);
+CAPPER_API void capper_db_free(capper_db_t *db);
+// replace the DB with one in wrsort DB format, text or a binary snapshot
+// (v4) optionally followed by journal text; free its events first
+// returns: count of players, or error (CAPPER_ERR_PARSE: damaged snapshot)
+CAPPER_API int capper_db_load(capper_db_t *db, const char *text, size_t len);
+// the DB in wrsort DB format, in a buffer for capper_free()
+CAPPER_API int capper_db_serialize(capper_db_t *db, char **text, size_t *len);
+// the DB as a binary snapshot (v4), as wrsort -convert writes it
+CAPPER_API int capper_db_serialize_binary(capper_db_t *db, char **buf, size_t *len);
+CAPPER_API int capper_db_player_count(capper_db_t *db);
+CAPPER_API int capper_player_by_id(capper_db_t *db, unsigned id, capper_player_t *out);
+CAPPER_API int capper_player_by_psn(capper_db_t *db, const char *psn, capper_player_t *out);
+
+// capper_event_*: ingest, compute, query, render, commit
+CAPPER_API capper_event_t *capper_event_create(capper_db_t *db);
+CAPPER_API void capper_event_free(capper_event_t *ev);
+// event file text: settings and submission lines, in any number of calls
+// returns: count of entries so far
+CAPPER_API int capper_event_parse(capper_event_t *ev, const char *text, size_t len);
+// one submission; time as "1'15.721", disq as in event files (0 for none).
+// time and disq are single words, CAPPER_ERR_ARG otherwise.  replaces the
+// racer's earlier submission, if any
+CAPPER_API int capper_event_submit(capper_event_t *ev, const char *psn, const char *time, const char *disq);
+// change the Disq: status of the racer's entry
+CAPPER_API int capper_event_disq(capper_event_t *ev, const char *psn, const char *disq);
+// drop the racer's entry (v3)
+// returns: count of entries left
+CAPPER_API int capper_event_withdraw(capper_event_t *ev, const char *psn);
+// rate the entries.  Once computed, submit/disq/withdraw update the results
+// in place, redoing only what the change reaches; capper_event_parse()
+// needs another compute.  Either way the results match a fresh compute
+CAPPER_API int capper_event_compute(capper_event_t *ev);
+CAPPER_API int capper_event_info(capper_event_t *ev, capper_event_info_t *out);
+// entries of division div (0 for all) in time order, up to max of them
+// returns: count of entries in div, which may be more than max
+CAPPER_API int capper_event_standings(capper_event_t *ev, int div, capper_standing_t *out, unsigned max);
+// division div (1 up) of the computed event
+CAPPER_API int capper_event_thresholds(capper_event_t *ev, int div, capper_threshold_t *out);
+// render into a buffer for capper_free()
+CAPPER_API int capper_event_render(capper_event_t *ev, capper_render_e what, char **text, size_t *len);
+// fold the computed results into the DB, as a wrsort run does before
+// writing it; a promotion report only changes the DB once final
+CAPPER_API int capper_event_commit(capper_event_t *ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPPER_H */
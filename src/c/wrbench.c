@@ -0,0 +1,1528 @@
+/*
+ * Filename: wrbench.c
+ *
+ * Purpose: micro benchmarks for wrsort internals, and phase timings of a
+ *          weekly run over a synthetic league (-league)
+ *
+ * Includes wrsort.c (the library core, no main()) so the benchmarks call
+ * the same code the results program runs.
+ */
+#include "wrsort.c"
+
+#include <time.h>
+
+#define BENCH_LABEL_ITER 200000
+#define BENCH_STATS_COUNT (1 << 20)
+#define BENCH_STATS_ITER 50
+#define BENCH_DB_PLAYERS 200000
+#define BENCH_DB_THREADS 4
+#define BENCH_DB_WRITE_PLAYERS 1000000
+#define BENCH_NUM_COUNT 1000000
+#define BENCH_RENDER_ENTRIES 100000
+
+/************************************************/
+/* sample input, one line per format we parse */
+char *g_bench_lines[] = {
+    "Week: 37",
+    "Desc: M2 and the Streets of Willow",
+    "Outfile: week37.out",
+    "Statfile: week37.stat",
+    "Shape: standard",
+    "#Shape: custom -0.5 0.0 1.25 3.0 5.0 14.0",
+    "Weight: 1.0 # default 1.0",
+    "Event_Status: Final",
+    "PSN: Hasnain282 Time: 1'15.721 Disq: green",
+    "PSN: JamCar0ne Time: 1'18.167 Disq: unverified",
+    "User: \"poolhaas\" PSN: \"GTP_poolhaas\" Country: \"Belgium\" Status: rookie",
+    "Description: GTSport WRS Registry",
+    "Player_id: 7 User: \"Animera\" PSN: \"GTP_Animera\" Div: 1 Sub: S Rating: 1.467767 RRating: 1.542691 Weight: 9.000000 Events: 9 DQS: 0 VERI: 8  Country: \"New Zealand\"",
+    "History: Week: 9 Event_Status: F Rating: 1.717949 Weight: 1.000000 DISQ: SUBMITTED",
+    "Qual: Event_Status: F Rating: 2.100000 Weight: 2.000000",
+};
+
+/************************************************/
+// label_get as it was before label_lookup(): upper case copy, then a
+// prefix compare against every g_label entry in table order
+label_e
+label_get_linear(char *string)
+{
+    label_e label;
+    size_t offset;
+    char copy[MAX_STR_LEN];
+
+    if (!string) {
+        return LABEL_NONE;
+    }
+    offset = label_copy_toupper(copy, string);
+    if (offset == 0) {
+        return LABEL_NONE;
+    }
+
+    for (label = LABEL_COMMENT; label < LABEL_ENUM_COUNT; label++) {
+        if (!strncmp(copy, g_label[label], strlen(g_label[label]))) {
+            return label;
+        }
+    }
+    return LABEL_NONE;
+}
+
+double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// split the sample lines into null terminated tokens (labels and values)
+int
+bench_tokens(char ***tokens)
+{
+    int lines = sizeof(g_bench_lines) / sizeof(g_bench_lines[0]);
+    int count = 0, max = 0, i;
+    char *copy, *tok;
+
+    for (i = 0; i < lines; i++) {
+        max += strlen(g_bench_lines[i]) / 2 + 1;
+    }
+    *tokens = malloc(max * sizeof(char *));
+    for (i = 0; i < lines && *tokens; i++) {
+        copy = strdup(g_bench_lines[i]);
+        for (tok = strtok(copy, " \t"); tok && count < max; tok = strtok(0, " \t")) {
+            (*tokens)[count++] = tok;
+        }
+    }
+    return count;
+}
+
+int
+bench_label_check(void)
+{
+    label_e label;
+    char buf[MAX_STR_LEN];
+    int errors = 0;
+
+    for (label = LABEL_COMMENT; label < LABEL_ENUM_COUNT; label++) {
+        sprintf(buf, "%s:", g_label[label]);
+        if (label_get(buf) != label) {
+            fprintf(stderr, "label_get(\"%s\") = %d, expected %d\n", buf, label_get(buf), label);
+            errors++;
+        }
+        buf[0] = tolower(buf[0]);
+        if (label_get(buf) != label) {
+            fprintf(stderr, "label_get(\"%s\") = %d, expected %d\n", buf, label_get(buf), label);
+            errors++;
+        }
+    }
+    // prefix matches are no longer labels
+    if (label_get("STATUSX:") != LABEL_NONE || label_get("Carlos") != LABEL_NONE) {
+        fprintf(stderr, "label_get: prefix matched\n");
+        errors++;
+    }
+    return errors;
+}
+
+void
+bench_labels(void)
+{
+    char **tokens;
+    int count, i, j;
+    unsigned sink = 0;
+    double start, linear, lookup;
+
+    count = bench_tokens(&tokens);
+    for (i = 0; i < count; i++) {
+        if (label_get(tokens[i]) != label_get_linear(tokens[i])) {
+            printf("  differs: '%s' linear=%d lookup=%d\n", tokens[i],
+                   label_get_linear(tokens[i]), label_get(tokens[i]));
+        }
+    }
+
+    start = bench_now();
+    for (j = 0; j < BENCH_LABEL_ITER; j++) {
+        for (i = 0; i < count; i++) {
+            sink += label_get_linear(tokens[i]);
+        }
+    }
+    linear = bench_now() - start;
+
+    start = bench_now();
+    for (j = 0; j < BENCH_LABEL_ITER; j++) {
+        for (i = 0; i < count; i++) {
+            sink += label_get(tokens[i]);
+        }
+    }
+    lookup = bench_now() - start;
+
+    printf("label_get: %d tokens x %d\n", count, BENCH_LABEL_ITER);
+    printf("  linear: %8.2f ns/token\n", linear * 1e9 / ((double)count * BENCH_LABEL_ITER));
+    printf("  lookup: %8.2f ns/token (%.1fx)\n", lookup * 1e9 / ((double)count * BENCH_LABEL_ITER),
+           linear / lookup);
+    if (!sink) {
+        printf("\n");
+    }
+}
+
+/************************************************/
+// stats kernels: scalar against AVX2 on lap times around 1'20
+int
+bench_stats(void)
+{
+    int64_t *ms, sum[2], sumsq[2];
+    double *hcp, hsum[2], start, scalar, vector;
+    int i, errors = 0;
+    unsigned n;
+
+    ms = malloc(BENCH_STATS_COUNT * sizeof(int64_t));
+    hcp = malloc(BENCH_STATS_COUNT * sizeof(double));
+    if (!ms || !hcp) {
+        return 1;
+    }
+    srand(1);
+    for (i = 0; i < BENCH_STATS_COUNT; i++) {
+        ms[i] = 75000 + rand() % 20000;
+        hcp[i] = (rand() % 2000 - 1000) / 997.0;
+    }
+    for (n = 0; n < 11; n++) { // odd lengths exercise the tails
+        ms_moments_scalar(ms, n, &sum[0], &sumsq[0]);
+        ms_moments(ms, n, &sum[1], &sumsq[1]);
+        if (sum[0] != sum[1] || sumsq[0] != sumsq[1] ||
+                hcp_sum_scalar(hcp, n) != hcp_sum(hcp, n)) {
+            fprintf(stderr, "stats kernels differ at n=%u\n", n);
+            errors++;
+        }
+    }
+
+    start = bench_now();
+    for (i = 0; i < BENCH_STATS_ITER; i++) {
+        ms_moments_scalar(ms, BENCH_STATS_COUNT, &sum[0], &sumsq[0]);
+        hsum[0] = hcp_sum_scalar(hcp, BENCH_STATS_COUNT);
+    }
+    scalar = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < BENCH_STATS_ITER; i++) {
+        ms_moments(ms, BENCH_STATS_COUNT, &sum[1], &sumsq[1]);
+        hsum[1] = hcp_sum(hcp, BENCH_STATS_COUNT);
+    }
+    vector = bench_now() - start;
+    if (sum[0] != sum[1] || sumsq[0] != sumsq[1] || hsum[0] != hsum[1]) {
+        fprintf(stderr, "stats kernels differ\n");
+        errors++;
+    }
+
+    printf("stats kernels: %d entries x %d (%s)\n", BENCH_STATS_COUNT, BENCH_STATS_ITER,
+           stats_use_avx2() ? "avx2" : "scalar only");
+    printf("  scalar: %8.3f ns/entry\n", scalar * 1e9 / ((double)BENCH_STATS_COUNT * BENCH_STATS_ITER));
+    printf("  kernel: %8.3f ns/entry (%.1fx)\n", vector * 1e9 / ((double)BENCH_STATS_COUNT * BENCH_STATS_ITER),
+           scalar / vector);
+    free(ms);
+    free(hcp);
+    return errors;
+}
+
+/************************************************/
+// text DB reader: serial against chunks parsed in parallel
+void
+bench_db_fill(player_db_t *db, unsigned players)
+{
+    player_t *p;
+    char name[MAX_NAME_LEN], psn[MAX_NAME_LEN];
+    unsigned i, j;
+
+    srand(2);
+    for (i = 1; i <= players; i++) {
+        sprintf(name, "user%u", i);
+        sprintf(psn, "GTP_racer%u", i % (players / 2)); // PSN collisions
+        p = player_create(db, name, psn);
+        if (!p) {
+            break;
+        }
+        if (i % 3) {
+            strcpy(p->country, "New Zealand");
+        }
+        p->div = 1 + rand() % DIV_IN_USE;
+        p->sub_div = rand() % (SUB_DIV_BRONZE+1);
+        p->rating = p->real_rating = 1.0 + (rand() % 100000) / 99991.0;
+        p->total_weight = rand() % 20;
+        p->event_count = rand() % 40;
+        p->history_count = rand() % (RACE_HISTORY+1);
+        for (j = 0; j < p->history_count; j++) {
+            p->history[j].race_id = j + 1;
+            p->history[j].status = STATUS_FINAL;
+            p->history[j].rating = (rand() % 100000) / 49999.0;
+            p->history[j].weight = 1.0;
+            p->history[j].dq = rand() % (DQ_CUSTOM_VIOLATION+1);
+        }
+        if (i % 5 == 0) {
+            p->qualifier.status = STATUS_FINAL;
+            p->qualifier.rating = 2.1;
+            p->qualifier.weight = 2.0;
+        }
+    }
+}
+
+// read text into a fresh DB with the given thread count; compare against the
+// text written back out (and the reference DB's counts and lookups)
+int
+bench_db_check(char *text, size_t size, unsigned threads, player_db_t *ref, double *elapsed)
+{
+    player_db_t *db = player_db_create();
+    char *out = 0, key[MAX_NAME_LEN];
+    size_t out_size = 0;
+    FILE *file;
+    unsigned i;
+    int errors = 0;
+    double start;
+
+    start = bench_now();
+    db_read_chunked(db, text, size, threads);
+    *elapsed = bench_now() - start;
+
+    file = open_memstream(&out, &out_size);
+    db_write(db, file);
+    fclose(file);
+    if (out_size != size || memcmp(out, text, size)) {
+        fprintf(stderr, "db_read_chunked(%u threads): DB differs\n", threads);
+        errors++;
+    }
+    if (ref && (db->player_cnt != ref->player_cnt || db->max_player_id != ref->max_player_id)) {
+        fprintf(stderr, "db_read_chunked(%u threads): %d/%d players, expected %d/%d\n", threads,
+                db->player_cnt, db->max_player_id, ref->player_cnt, ref->max_player_id);
+        errors++;
+    }
+    for (i = 1; ref && i <= 1000; i++) {
+        sprintf(key, "GTP_racer%u", i);
+        if (player_lookup_by_psn(db, key) != player_get(db, player_lookup_by_psn(ref, key)->id)) {
+            fprintf(stderr, "db_read_chunked(%u threads): lookup '%s' differs\n", threads, key);
+            errors++;
+            break;
+        }
+    }
+    free(out);
+    player_db_free(db);
+    return errors;
+}
+
+int
+bench_db_read(void)
+{
+    player_db_t *db = player_db_create();
+    char *text = 0;
+    size_t size = 0;
+    FILE *file;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double serial, chunked, multi;
+    int errors = 0;
+
+    bench_db_fill(db, BENCH_DB_PLAYERS);
+    file = open_memstream(&text, &size);
+    db_write(db, file);
+    fclose(file);
+
+    errors += bench_db_check(text, size, 1, db, &serial);
+    errors += bench_db_check(text, size, BENCH_DB_THREADS, db, &chunked);
+    errors += bench_db_check(text, size, (cpus > 0 ? cpus : 1), db, &multi);
+    printf("db_read: %d players, %.1f MB text, %ld cpus\n", db->player_cnt, size / 1e6, cpus);
+    printf("  serial:    %8.3f s\n", serial);
+    printf("  %2d chunks: %8.3f s (%.1fx)\n", BENCH_DB_THREADS, chunked, serial / chunked);
+    printf("  %2ld chunks: %8.3f s (%.1fx)\n", cpus, multi, serial / multi);
+    free(text);
+    player_db_free(db);
+    return errors;
+}
+
+// a repeated player id (as in a journal) must still read as the serial
+// reader does: the later record replaces the earlier one
+int
+bench_db_repeat(void)
+{
+    player_db_t *db = player_db_create();
+    player_db_t *ref = player_db_create();
+    char *text = 0, *out[2] = { 0, 0 };
+    size_t size = 0, out_size[2] = { 0, 0 };
+    FILE *file;
+    int i, errors = 0;
+
+    bench_db_fill(db, BENCH_DB_PLAYERS / 10);
+    file = open_memstream(&text, &size);
+    db_write(db, file);
+    fprintf(file, "Player_id: 7 User: \"again\" Rating: 1.25\nHistory: Week: 3 Event_Status: F Rating: 1.5 Weight: 1.0\n");
+    fclose(file);
+    player_db_free(db);
+
+    db = player_db_create();
+    db_read_chunked(db, text, size, 1);
+    db_read_chunked(ref, text, size, BENCH_DB_THREADS);
+    for (i = 0; i < 2; i++) {
+        file = open_memstream(&out[i], &out_size[i]);
+        db_write(i ? ref : db, file);
+        fclose(file);
+    }
+    if (out_size[0] != out_size[1] || memcmp(out[0], out[1], out_size[0]) ||
+            db->player_cnt != ref->player_cnt || db->max_player_id != ref->max_player_id ||
+            player_lookup_by_name(ref, "again") != player_get(ref, 7)) {
+        fprintf(stderr, "db_read_chunked: repeated id differs from serial read\n");
+        errors++;
+    }
+    free(out[0]);
+    free(out[1]);
+    free(text);
+    player_db_free(db);
+    player_db_free(ref);
+    return errors;
+}
+
+/************************************************/
+// text DB writer: one sprintf/fprintf per line, as before db_format_player()
+int
+db_write_player_stdio(FILE *file, player_t *player)
+{
+    char line[MAX_LINE_LEN];
+    int retval = 0, len, i;
+    race_result_t *rr;
+
+    retval = sprintf(line, "Player_id: %d User: \"%s\" PSN: \"%s\" Div: %d Sub: %c Rating: %f RRating: %f Weight: %f Events: %d DQS: %d VERI: %d ", player->id, player->name, player->psn, player->div, g_subdiv_text[player->sub_div][0], player->rating, player->real_rating, player->total_weight, player->event_count, player->dq_count, player->verified_count);
+    if (*player->country) {
+        retval = fprintf(file, "%s Country: \"%s\"\n", line, player->country);
+    } else {
+        fprintf(file, "%s\n", line);
+    }
+    if (player->qualifier.status != STATUS_NONE) {
+        rr = &player->qualifier;
+        len = sprintf(line, "Qual: Event_Status: %c Rating: %f Weight: %f %s%s", (rr->status == STATUS_FINAL ? 'F' : 'P'), rr->rating, rr->weight, (rr->dq ? "DISQ: " : ""), (rr->dq ? g_dq_text[rr->dq] : ""));
+        retval += len;
+        fprintf(file, "%s\n", line);
+    }
+    for (i = 0, rr = &player->history[i];
+            i < RACE_HISTORY && rr->status != STATUS_NONE;
+            i++, rr = &player->history[i]) {
+        len = sprintf(line, "History: Week: %d Event_Status: %c Rating: %f Weight: %f %s%s", rr->race_id, (rr->status == STATUS_FINAL ? 'F' : 'P'), rr->rating, rr->weight, (rr->dq ? "DISQ: " : ""), (rr->dq ? g_dq_text[rr->dq] : ""));
+        retval += len;
+        fprintf(file, "%s\n", line);
+    }
+    return retval;
+}
+
+int
+db_write_stdio(player_db_t *db, FILE *file)
+{
+    player_t *player;
+    player_iter_t iter;
+    int retval = 0;
+
+    fprintf(file, "# WRS DB START\n\n");
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter)) {
+        if (db_write_player_stdio(file, player)) {
+            retval++;
+        }
+    }
+    fprintf(file, "\n# WRS DB END\n");
+    return retval;
+}
+
+// byte for byte against the stdio writer, then timed on a 1M player DB
+int
+bench_db_write(void)
+{
+    player_db_t *db = player_db_create();
+    char *text[2] = { 0, 0 };
+    size_t size[2] = { 0, 0 };
+    unsigned threads[] = { 1, BENCH_DB_THREADS };
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double start, stdio, one, multi;
+    FILE *file;
+    int i, errors = 0;
+
+    bench_db_fill(db, BENCH_DB_PLAYERS / 10);
+    player_get(db, 5)->valid = FALSE; // gaps in the id range
+    player_get(db, DB_WRITE_BATCH)->valid = FALSE;
+    file = open_memstream(&text[0], &size[0]);
+    db_write_stdio(db, file);
+    fclose(file);
+    for (i = 0; i < 2; i++) {
+        file = open_memstream(&text[1], &size[1]);
+        db_write_threads(db, file, threads[i]);
+        fclose(file);
+        if (size[0] != size[1] || memcmp(text[0], text[1], size[0])) {
+            fprintf(stderr, "db_write_threads(%u): differs from stdio writer\n", threads[i]);
+            errors++;
+        }
+        free(text[1]);
+    }
+    free(text[0]);
+    player_db_free(db);
+
+    db = player_db_create();
+    bench_db_fill(db, BENCH_DB_WRITE_PLAYERS);
+    file = fopen("/dev/null", "w");
+    if (!file) {
+        player_db_free(db);
+        return errors + 1;
+    }
+    start = bench_now();
+    db_write_stdio(db, file);
+    stdio = bench_now() - start;
+    start = bench_now();
+    db_write_threads(db, file, 1);
+    one = bench_now() - start;
+    start = bench_now();
+    db_write(db, file);
+    multi = bench_now() - start;
+    fclose(file);
+
+    printf("db_write: %d players, %ld cpus\n", db->player_cnt, cpus);
+    printf("  stdio:     %8.3f s\n", stdio);
+    printf("  buffered:  %8.3f s (%.1fx)\n", one, stdio / one);
+    printf("  %2ld threads: %8.3f s (%.1fx)\n", cpus, multi, stdio / multi);
+    player_db_free(db);
+    return errors;
+}
+
+/************************************************/
+// numeric codecs against the C library
+
+// parse_time as it was before the codecs: atoi() and isdigit() walks
+int
+parse_time_atoi(char *str, ttime_t *time)
+{
+    time->min = atoi(str);
+    while (isdigit(*str)) str++;
+    while (*str && !isdigit(*str)) str++;
+    time->sec = atoi(str);
+    while (isdigit(*str)) str++;
+    if (isspace(*str)) {
+        time->msec = time->sec;
+        time->sec = time->min;
+        time->min = 0;
+    } else {
+        while (*str && !isdigit(*str)) str++;
+        time->msec = atoi(str);
+    }
+    while (time->sec > 60) {
+        time->min++;
+        time->sec -= 60;
+    }
+    return SUCCESS;
+}
+
+// a double of the kinds the DB holds: ratings, weights, exact ties of
+// the 7th decimal, and now and then something far out of range
+double
+bench_double(unsigned i)
+{
+    uint64_t bits;
+    double x;
+
+    switch (i % 6) {
+    case 0: return (rand() % 5000000) / 999983.0;
+    case 1: return (rand() % 20000000) / 2e6 + 0.5e-6; // ties, before rounding error
+    case 2: return (double)(rand() % 40);
+    case 3: return -(rand() % 100000) / 1e9;
+    case 4:
+        x = ldexp((double)rand() / RAND_MAX, rand() % 80 - 40);
+        return (rand() & 1 ? -x : x);
+    default:
+        bits = (unsigned)rand();
+        bits |= (uint64_t)rand() << 32;
+        memcpy(&x, &bits, sizeof(x));
+        return x; // any bits: huge, tiny, inf and nan too
+    }
+}
+
+int
+bench_num_check(void)
+{
+    char *strings[] = { "0", "-0", "+1.5", "  2.000000", "1e3", "1.5E-2", ".5", "5.", "-.25",
+                        "0x1p3", "inf", "-nan", "", "-", "12345678901234567890", "3.14159265358979323846",
+                        "0.0000000000000000000000001", "1'15.721", "17 ", "2147483647", "-2147483648" };
+    char *times[] = { "1'15.721", "59.123 ", "1:02.5", "75.400 Disq", "2'61.000", " 1'15.721", "1'15", "" };
+    char text[2][NUM_MAX_LEN * 16];
+    char *end[2];
+    ttime_t t[2];
+    double x, y[2];
+    unsigned i;
+    int errors = 0;
+
+    for (i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        y[0] = strtod(strings[i], &end[0]);
+        y[1] = num_parse_double(strings[i], &end[1]);
+        if (memcmp(&y[0], &y[1], sizeof(double)) && !(isnan(y[0]) && isnan(y[1]))) {
+            fprintf(stderr, "num_parse_double(\"%s\") = %.17g, strtod %.17g\n", strings[i], y[1], y[0]);
+            errors++;
+        }
+        // out of int range, atoi() is undefined and num_parse_int() saturates
+        if (end[0] != end[1] || (fabs(y[0]) <= INT_MAX && num_parse_int(strings[i], 0) != atoi(strings[i]))) {
+            fprintf(stderr, "num_parse: '%s' differs\n", strings[i]);
+            errors++;
+        }
+    }
+    for (i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        parse_time_atoi(times[i], &t[0]);
+        parse_time(times[i], &t[1]);
+        time_display(text[1], &t[1]);
+        sprintf(text[0], "%u'%2.2u.%3.3u", (unsigned char)t[0].min, (unsigned char)t[0].sec, (unsigned short)t[0].msec);
+        if (t[0].min != t[1].min || t[0].sec != t[1].sec || t[0].msec != t[1].msec || strcmp(text[0], text[1])) {
+            fprintf(stderr, "parse_time(\"%s\") = %s, expected %s\n", times[i], text[1], text[0]);
+            errors++;
+        }
+    }
+    srand(3);
+    for (i = 0; i < BENCH_NUM_COUNT && errors < 10; i++) {
+        x = bench_double(i);
+        sprintf(text[0], "%f", x);
+        if (num_format_fixed(text[1], x, 6) ? strcmp(text[0], text[1]) : (!isnan(x) && fabs(x) < DB_FIXED6_MAX)) {
+            fprintf(stderr, "num_format_fixed(%.17g) = %s, \"%%f\" %s\n", x, text[1], text[0]);
+            errors++;
+        }
+        sprintf(text[0], "%.*f", i % 7, x);
+        if (num_format_fixed(text[1], x, i % 7) ? strcmp(text[0], text[1]) : (!isnan(x) && fabs(x) < DB_FIXED6_MAX)) {
+            fprintf(stderr, "num_format_fixed(%.17g, %u) = %s, \"%%.*f\" %s\n", x, i % 7, text[1], text[0]);
+            errors++;
+        }
+        sprintf(text[0], "%f", x);
+        if (i % 2) {
+            sprintf(text[0], "%.17g", x); // exponents, and more digits than the fast path takes
+        }
+        y[0] = atof(text[0]);
+        y[1] = num_parse_double(text[0], 0);
+        if (memcmp(&y[0], &y[1], sizeof(double)) && !(isnan(y[0]) && isnan(y[1]))) {
+            fprintf(stderr, "num_parse_double(\"%s\") = %.17g, atof %.17g\n", text[0], y[1], y[0]);
+            errors++;
+        }
+        num_format_int(text[1], (int)x);
+        sprintf(text[0], "%d", (int)x);
+        if (fabs(x) < INT_MAX && strcmp(text[0], text[1])) {
+            fprintf(stderr, "num_format_int(%d) = %s\n", (int)x, text[1]);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+void
+bench_num(void)
+{
+    char (*text)[NUM_MAX_LEN] = malloc(BENCH_NUM_COUNT * NUM_MAX_LEN);
+    double *x = malloc(BENCH_NUM_COUNT * sizeof(double));
+    double start, clib[3], codec[3], sum = 0;
+    unsigned i;
+    ttime_t t;
+
+    if (!text || !x) {
+        return;
+    }
+    srand(4);
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        x[i] = bench_double(i % 2); // ratings, as the DB holds them
+        sprintf(text[i], "%f", x[i]);
+    }
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        sum += atof(text[i]);
+    }
+    clib[0] = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        sum += num_parse_double(text[i], 0);
+    }
+    codec[0] = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        sprintf(text[i], "%f", x[i]);
+    }
+    clib[1] = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        num_format_fixed(text[i], x[i], 6);
+    }
+    codec[1] = bench_now() - start;
+
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        sprintf(text[i], "%d'%02d.%03d", i % 3, i % 60, i % 1000);
+    }
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        parse_time_atoi(text[i], &t);
+        sum += t.msec;
+    }
+    clib[2] = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < BENCH_NUM_COUNT; i++) {
+        parse_time(text[i], &t);
+        sum += t.msec;
+    }
+    codec[2] = bench_now() - start;
+
+    printf("numeric codecs: %d values\n", BENCH_NUM_COUNT);
+    printf("  atof:        %8.2f ns  num_parse_double:  %8.2f ns (%.1fx)\n",
+           clib[0] * 1e9 / BENCH_NUM_COUNT, codec[0] * 1e9 / BENCH_NUM_COUNT, clib[0] / codec[0]);
+    printf("  %%f:          %8.2f ns  num_format_fixed:  %8.2f ns (%.1fx)\n",
+           clib[1] * 1e9 / BENCH_NUM_COUNT, codec[1] * 1e9 / BENCH_NUM_COUNT, clib[1] / codec[1]);
+    printf("  atoi time:   %8.2f ns  parse_time:        %8.2f ns (%.1fx)\n",
+           clib[2] * 1e9 / BENCH_NUM_COUNT, codec[2] * 1e9 / BENCH_NUM_COUNT, clib[2] / codec[2]);
+    if (sum == 0) {
+        printf("\n");
+    }
+    free(text);
+    free(x);
+}
+
+// every archived DB: each number parses as atof() does, and the DB writes
+// back as the stdio writer would, and reads back to itself
+int
+bench_db_archive(char *name)
+{
+    player_db_t *db;
+    char *text, *out[2] = { 0, 0 }, *ptr, *end, *tok;
+    size_t size, out_size[2] = { 0, 0 };
+    FILE *file;
+    long len;
+    double y[2];
+    int i, numbers = 0, errors = 0;
+
+    file = fopen(name, "r");
+    if (!file) {
+        fprintf(stderr, "%s: can't open\n", name);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text = malloc(len + 1);
+    size = (text ? fread(text, 1, len, file) : 0);
+    fclose(file);
+    if (!text) {
+        return 1;
+    }
+    text[size] = 0;
+    for (ptr = text, end = text + size; ptr < end; ptr = tok) {
+        while (ptr < end && isspace(*ptr)) ptr++;
+        for (tok = ptr; tok < end && !isspace(*tok); tok++);
+        if (tok > ptr && (isdigit(*ptr) || *ptr == '-' || *ptr == '.')) {
+            y[0] = atof(ptr);
+            y[1] = num_parse_double(ptr, 0);
+            numbers++;
+            if (memcmp(&y[0], &y[1], sizeof(double)) || atoi(ptr) != num_parse_int(ptr, 0)) {
+                fprintf(stderr, "%s: '%.*s' parses differently\n", name, (int)(tok - ptr), ptr);
+                errors++;
+            }
+        }
+    }
+
+    db = player_db_create();
+    db_read_mapped(db, text, size);
+    for (i = 0; i < 2; i++) {
+        file = open_memstream(&out[i], &out_size[i]);
+        if (i) {
+            db_write(db, file);
+        } else {
+            db_write_stdio(db, file);
+        }
+        fclose(file);
+    }
+    if (out_size[0] != out_size[1] || memcmp(out[0], out[1], out_size[0])) {
+        fprintf(stderr, "%s: db_write differs from the stdio writer\n", name);
+        errors++;
+    }
+    player_db_free(db);
+    db = player_db_create();
+    db_read_mapped(db, out[1], out_size[1]);
+    free(out[0]);
+    file = open_memstream(&out[0], &out_size[0]);
+    db_write(db, file);
+    fclose(file);
+    if (out_size[0] != out_size[1] || memcmp(out[0], out[1], out_size[0])) {
+        fprintf(stderr, "%s: written DB doesn't read back to itself\n", name);
+        errors++;
+    }
+    printf("  %s: %d players, %d numbers, %s\n", name, db->player_cnt, numbers,
+           (out_size[1] == size && !memcmp(out[1], text, size)) ? "rewrites identically" : "rewrites in the current layout");
+    player_db_free(db);
+    free(out[0]);
+    free(out[1]);
+    free(text);
+    return errors;
+}
+
+/************************************************/
+// results renderer against the fprintf() one it replaced
+
+char *
+time_display_stdio(char *out, ttime_t *time)
+{
+    sprintf(out, "%u'%2.2u.%3.3u", (unsigned char)time->min, (unsigned char)time->sec, (unsigned short)time->msec);
+    return out;
+}
+
+char *
+rating_delta_display_stdio(char *out, entry_t *e)
+{
+    player_t *player;
+
+    player = entry_player(e);
+    if (!player || player_rookie(player)) {
+        out[0] = 0;
+    } else {
+        sprintf(out, "%.5f", e->rating - player->rating);
+    }
+
+    return out;
+}
+
+void
+dump_entry_stdio(context_t *ctx, FILE *file, entry_t *e, display_opt_e opt, int place)
+{
+    int i;
+    char rating[MAX_NAME_LEN];
+    player_t *player;
+    char tbuf[MAX_NAME_LEN], rbuf[MAX_NAME_LEN], nbuf[MAX_NAME_LEN];
+
+    rating[0] = 0;
+    if (ctx->event.week == EVENT_QUALIFIER) {
+        player = player_get(ctx->db, e->player_id);
+        if (!player) {
+            return;
+        }
+        if (opt != SHOW_RATINGS) { // for display
+            fprintf(file, "%s / %s / %s (",
+                player->psn, player->name, player_country(ctx->db, nbuf, e->player_id));
+            if (player->qualifier.rating > 0.0f) {
+                // if it's stored, use that
+                fprintf(file, "%1.3f", player->qualifier.rating);
+            } else {
+                // else, use the event rating
+                fprintf(file, "%1.3f", e->rating);
+            }
+            if (player->event_count > 1) {
+                fprintf(file, " / %1.3f", player->rating);
+            }
+            // TODO: qualifier hack
+//            fprintf(file, ") %s \n", g_dq_display_text[e->dq]);
+            fprintf(file, ") \n");
+        } else { // private
+            fprintf(file, "%s / %s %s (%1.3f) \n",
+                entry_psn(e), player_name(ctx->db, nbuf, e->player_id),
+                time_display_stdio(tbuf, &e->time), e->rating);
+        }
+        return; // done with entry, so exit
+    } else if (!dq_ok(e->dq)) {
+        fprintf(file, "%sQ---%s---%s ", g_color_tag[entry_div(e)],
+                g_dq_display_text[e->dq], entry_psn(e));
+        if (e->dq >= DQ_NO_REPLAY) {
+            fprintf(file, "%s ", g_dq_flag_url[FLAG_BLACK]);
+        } else {
+            fprintf(file, "%s ", g_dq_flag_url[FLAG_RED]);
+        }
+    } else if (place < 10) {
+        if (opt == SHOW_RATING_DELTA) {
+            int usec;
+            ttime_t time;
+            usec = time_handicap(ctx, e);
+            time_from_usec(&time, usec);
+            fprintf(file, "%s%u---%s---(%s)-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &time), rating_delta_display_stdio(rbuf, e),
+                    entry_rookie(e), entry_psn(e));
+//            fprintf(file, "%s%u--(%s)---%s ", g_color_tag[entry_div(e)],
+//                    place, rating_delta_display_stdio(rbuf, e), entry_psn(e));
+        } else if (event_season_active(ctx) && opt == SHOW_FLAGS) {
+            fprintf(file, "%s%u---%s---%u-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &e->time), e->points,
+                    entry_rookie(e), entry_psn(e));
+        } else {
+            fprintf(file, "%s%u---%s-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &e->time), 
+                    entry_rookie(e), entry_psn(e));
+        }
+    } else {
+        if (opt == SHOW_RATING_DELTA) {
+            int usec;
+            ttime_t time;
+            usec = time_handicap(ctx, e);
+            time_from_usec(&time, usec);
+            fprintf(file, "%s%u--%s---(%s)-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &time), rating_delta_display_stdio(rbuf, e),
+                    entry_rookie(e), entry_psn(e));
+//            fprintf(file, "%s%u--(%s)---%s ", g_color_tag[entry_div(e)],
+//                    place, rating_delta_display_stdio(rbuf, e), entry_psn(e));
+        } else if (event_season_active(ctx) && opt == SHOW_FLAGS) {
+            fprintf(file, "%s%u--%s---%u-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &e->time), e->points, entry_rookie(e), entry_psn(e));
+        } else {
+            fprintf(file, "%s%u--%s-%c-%s ", g_color_tag[entry_div(e)],
+                    place, time_display_stdio(tbuf, &e->time), entry_rookie(e), entry_psn(e));
+        }
+    }
+    if (opt == SHOW_FLAGS) {
+        rating_string(ctx, rating, e);
+        fprintf(file, "%s %s %s", rating, entry_replay_string(ctx, e), entry_dq_flag(e));
+    } else if (opt == SHOW_RATINGS) {
+        fprintf(file, "r=%.3f ", e->rating);
+        fprintf(file, "(d%d/%.3f) ", e->prov_div, e->hcp_delta);
+    } else if (opt == SHOW_ALL_TIMES) {
+        for (i = 0; i < MAX_SPLITS; i++) {
+            if (time_to_usec(&e->split[i])) {
+                fprintf(file, "%s ", time_display_stdio(tbuf, &e->split[i]));
+            }
+        }
+    }
+    fprintf(file, "[/COLOR]\n");
+}
+
+void
+dump_event_stdio(context_t *ctx, FILE *file)
+{
+    entry_t *cur;
+    entry_iter_t iter;
+    int i, div;
+    char tbuf[MAX_NAME_LEN];
+
+    // heading
+    fprintf(file, "\n%sWeek %d (%s): %s", g_results_text_1, ctx->event.week,
+            ctx->event.status==STATUS_FINAL?"Official":"Provisional",
+            ctx->event.description);
+    fprintf(file, "%s%s", g_results_text_2a, ctx->event.img[0]);
+    fprintf(file, "%s%s", g_results_text_2b, ctx->event.img[1]);
+    fprintf(file, "%s%s", g_results_text_2c, ctx->event.car[0]?ctx->event.car:"xxx_CAR");
+    fprintf(file, "%s%s", g_results_text_3a, ctx->event.img[2]);
+    fprintf(file, "%s%s", g_results_text_3b, ctx->event.track[0]?ctx->event.track:"xxx_TRACK");
+    fprintf(file, "%s%s%s", g_results_text_4a, ctx->event.comment, g_results_text_4b);
+    fprintf(file, "[LIST][*]gtpwrs%03d, essentials, pineapple[/LIST]\n", ctx->event.week);
+    fprintf(file, "%s", g_results_text_4c);
+
+    for (div = 1; div <= DIV_COUNT; div++) {
+        cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK);
+        if (!cur) {
+            continue;
+        }
+        fprintf(file, "\nDivision %d:\n\n", div);
+        for (i = 1; cur; i++, cur = entry_get_next(&iter)) {
+            dump_entry_stdio(ctx, file, cur, SHOW_FLAGS, cur->place);
+        }
+        for (cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+            dump_entry_stdio(ctx, file, cur, SHOW_NONE, cur->place);
+        }
+    }
+
+    fprintf(file, "\n[img]%s[/img]\n", ctx->event.img[3]);
+    fprintf(file, "\nOverall Results:\n\n");
+    div = 1;
+    for (i = 1, cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK); cur; i++, cur = entry_get_next(&iter)) {
+        if (time_to_usec(&cur->time) >= time_to_usec(&ctx->div_stat[div].par)) {
+            fprintf(file, "\n>> Division %d: ", div);
+            fprintf(file, "Par: %s ", time_display_stdio(tbuf, &ctx->div_stat[div].par));
+            fprintf(file, "Gold: %s ", time_display_stdio(tbuf, &ctx->div_stat[div].gold));
+            fprintf(file, "Silver: %s ", time_display_stdio(tbuf, &ctx->div_stat[div].silver));
+            fprintf(file, "Bronze: %s\n", time_display_stdio(tbuf, &ctx->div_stat[div].bronze));
+            div++;
+        } 
+        //dump_entry_stdio(ctx, file, cur, SHOW_ALL_TIMES, cur->overall_place);
+        dump_entry_stdio(ctx, file, cur, SHOW_RATINGS, cur->overall_place);
+    }
+    fprintf(file, "\n");
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        dump_entry_stdio(ctx, file, cur, SHOW_NONE, cur->overall_place);
+    }
+
+    fprintf(file, "\n[img]%s[/img]\n", ctx->event.img[4]);
+    fprintf(file, "\nHandicapped Results:\n\n");
+    for (i = 1, cur = entry_get_first(ctx, &iter, ctx->rat_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
+        if (entry_rookie(cur) == '-') { // not rookie
+            dump_entry_stdio(ctx, file, cur, SHOW_RATING_DELTA, i++);
+        }
+    }
+    fprintf(file, "\n");
+    for (cur = entry_get_first(ctx, &iter, ctx->rat_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        dump_entry_stdio(ctx, file, cur, SHOW_NONE, cur->overall_place);
+    }
+
+    fprintf(file, "\n(Settings: Weight = %.3f Squeeze = %.3f Scoot = %.3f)\n\n",
+            ctx->event.weight, ctx->event.squeeze, ctx->event.scoot);
+    fprintf(file, "%s", g_results_text_5);
+}
+
+void
+dump_stats_stdio(context_t *ctx, FILE *file, int detail)
+{
+    int div, i;
+    entry_t *e;
+    entry_iter_t iter;
+    stat_t *stat;
+    ttime_t delta;
+    char tbuf[MAX_NAME_LEN];
+
+    // info
+    fprintf(file, "\nWRS Stats for Week %d (%s):\n", ctx->event.week,
+            ctx->event.status==STATUS_FINAL?"Official":"Provisional");
+    if (ctx->event.description[0]) {
+        fprintf(file, "%s\n", ctx->event.description);
+    }
+    if (ctx->event.car[0]) {
+        fprintf(file, "Car: %s\n", ctx->event.car);
+    }
+    if (ctx->event.track[0]) {
+        fprintf(file, "Track: %s\n", ctx->event.track);
+    }
+    fprintf(file, "(Settings: Weight = %.3f Squeeze = %.3f Scoot = %.3f)\n",
+            ctx->event.weight, ctx->event.squeeze, ctx->event.scoot);
+
+    fprintf(file, "\nStatistics: ");
+    fprintf(file, "\n\nOverall Mean time: %s ", time_display_stdio(tbuf, &ctx->ostat.mean));
+    if (detail) {
+        fprintf(file, "Dev/Min: %.3f ",
+            (ctx->ostat.mean.time > 0.0f) ? ctx->ostat.std_dev*60.0f/ctx->ostat.mean.time : 0.0f);
+    }
+    fprintf(file, "Deviation: %.3f \n", ctx->ostat.std_dev);
+    fprintf(file, "Quality Mean time: %s ", time_display_stdio(tbuf, &ctx->ostat.q_mean));
+    if (detail) {
+        fprintf(file, "Dev/Min: %.3f ",
+            (ctx->ostat.q_mean.time > 0.0f) ? ctx->ostat.q_std_dev*60.0f/ctx->ostat.q_mean.time : 0.0f);
+    }
+    fprintf(file, "Deviation: %.3f \n", ctx->ostat.q_std_dev);
+    if (detail) {
+        fprintf(file, "    average hcp delta: %.3f\n", ctx->ostat.hcp_delta);
+        if (ctx->echo && file != ctx->echo) { // echo this if we aren't already
+            fprintf(ctx->echo, "Overall average hcp delta: %.3f\n", ctx->ostat.hcp_delta);
+        }
+    }
+    for (div = 1; div <= DIV_IN_USE; div++) {
+        stat = &ctx->div_stat[div];
+
+        if (stat->mean.time <= 0.0f) {
+            continue;
+        }
+        if (!detail) {
+            fprintf(file, "%s >>> Division %d: ", g_color_tag[div], div);
+        } else {
+            fprintf(file, "D%d: ", div);
+        }
+        fprintf(file, "Mean: %s ", time_display_stdio(tbuf, &stat->mean));
+        fprintf(file, "Dev: %.3f ", stat->std_dev);
+        if (detail) {
+            fprintf(file, "Dev/Min: %.3f ", 
+                (stat->mean.time > 0.0f) ? stat->std_dev*60.0f/stat->mean.time : 0.0f);
+            fprintf(file, "Par: %s \n", time_display_stdio(tbuf, &stat->par));
+            fprintf(file, "    q_mean = %s ", time_display_stdio(tbuf, &stat->q_mean));
+            fprintf(file, "q_dev = %.3f, q_dev/min = %.3f\n", stat->q_std_dev,
+                (stat->q_mean.time > 0.0f) ? stat->q_std_dev*60.0f/stat->q_mean.time : 0.0f);
+            fprintf(file, "    -(%d %d %d)+ average hcp delta: %.3f",
+                stat->perf[0], stat->perf[1], stat->perf[2], stat->hcp_delta);
+            if (ctx->echo && file != ctx->echo) { // echo this if we aren't already
+                fprintf(ctx->echo, "D%d: -(%d %d %d)+ average hcp delta: %.3f\n", div,
+                    stat->perf[0], stat->perf[1], stat->perf[2], stat->hcp_delta);
+            }
+        } else {
+            fprintf(file, "[/color]");
+        }
+        fprintf(file, "\n");
+    }
+    if (detail && ctx->event.week != EVENT_QUALIFIER) {
+        fprintf(file, "\nWatch List:\n");
+        for (div = 1; div <= DIV_COUNT; div++) {
+            for (e = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
+                for (i = 0; i < (int)-(e->hcp_delta*3.0f); i++) {
+                    fprintf(file, "*");
+                }
+                if (entry_watch(e)) {
+                    fprintf(file, " %s D%d %s >>> D%d %s (rating %.3f hcp delta %.3f)\n",
+                            entry_psn(e),
+                            entry_div(e), g_subdiv_text[entry_subdiv(e)],
+                            e->prov_div, g_subdiv_text[(int)((e->rating-e->prov_div)*3)],
+                            e->rating, e->hcp_delta);
+                }
+            }
+        }
+        fprintf(file, "\nStruggle List:\n");
+        for (div = 1; div <= DIV_COUNT; div++) {
+            for (e = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
+                if (entry_struggle(e)) {
+                    fprintf(file, " %s D%d %s >>> D%d %s (rating %.3f hcp delta %.3f)\n",
+                            entry_psn(e),
+                            entry_div(e), g_subdiv_text[entry_subdiv(e)],
+                            e->prov_div, g_subdiv_text[(int)((e->rating-e->prov_div)*3)],
+                            e->rating, e->hcp_delta);
+
+                }
+            }
+        }
+    }
+    if (detail) {
+        fprintf(file, "\nDivision thresholds:\n");
+        for (div = 0; div <= DIV_IN_USE; div++) {
+            fprintf(file, "D%d Par: (%s) ", div, time_display_stdio(tbuf, &ctx->div_stat[div].par));
+            fprintf(file, "G: (%s) ", time_display_stdio(tbuf, &ctx->div_stat[div].gold));
+            fprintf(file, "S: (%s) ", time_display_stdio(tbuf, &ctx->div_stat[div].silver));
+            fprintf(file, "B: (%s) ", time_display_stdio(tbuf, &ctx->div_stat[div].bronze));
+            time_subtract(&delta, &ctx->div_stat[div].bronze, &ctx->div_stat[div].par);
+            fprintf(file, "range: (%.3f)\n", delta.time);
+        }
+    }
+}
+
+// an event of BENCH_RENDER_ENTRIES racers, most of them rated, with a
+// DQ mix and split times
+context_t *
+bench_event(player_db_t *db)
+{
+    context_t *ctx = context_create(db);
+    player_t *p;
+    char *text = 0, *dq[] = { "green", "unverified", "verified", "submitted", "off", "contact", "replay" };
+    char name[MAX_NAME_LEN];
+    size_t size = 0;
+    FILE *file;
+    unsigned i, ms;
+
+    if (!ctx) {
+        return 0;
+    }
+    ctx->echo = 0;
+    srand(5);
+    for (i = 0; i < BENCH_RENDER_ENTRIES; i++) {
+        sprintf(name, "racer%u", i);
+        p = player_create(db, name, name);
+        if (p && i % 10) { // one in ten is a rookie
+            p->event_count = p->verified_count = ROOKIE_TIME + i % 5;
+            p->rating = p->real_rating = 1.0 + (rand() % 4000) / 1000.0;
+            p->div = (unsigned)p->rating;
+            p->sub_div = (unsigned)((p->rating - p->div) * 3);
+        }
+    }
+    file = open_memstream(&text, &size);
+    fprintf(file, "Week: 37\nDesc: Bench\nCar: Car\nTrack: Track\nShape: standard\nWeight: 1.0\nEvent_Status: Final\n");
+    for (i = 0; i < BENCH_RENDER_ENTRIES; i++) {
+        ms = 75000 + (rand() % 20000);
+        fprintf(file, "PSN: racer%u Time: %u'%02u.%03u Disq: %s", i, ms / 60000, ms / 1000 % 60, ms % 1000,
+                dq[(rand() % 20 < 17) ? 0 : rand() % 7]);
+        if (i % 4 == 0) {
+            fprintf(file, " Split: 0'%02u.%03u Split: 0'%02u.%03u", ms / 2000 % 60, ms / 2 % 1000,
+                    (ms - ms / 2) / 1000 % 60, (ms - ms / 2) % 1000);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    file = fmemopen(text, size, "r");
+    scan_event(ctx, file);
+    fclose(file);
+    free(text);
+    collate_stats(ctx);
+    return ctx;
+}
+
+int
+bench_render(void)
+{
+    player_db_t *db = player_db_create();
+    context_t *ctx;
+    char *text[2] = { 0, 0 };
+    size_t size[2] = { 0, 0 };
+    double start, elapsed[2];
+    FILE *file;
+    int i, errors = 0;
+
+    ctx = bench_event(db);
+    if (!ctx) {
+        player_db_free(db);
+        return 1;
+    }
+    for (i = 0; i < 2; i++) {
+        file = open_memstream(&text[i], &size[i]);
+        start = bench_now();
+        if (i) {
+            dump_event(ctx, file);
+            dump_stats(ctx, file, TRUE);
+            dump_stats(ctx, file, FALSE);
+        } else {
+            dump_event_stdio(ctx, file);
+            dump_stats_stdio(ctx, file, TRUE);
+            dump_stats_stdio(ctx, file, FALSE);
+        }
+        fclose(file);
+        elapsed[i] = bench_now() - start;
+    }
+    if (size[0] != size[1] || memcmp(text[0], text[1], size[0])) {
+        fprintf(stderr, "dump_event/dump_stats: output differs from the fprintf renderer\n");
+        errors++;
+    }
+    printf("results: %u entries, %.1f MB out + stat\n", ctx->entry_cnt, size[1] / 1e6);
+    printf("  fprintf:  %8.3f s\n", elapsed[0]);
+    printf("  buffered: %8.3f s (%.1fx)\n", elapsed[1], elapsed[0] / elapsed[1]);
+    free(text[0]);
+    free(text[1]);
+    context_free(ctx);
+    player_db_free(db);
+    return errors;
+}
+
+/************************************************/
+// synthetic league: a registry, a rated DB and one week of entries written
+// as the real files are, then a weekly run over them timed phase by phase.
+//   wrbench -league <dir> <resultfile> <players>...
+// each run appends one JSON line per league size to resultfile
+
+#define LEAGUE_BASE_MS 90000    // a lap at rating 1.0
+#define LEAGUE_DIV_SPREAD 0.012 // slower per rating point
+#define LEAGUE_NOISE 0.005      // one racer's lap to lap spread
+#define LEAGUE_ENTER 85         // percent of the league racing a week
+#define LEAGUE_ROOKIES 10       // percent without enough events for a rating
+#define LEAGUE_PSN_SHARED 200   // one in this many registers a PSN already taken
+
+typedef enum {
+    LEAGUE_DB_READ,
+    LEAGUE_SCAN_EVENT,
+    LEAGUE_COLLATE_STATS,
+    LEAGUE_SORT_RATINGS,
+    LEAGUE_DUMP_EVENT,
+    LEAGUE_DB_UPDATE,
+    LEAGUE_DB_WRITE,
+    LEAGUE_PHASE_COUNT
+} league_phase_e;
+
+char *g_league_phase[] = {
+    "db_read", "scan_event", "collate_stats", "sort_ratings", "dump_event", "db_update", "db_write",
+};
+
+// Disq: values and how often, in percent, an entry has each
+char *g_league_dq[] = { "green", "unverified", "verified", "off", "contact", "replay", "time" };
+int g_league_dq_share[] = { 80, 8, 5, 3, 2, 1, 1 };
+
+// share of the rated players in each division
+int g_league_div_share[DIV_IN_USE] = { 15, 30, 35, 20 };
+
+double
+league_uniform(void)
+{
+    return (rand() + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+// standard normal, Box-Muller
+double
+league_gauss(void)
+{
+    return sqrt(-2.0 * log(league_uniform())) * cos(2.0 * M_PI * league_uniform());
+}
+
+// dir/name into path, a PATH_MAX buffer
+// returns: path, 0 if it doesn't fit
+char *
+league_path(char *path, char *dir, char *name)
+{
+    int len = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+
+    return (len >= 0 && len < PATH_MAX ? path : 0);
+}
+
+// the registry: one User line per player, one in LEAGUE_PSN_SHARED giving
+// the PSN of a player registered before
+int
+league_registry(char *dir, unsigned players)
+{
+    char *country[] = { "USA", "UK", "Belgium", "New Zealand", "Japan", "Brazil" };
+    char path[PATH_MAX];
+    FILE *file;
+    unsigned i;
+
+    file = (league_path(path, dir, "registry.txt") ? fopen(path, "w") : 0);
+    if (!file) {
+        return FAILURE;
+    }
+    fprintf(file, "# synthetic registry, %u players\nWeek: 0\nDescription: Bench Registry\n"
+            "Outfile: registry.out\nStatfile: registry.stat\nEvent_Status: provisional\n", players);
+    for (i = 1; i <= players; i++) {
+        fprintf(file, "User: \"user%u\" PSN: \"Racer%u\" Country: \"%s\" Status: rookie\n", i,
+                (i % LEAGUE_PSN_SHARED ? i : i / 2), country[i % 6]);
+    }
+    return (fclose(file) ? FAILURE : SUCCESS);
+}
+
+// rate the registered players as a season would have: a division mix, a
+// history each, and some rookies.  skill[id] is each player's pace in
+// rating points, rookies included
+void
+league_rate(player_db_t *db, unsigned players, double *skill)
+{
+    player_iter_t iter;
+    player_t *p;
+    unsigned j, div;
+    int share;
+
+    srand(players);
+    for (p = player_get_first(db, &iter); p; p = player_get_next(&iter)) {
+        if (p->id > players) {
+            continue;
+        }
+        if (rand() % 100 < LEAGUE_ROOKIES) {
+            skill[p->id] = 1.0 + DIV_IN_USE * league_uniform();
+            p->event_count = rand() % ROOKIE_TIME;
+            continue;
+        }
+        share = rand() % 100;
+        for (div = 0; div < DIV_IN_USE - 1 && share >= g_league_div_share[div]; div++) {
+            share -= g_league_div_share[div];
+        }
+        skill[p->id] = 1.0 + div + league_uniform();
+        p->rating = p->real_rating = skill[p->id];
+        p->div = div + 1;
+        p->sub_div = (unsigned)((p->rating - p->div) * 3);
+        p->event_count = ROOKIE_TIME + rand() % 40;
+        p->verified_count = p->event_count / 2;
+        p->total_weight = p->event_count;
+        p->history_count = (p->event_count < RACE_HISTORY ? p->event_count : RACE_HISTORY);
+        for (j = 0; j < p->history_count; j++) {
+            p->history[j].race_id = j + 1;
+            p->history[j].status = STATUS_FINAL;
+            p->history[j].rating = skill[p->id] + LEAGUE_NOISE * 100 * league_gauss();
+            p->history[j].weight = 1.0;
+            p->history[j].dq = (rand() % 20 ? DQ_VERIFIED : DQ_OFF_TRACK);
+        }
+    }
+}
+
+// the registry run through scan_event() to create the players, then rated
+// and saved as the league's DB
+int
+league_db(char *dir, unsigned players, double *skill)
+{
+    player_db_t *db = player_db_create();
+    context_t *ctx = context_create(db);
+    char path[PATH_MAX];
+    FILE *file = 0;
+    int retval = FAILURE;
+
+    if (ctx && league_registry(dir, players) == SUCCESS) {
+        file = (league_path(path, dir, "registry.txt") ? fopen(path, "r") : 0);
+    }
+    if (file) {
+        ctx->echo = 0;
+        scan_event(ctx, file);
+        fclose(file);
+        league_rate(db, players, skill);
+        if (league_path(path, dir, "league.wdb")) {
+            retval = db_save(db, path, FALSE);
+        }
+    }
+    if (ctx) {
+        context_free(ctx);
+    }
+    player_db_free(db);
+    return retval;
+}
+
+// one week: lap times spread by skill, the DQ mix, and the entries of the
+// players sharing a PSN landing on its first owner
+int
+league_week(char *dir, unsigned players, double *skill)
+{
+    char path[PATH_MAX];
+    FILE *file;
+    unsigned i, ms;
+    int dq, pick;
+
+    file = (league_path(path, dir, "week.txt") ? fopen(path, "w") : 0);
+    if (!file) {
+        return FAILURE;
+    }
+    fprintf(file, "Week: 1\nDesc: Bench Week\nCar: Car\nTrack: Track\nOutfile: week.out\n"
+            "Statfile: week.stat\nShape: standard\nWeight: 1.0\nEvent_Status: Final\n");
+    srand(players + 1);
+    for (i = 1; i <= players; i++) {
+        if (rand() % 100 >= LEAGUE_ENTER) {
+            continue;
+        }
+        ms = LEAGUE_BASE_MS * (1.0 + LEAGUE_DIV_SPREAD * (skill[i] - 1.0) + LEAGUE_NOISE * league_gauss());
+        pick = rand() % 100;
+        for (dq = 0; pick >= g_league_dq_share[dq]; dq++) {
+            pick -= g_league_dq_share[dq];
+        }
+        fprintf(file, "PSN: Racer%u Time: %u'%02u.%03u Disq: %s\n", (i % LEAGUE_PSN_SHARED ? i : i / 2),
+                ms / 60000, ms / 1000 % 60, ms % 1000, g_league_dq[dq]);
+    }
+    return (fclose(file) ? FAILURE : SUCCESS);
+}
+
+// the weekly run as wrsort makes it, each phase timed on its own.
+// sort_ratings() is also part of collate_stats(); it is timed again alone
+int
+league_phases(context_t *ctx, char *dir, double *phase, struct stat *st)
+{
+    char dbname[PATH_MAX], path[PATH_MAX];
+    double start;
+    FILE *file;
+    int fd;
+
+    if (!league_path(dbname, dir, "league.wdb")) {
+        return FAILURE;
+    }
+    start = bench_now();
+    fd = open(dbname, O_RDONLY);
+    if (fd < 0) {
+        return FAILURE;
+    }
+    if (db_load(ctx->db, fd) < 0) {
+        close(fd);
+        return FAILURE;
+    }
+    fstat(fd, st);
+    close(fd);
+    phase[LEAGUE_DB_READ] = bench_now() - start;
+
+    start = bench_now();
+    file = (league_path(path, dir, "week.txt") ? fopen(path, "r") : 0);
+    if (!file) {
+        return FAILURE;
+    }
+    scan_event(ctx, file);
+    fclose(file);
+    phase[LEAGUE_SCAN_EVENT] = bench_now() - start;
+
+    start = bench_now();
+    collate_stats(ctx);
+    phase[LEAGUE_COLLATE_STATS] = bench_now() - start;
+
+    start = bench_now();
+    sort_ratings(ctx);
+    phase[LEAGUE_SORT_RATINGS] = bench_now() - start;
+
+    start = bench_now();
+    file = (league_path(path, dir, ctx->event.outfile) ? fopen(path, "w") : 0);
+    if (!file) {
+        return FAILURE;
+    }
+    dump_event(ctx, file);
+    fclose(file);
+    file = (league_path(path, dir, ctx->event.statfile) ? fopen(path, "w") : 0);
+    if (!file) {
+        return FAILURE;
+    }
+    dump_stats(ctx, file, TRUE);
+    fclose(file);
+    phase[LEAGUE_DUMP_EVENT] = bench_now() - start;
+
+    start = bench_now();
+    db_update(ctx);
+    phase[LEAGUE_DB_UPDATE] = bench_now() - start;
+
+    start = bench_now();
+    if (db_save(ctx->db, dbname, FALSE) != SUCCESS) {
+        return FAILURE;
+    }
+    phase[LEAGUE_DB_WRITE] = bench_now() - start;
+    return SUCCESS;
+}
+
+// one result line, on the console and appended to results
+int
+league_run(char *dir, unsigned players, FILE *results)
+{
+    player_db_t *db = player_db_create();
+    context_t *ctx = context_create(db);
+    double phase[LEAGUE_PHASE_COUNT];
+    struct stat st;
+    int i, retval = FAILURE;
+
+    if (ctx) {
+        ctx->echo = 0;
+        retval = league_phases(ctx, dir, phase, &st);
+    }
+    if (retval == SUCCESS) {
+        printf("  %8u %8d", players, ctx->entry_cnt);
+        fprintf(results, "{\"time\":%ld,\"players\":%u,\"entries\":%d,\"db_bytes\":%ld",
+                (long)time(0), players, ctx->entry_cnt, (long)st.st_size);
+        for (i = 0; i < LEAGUE_PHASE_COUNT; i++) {
+            printf(" %13.4f", phase[i]);
+            fprintf(results, ",\"%s\":%.6f", g_league_phase[i], phase[i]);
+        }
+        printf("\n");
+        fprintf(results, "}\n");
+    }
+    if (ctx) {
+        context_free(ctx);
+    }
+    player_db_free(db);
+    return retval;
+}
+
+int
+bench_league(int argc, char **argv)
+{
+    FILE *results;
+    double *skill;
+    unsigned players;
+    int i, errors = 0;
+
+    if (argc < 3) {
+        fprintf(stderr, "wrbench -league <dir> <resultfile> <players>...\n");
+        return -1;
+    }
+    results = fopen(argv[1], "a");
+    if (!results) {
+        fprintf(stderr, "wrbench: can't append to '%s'\n", argv[1]);
+        return -1;
+    }
+    printf("league: %s, s per phase\n  %8s %8s", argv[0], "players", "entries");
+    for (i = 0; i < LEAGUE_PHASE_COUNT; i++) {
+        printf(" %13s", g_league_phase[i]);
+    }
+    printf("\n");
+    for (i = 2; i < argc; i++) {
+        players = num_parse_int(argv[i], 0);
+        skill = calloc(players + 1, sizeof(double));
+        if (!skill || league_db(argv[0], players, skill) != SUCCESS ||
+                league_week(argv[0], players, skill) != SUCCESS ||
+                league_run(argv[0], players, results) != SUCCESS) {
+            fprintf(stderr, "league of %u players failed\n", players);
+            errors++;
+        }
+        free(skill);
+    }
+    fclose(results);
+    return errors;
+}
+
+/************************************************/
+int
+main(int argc, char **argv)
+{
+    int i;
+
+    if (argc > 1 && !strcmp(argv[1], "-league")) {
+        return bench_league(argc - 2, argv + 2);
+    }
+    if (bench_label_check()) {
+        fprintf(stderr, "label check failed\n");
+        return -1;
+    }
+    bench_labels();
+    if (bench_stats()) {
+        fprintf(stderr, "stats check failed\n");
+        return -1;
+    }
+    if (bench_db_read() || bench_db_repeat()) {
+        fprintf(stderr, "db read check failed\n");
+        return -1;
+    }
+    if (bench_num_check()) {
+        fprintf(stderr, "numeric codec check failed\n");
+        return -1;
+    }
+    bench_num();
+    if (argc > 1) {
+        printf("archived DBs:\n");
+    }
+    for (i = 1; i < argc; i++) {
+        if (bench_db_archive(argv[i])) {
+            fprintf(stderr, "archive round-trip failed\n");
+            return -1;
+        }
+    }
+    if (bench_render()) {
+        fprintf(stderr, "render check failed\n");
+        return -1;
+    }
+    if (bench_db_write()) {
+        fprintf(stderr, "db write check failed\n");
+        return -1;
+    }
+    return 0;
+}
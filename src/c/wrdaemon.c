@@ -0,0 +1,685 @@
+/*
+ * Filename: wrdaemon.c
+ *
+ * Purpose: wrsort -daemon: the current event and the player DB kept in
+ *          memory, updated and queried over a Unix-domain socket
+ *
+ * Works through the libcapper API (capper.h) only.  The protocol is one
+ * request per line; each reply is zero or more lines of data, then a line
+ * starting "OK" or "ERR":
+ *
+ *   submit <psn> <time> [disq]  new or replacement submission
+ *   disq <psn> <status>         Disq: status of an entry (green, contact...)
+ *   withdraw <psn>              drop an entry
+ *   event <line>                any event file line, e.g. "event Squeeze: 1.3"
+ *   leaderboard [div]           overall/div place, psn, time, event rating
+ *   thresholds                  par and trophy times per division
+ *   handicap <psn>              division and rating from the DB
+ *   post [stats]                the results post (or stats) as wrsort writes it
+ *   final                       Event_Status: Final, same as "event Event_Status: F";
+ *                               again after a failed DB write, retries it
+ *   shutdown                    stop without writing anything, unless the
+ *                               final DB is unwritten: retry it, or stay up
+ *
+ * Results are computed on the first query; entry updates after that are
+ * folded in by the library, redoing only what they reach, and an event
+ * line makes the next query compute again.  Queries cost only the
+ * formatting.  The DB (with the outfile/statfile) is written
+ * once, when the event goes final; nothing before that touches the disk.
+ * If that write fails the committed results stay in memory until a retry
+ * succeeds.
+ * A -journal DB is read with its journal and written back as one snapshot,
+ * in the format it was read in.
+ */
+#include "wrsort.h"
+#include "capper.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/************************************************/
+/* defines */
+
+#define DAEMON_MAX_CLIENTS 32
+#define DAEMON_BACKLOG 16
+
+/************************************************/
+/* data types */
+
+typedef struct _daemon_client {
+    int fd;           // -1 if the slot is free
+    unsigned len;     // bytes buffered in line[]
+    char line[MAX_LINE_LEN];
+} daemon_client_t;
+
+typedef struct _daemon {
+    capper_db_t *db;
+    capper_event_t *ev;
+    char *dbfilename;
+    int binary; // DB read from a binary snapshot, so written as one
+    int final;  // results committed
+    int saved;  // and the DB written; "final" and "shutdown" retry until it is
+    int quit;
+    daemon_client_t client[DAEMON_MAX_CLIENTS];
+} daemon_t;
+
+/************************************************/
+/* functions */
+
+// daemon_slurp
+// returns: the whole file in a malloc()ed buffer, or 0 if it can't be read
+char *
+daemon_slurp(char *filename, size_t *len)
+{
+    FILE *file;
+    char *buf;
+    long size;
+
+    file = fopen(filename, "r");
+    if (!file) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buf = (size >= 0 ? malloc(size + 1) : 0);
+    if (buf) {
+        *len = fread(buf, 1, size, file);
+    }
+    fclose(file);
+    return buf;
+}
+
+// daemon_spit
+// write buf to filename through a temp file, so a reader never sees a
+// half written DB
+int
+daemon_spit(char *filename, char *buf, size_t len)
+{
+    char tmpname[MAX_STR_LEN + 8];
+    FILE *file;
+    int retval;
+
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+    file = fopen(tmpname, "w");
+    if (!file) {
+        fprintf(stderr, "daemon: failed to open '%s'\n", tmpname);
+        return FAILURE;
+    }
+    // on disk before the rename, or a crash could leave an empty DB in place
+    retval = (fwrite(buf, 1, len, file) != len || fflush(file) || fsync(fileno(file)));
+    if (fclose(file) || retval) {
+        fprintf(stderr, "daemon: failed to write '%s'\n", tmpname);
+        unlink(tmpname);
+        return FAILURE;
+    }
+    if (rename(tmpname, filename)) {
+        fprintf(stderr, "daemon: failed to rename '%s'\n", tmpname);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+// m'ss.mmm, as time_display() prints times
+char *
+daemon_time(char *out, long ms)
+{
+    sprintf(out, "%ld'%2.2ld.%3.3ld", ms / 60000, (ms / 1000) % 60, ms % 1000);
+    return out;
+}
+
+// daemon_render_file: the rendered results into filename
+int
+daemon_render_file(daemon_t *d, capper_render_e what, char *filename, FILE *out)
+{
+    char *buf;
+    size_t len;
+    int retval;
+
+    if (capper_event_render(d->ev, what, &buf, &len) != CAPPER_OK) {
+        fprintf(out, "ERR out of memory\n");
+        return FAILURE;
+    }
+    retval = daemon_spit(filename, buf, len);
+    capper_free(buf);
+    if (retval != SUCCESS) {
+        fprintf(out, "ERR failed to write '%s'\n", filename);
+    }
+    return retval;
+}
+
+// daemon_save
+// write the committed DB.  replies only on failure
+int
+daemon_save(daemon_t *d, FILE *out)
+{
+    char name[MAX_STR_LEN];
+    char *buf;
+    size_t len;
+    int retval;
+
+    retval = (d->binary ? capper_db_serialize_binary(d->db, &buf, &len) :
+              capper_db_serialize(d->db, &buf, &len));
+    if (retval != CAPPER_OK) {
+        fprintf(out, "ERR out of memory, db not written\n");
+        return FAILURE;
+    }
+    retval = daemon_spit(d->dbfilename, buf, len);
+    capper_free(buf);
+    if (retval != SUCCESS) {
+        fprintf(out, "ERR failed to write '%s'\n", d->dbfilename);
+        return FAILURE;
+    }
+    d->saved = TRUE;
+    unlink(db_journal_name(name, d->dbfilename)); // folded into the DB now
+    return SUCCESS;
+}
+
+// daemon_finalize
+// write the outfile/statfile, commit the final results and then write the
+// DB.  an outfile/statfile failure stops before the commit; a DB failure
+// after it leaves the results committed but unsaved.  either way the next
+// "final" picks up where this one stopped
+int
+daemon_finalize(daemon_t *d, FILE *out)
+{
+    capper_event_info_t info;
+    int retval;
+
+    if (!d->final) {
+        capper_event_compute(d->ev);
+        capper_event_info(d->ev, &info);
+        if (info.outfile[0] &&
+                daemon_render_file(d, CAPPER_RENDER_RESULTS, info.outfile, out) != SUCCESS) {
+            return FAILURE;
+        }
+        if (info.statfile[0] && strcmp(info.outfile, info.statfile) &&
+                daemon_render_file(d, CAPPER_RENDER_STATS, info.statfile, out) != SUCCESS) {
+            return FAILURE;
+        }
+        retval = capper_event_commit(d->ev);
+        if (retval != CAPPER_OK) {
+            fprintf(out, "ERR commit failed (%d)\n", retval);
+            return FAILURE;
+        }
+        d->final = TRUE;
+    }
+    if (daemon_save(d, out) != SUCCESS) {
+        return FAILURE;
+    }
+    capper_event_info(d->ev, &info);
+    fprintf(stderr, "daemon: week %d final, db file %s written\n", info.week, d->dbfilename);
+    fprintf(out, "OK final, %u entries, db written\n", info.entry_cnt);
+    return SUCCESS;
+}
+
+// daemon_update: an event file line, then finalize if it made the event final
+void
+daemon_update(daemon_t *d, char *line, FILE *out)
+{
+    capper_event_info_t info;
+    char text[MAX_LINE_LEN];
+    int retval;
+
+    snprintf(text, sizeof(text), "%s\n", line);
+    retval = capper_event_parse(d->ev, text, strlen(text));
+    if (retval < 0) {
+        fprintf(out, "ERR event line rejected (%d)\n", retval);
+        return;
+    }
+    capper_event_info(d->ev, &info);
+    if (info.final) {
+        daemon_finalize(d, out);
+    } else {
+        fprintf(out, "OK %d entries\n", retval);
+    }
+}
+
+void
+daemon_leaderboard(daemon_t *d, char *arg, FILE *out)
+{
+    capper_standing_t *standing, *s;
+    char tbuf[MAX_NAME_LEN];
+    int div = (arg ? atoi(arg) : DIV_ALL);
+    int count, i;
+
+    // size the rows first: the field has no fixed limit
+    count = capper_event_standings(d->ev, div, 0, 0);
+    if (count < 0) {
+        fprintf(out, "ERR bad division\n");
+        return;
+    }
+    standing = calloc(count + 1, sizeof(capper_standing_t));
+    if (!standing) {
+        fprintf(out, "ERR out of memory\n");
+        return;
+    }
+    count = capper_event_standings(d->ev, div, standing, count);
+    for (i = 0; i < count; i++) {
+        s = &standing[i];
+        fprintf(out, "%d D%d %d %s %s %.3f%s\n", s->overall_place, s->div, s->place, s->psn,
+                daemon_time(tbuf, s->time_ms), s->rating, (s->dq ? " DQ" : ""));
+    }
+    free(standing);
+    fprintf(out, "OK %d entries\n", count);
+}
+
+void
+daemon_thresholds(daemon_t *d, FILE *out)
+{
+    capper_threshold_t t;
+    char par[MAX_NAME_LEN], gold[MAX_NAME_LEN], silver[MAX_NAME_LEN], bronze[MAX_NAME_LEN];
+    int div;
+
+    for (div = 1; div <= DIV_IN_USE; div++) {
+        if (capper_event_thresholds(d->ev, div, &t) != CAPPER_OK) {
+            break;
+        }
+        fprintf(out, "D%d %u Par: %s Gold: %s Silver: %s Bronze: %s\n", div, t.count,
+                daemon_time(par, t.par_ms), daemon_time(gold, t.gold_ms),
+                daemon_time(silver, t.silver_ms), daemon_time(bronze, t.bronze_ms));
+    }
+    fprintf(out, "OK\n");
+}
+
+void
+daemon_handicap(daemon_t *d, char *psn, FILE *out)
+{
+    capper_player_t p;
+
+    if (!psn) {
+        fprintf(out, "ERR usage: handicap <psn>\n");
+    } else if (capper_player_by_psn(d->db, psn, &p) != CAPPER_OK) {
+        fprintf(out, "ERR racer '%s' not registered\n", psn);
+    } else {
+        fprintf(out, "%s D%d %c Rating: %.6f Events: %u%s\n", p.psn, p.div, "GSB"[p.sub_div % 3],
+                p.rating, p.event_count, (p.rookie ? " rookie" : ""));
+        fprintf(out, "OK\n");
+    }
+}
+
+void
+daemon_post(daemon_t *d, char *arg, FILE *out)
+{
+    capper_render_e what = CAPPER_RENDER_RESULTS;
+    char *buf;
+    size_t len;
+
+    if (arg && !strcasecmp(arg, "stats")) {
+        what = CAPPER_RENDER_STATS;
+    }
+    if (capper_event_render(d->ev, what, &buf, &len) != CAPPER_OK) {
+        fprintf(out, "ERR render failed\n");
+        return;
+    }
+    fwrite(buf, 1, len, out);
+    if (len && buf[len-1] != '\n') {
+        fprintf(out, "\n");
+    }
+    capper_free(buf);
+    fprintf(out, "OK\n");
+}
+
+// daemon_request: answer one request line into out
+void
+daemon_request(daemon_t *d, char *line, FILE *out)
+{
+    char *cmd, *arg1, *arg2, *arg3, *rest;
+    int retval;
+
+    rest = line + strspn(line, " \t");
+    cmd = strsep(&rest, " \t");
+    if (rest) {
+        rest += strspn(rest, " \t");
+    } else {
+        rest = cmd + strlen(cmd); // no arguments: strtok() must not see null
+    }
+    if (!cmd || !*cmd) {
+        fprintf(out, "ERR empty request\n");
+        return;
+    }
+    if (!strcasecmp(cmd, "shutdown")) {
+        if (d->final && !d->saved && daemon_save(d, out) != SUCCESS) {
+            return; // committed results only in memory: stay up
+        }
+        d->quit = TRUE;
+        fprintf(out, "OK\n");
+        return;
+    }
+    if (!strcasecmp(cmd, "handicap")) {
+        daemon_handicap(d, strtok(rest, " \t"), out);
+        return;
+    }
+
+    // the rest need the event: updates until final, queries on fresh results
+    if (!strcasecmp(cmd, "submit") || !strcasecmp(cmd, "disq") ||
+            !strcasecmp(cmd, "withdraw") || !strcasecmp(cmd, "event") ||
+            !strcasecmp(cmd, "final")) {
+        if (d->final && !d->saved && !strcasecmp(cmd, "final")) {
+            daemon_finalize(d, out);
+            return;
+        }
+        if (d->final) {
+            fprintf(out, "ERR event is final%s\n", (d->saved ? "" : ", db not written: retry with final"));
+            return;
+        }
+        if (!strcasecmp(cmd, "event")) {
+            daemon_update(d, rest, out);
+        } else if (!strcasecmp(cmd, "final")) {
+            daemon_update(d, "Event_Status: Final", out);
+        } else {
+            arg1 = strtok(rest, " \t");
+            arg2 = strtok(0, " \t");
+            arg3 = strtok(0, " \t");
+            if (!arg1 || (!arg2 && strcasecmp(cmd, "withdraw"))) {
+                fprintf(out, "ERR usage: %s\n", (!strcasecmp(cmd, "disq") ? "disq <psn> <status>" :
+                        !strcasecmp(cmd, "withdraw") ? "withdraw <psn>" : "submit <psn> <time> [disq]"));
+                return;
+            }
+            if (!strcasecmp(cmd, "withdraw")) {
+                retval = capper_event_withdraw(d->ev, arg1);
+            } else if (!strcasecmp(cmd, "disq")) {
+                retval = capper_event_disq(d->ev, arg1, arg2);
+            } else {
+                retval = capper_event_submit(d->ev, arg1, arg2, arg3);
+            }
+            if (retval == CAPPER_ERR_NOT_FOUND) {
+                fprintf(out, "ERR no entry for '%s'\n", arg1);
+            } else if (retval == CAPPER_ERR_PARSE) {
+                fprintf(out, "ERR racer '%s' not registered\n", arg1);
+            } else if (retval < 0) {
+                fprintf(out, "ERR rejected (%d)\n", retval);
+            } else {
+                fprintf(out, "OK\n");
+            }
+        }
+        return;
+    }
+    if (capper_event_compute(d->ev) != CAPPER_OK) {
+        fprintf(out, "ERR compute failed\n");
+        return;
+    }
+    if (!strcasecmp(cmd, "leaderboard")) {
+        daemon_leaderboard(d, strtok(rest, " \t"), out);
+    } else if (!strcasecmp(cmd, "thresholds")) {
+        daemon_thresholds(d, out);
+    } else if (!strcasecmp(cmd, "post")) {
+        daemon_post(d, strtok(rest, " \t"), out);
+    } else {
+        fprintf(out, "ERR unknown request '%s'\n", cmd);
+    }
+}
+
+// daemon_send: all of buf, however the socket takes it
+int
+daemon_send(int fd, char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return FAILURE;
+        }
+        buf += n;
+        len -= n;
+    }
+    return SUCCESS;
+}
+
+void
+daemon_close(daemon_client_t *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    c->len = 0;
+}
+
+// daemon_read
+// take what the client sent and answer each complete line
+void
+daemon_read(daemon_t *d, daemon_client_t *c)
+{
+    char *eol, *reply;
+    size_t reply_len;
+    FILE *out;
+    ssize_t n;
+    unsigned used;
+
+    n = recv(c->fd, c->line + c->len, MAX_LINE_LEN - 1 - c->len, 0);
+    if (n <= 0) {
+        if (n < 0 && errno == EINTR) {
+            return;
+        }
+        daemon_close(c);
+        return;
+    }
+    c->len += n;
+    c->line[c->len] = 0;
+
+    out = open_memstream(&reply, &reply_len);
+    if (!out) {
+        daemon_close(c);
+        return;
+    }
+    used = 0;
+    while ((eol = strchr(c->line + used, '\n')) != 0) {
+        *eol = 0;
+        if (eol > c->line + used && eol[-1] == '\r') {
+            eol[-1] = 0;
+        }
+        daemon_request(d, c->line + used, out);
+        used = eol + 1 - c->line;
+        if (d->quit) {
+            break;
+        }
+    }
+    if (used == 0 && c->len >= MAX_LINE_LEN - 1) {
+        fprintf(out, "ERR request longer than %d bytes\n", MAX_LINE_LEN - 2);
+        used = c->len;
+    }
+    memmove(c->line, c->line + used, c->len - used);
+    c->len -= used;
+    fclose(out);
+    if (daemon_send(c->fd, reply, reply_len) != SUCCESS) {
+        daemon_close(c);
+    }
+    free(reply);
+}
+
+int
+daemon_listen(char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    mode_t mask;
+    int fd, retval;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "daemon: socket path '%s' too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path); // left by an earlier daemon
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "daemon: socket: %s\n", strerror(errno));
+        return -1;
+    }
+    // the socket changes the event and the DB: owner only, from the start
+    mask = umask(0177);
+    retval = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (retval || listen(fd, DAEMON_BACKLOG)) {
+        fprintf(stderr, "daemon: can't listen on '%s': %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// daemon_serve: poll the listening socket and clients until shutdown
+void
+daemon_serve(daemon_t *d, int listen_fd)
+{
+    struct pollfd pfd[DAEMON_MAX_CLIENTS + 1];
+    daemon_client_t *slot[DAEMON_MAX_CLIENTS + 1];
+    int n, i, fd;
+
+    while (!d->quit) {
+        pfd[0].fd = listen_fd;
+        pfd[0].events = POLLIN;
+        for (n = 1, i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            if (d->client[i].fd >= 0) {
+                pfd[n].fd = d->client[i].fd;
+                pfd[n].events = POLLIN;
+                slot[n++] = &d->client[i];
+            }
+        }
+        if (poll(pfd, n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "daemon: poll: %s\n", strerror(errno));
+            return;
+        }
+        for (i = 1; i < n && !d->quit; i++) {
+            if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                daemon_read(d, slot[i]);
+            }
+        }
+        if (pfd[0].revents & POLLIN) {
+            fd = accept(listen_fd, 0, 0);
+            for (i = 0; fd >= 0 && i < DAEMON_MAX_CLIENTS && d->client[i].fd >= 0; i++);
+            if (fd >= 0 && i == DAEMON_MAX_CLIENTS) {
+                daemon_send(fd, "ERR too many clients\n", 21);
+                close(fd);
+            } else if (fd >= 0) {
+                d->client[i].fd = fd;
+                d->client[i].len = 0;
+            }
+        }
+    }
+}
+
+// daemon_start
+// load the DB and the event.  an event that is already final is finished
+// off as a plain run would, leaving nothing to serve
+// returns: SUCCESS/FAILURE
+int
+daemon_start(daemon_t *d, char *eventfilename)
+{
+    capper_event_info_t info;
+    char name[MAX_STR_LEN];
+    char *buf, *journal, *grown;
+    size_t len = 0, jlen = 0;
+
+    buf = daemon_slurp(d->dbfilename, &len);
+    journal = daemon_slurp(db_journal_name(name, d->dbfilename), &jlen);
+    if (journal) { // a later record of a player replaces the earlier one
+        jlen = db_journal_committed(journal, jlen);
+        grown = realloc(buf, len + jlen + 1);
+        if (!grown) {
+            fprintf(stderr, "wrsort error: out of memory\n");
+            return FAILURE;
+        }
+        buf = grown;
+        memcpy(buf + len, journal, jlen);
+        len += jlen;
+        free(journal);
+        fprintf(stderr, "db journal: %s\n", name);
+    }
+    if (buf) {
+        fprintf(stderr, "db file: %s\n", d->dbfilename);
+        d->binary = (db_bin_size(buf, len) > 0);
+        if (capper_db_load(d->db, buf, len) < 0) {
+            fprintf(stderr, "wrsort error: db file '%s' is damaged\n", d->dbfilename);
+            free(buf);
+            return FAILURE;
+        }
+        free(buf);
+    }
+    d->ev = capper_event_create(d->db);
+    if (!d->ev) {
+        fprintf(stderr, "wrsort error: out of memory\n");
+        return FAILURE;
+    }
+    buf = daemon_slurp(eventfilename, &len);
+    if (!buf) {
+        fprintf(stderr, "wrsort error: file '%s' not found\n", eventfilename);
+        return FAILURE;
+    }
+    capper_event_parse(d->ev, buf, len);
+    free(buf);
+    capper_event_info(d->ev, &info);
+    if (info.report) {
+        fprintf(stderr, "daemon: '%s' is a report, not a race\n", eventfilename);
+        return FAILURE;
+    }
+    if (info.final) {
+        d->quit = TRUE;
+        return daemon_finalize(d, stderr);
+    }
+    fprintf(stderr, "------daemon: week %d, %u entries------\n", info.week, info.entry_cnt);
+    return SUCCESS;
+}
+
+// daemon_main
+// wrsort -daemon <socket> <eventfile> [dbfile]
+// keep the event and DB in memory and serve them on a Unix-domain socket
+int
+daemon_main(int argc, char **argv)
+{
+    daemon_t *d;
+    int listen_fd, i, retval = -1;
+
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+    d = calloc(1, sizeof(daemon_t));
+    if (d) {
+        d->db = capper_db_create();
+    }
+    if (!d || !d->db) {
+        fprintf(stderr, "wrsort error: out of memory\n");
+        free(d);
+        return -1;
+    }
+    for (i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        d->client[i].fd = -1;
+    }
+    d->dbfilename = (argc > 2 ? argv[2] : DEFAULT_DB_NAME);
+
+    if (daemon_start(d, argv[1]) == SUCCESS) {
+        retval = 0;
+        listen_fd = (d->quit ? -1 : daemon_listen(argv[0]));
+        if (listen_fd >= 0) {
+            fprintf(stderr, "socket: %s\n", argv[0]);
+            daemon_serve(d, listen_fd);
+            for (i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+                if (d->client[i].fd >= 0) {
+                    daemon_close(&d->client[i]);
+                }
+            }
+            close(listen_fd);
+            unlink(argv[0]);
+        } else if (!d->quit) {
+            retval = -1;
+        }
+    }
+    fprintf(stderr, "-------done-------\n");
+    capper_event_free(d->ev);
+    capper_db_free(d->db);
+    free(d);
+    return retval;
+}
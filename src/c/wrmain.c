@@ -0,0 +1,685 @@
+/*
+ * Filename: wrmain.c
+ *
+ * Purpose: wrsort command line: single event runs, -journal, -compact,
+ *          -convert, -batch and -sweep, any of them under -trace and
+ *          -counters
+ *
+ * Links against libcapper; uses its internal calls (wrsort.h) directly.
+ */
+#include "wrsort.h"
+#include <pthread.h>
+
+/************************************************/
+/* defines */
+
+#define SWEEP_MAX_AXES 4 // Shape, Gold_shift, Squeeze, Scoot
+#define SWEEP_MAX_VALUES 64 // alternatives per sweep axis
+
+/************************************************/
+/* data types */
+
+// one line of a sweep file: a setting label and its alternatives
+typedef struct _sweep_axis {
+    label_e label;
+    unsigned count;
+    char *value[SWEEP_MAX_VALUES];
+} sweep_axis_t;
+
+// one point of the sweep grid and what rating the event with it gave
+typedef struct _sweep_task {
+    unsigned pick[SWEEP_MAX_AXES]; // value index per axis
+    double squeeze; // as used, after any auto adjust
+    double scoot;
+    stat_t div_stat[DIV_COUNT+1];
+    stat_t ostat;
+} sweep_task_t;
+
+typedef struct _sweep {
+    context_t *src; // the parsed event, copied by each thread
+    sweep_axis_t axis[SWEEP_MAX_AXES];
+    unsigned axis_cnt;
+    sweep_task_t *task;
+    unsigned task_cnt;
+    unsigned next; // next task to claim
+} sweep_t;
+
+/************************************************/
+/* main/etc */
+
+void
+usage()
+{
+    fprintf(stderr, "wrsort usage:\n");
+    fprintf(stderr, "wrsort [-trace <tracefile>] [-counters] [-counters-json <file>] <any of the below>\n");
+    fprintf(stderr, "  -trace times the run's phases (DB load and write, parse,\n");
+    fprintf(stderr, "  stats, auto adjust cycles, output), totals them on stderr\n");
+    fprintf(stderr, "  and writes them to tracefile as Chrome trace events;\n");
+    fprintf(stderr, "  -counters reports how often the hot paths ran (label and\n");
+    fprintf(stderr, "  player lookups, list walks, time conversions, auto adjust\n");
+    fprintf(stderr, "  iterations, history swaps) on stderr, -counters-json to file\n");
+    fprintf(stderr, "wrsort <eventfile> [dbfile]\n");
+    fprintf(stderr, "wrsort -journal <eventfile> [dbfile]\n");
+    fprintf(stderr, "  appends the players the event changed to dbfile%s instead\n", DB_JOURNAL_EXT);
+    fprintf(stderr, "  of rewriting dbfile, compacting once the journal grows\n");
+    fprintf(stderr, "wrsort -compact [dbfile]\n");
+    fprintf(stderr, "  folds the journal into dbfile\n");
+    fprintf(stderr, "wrsort -convert <dbfile> <outfile>\n");
+    fprintf(stderr, "  writes dbfile and its journal to outfile as a binary\n");
+    fprintf(stderr, "  snapshot, or a binary snapshot back as text; later runs\n");
+    fprintf(stderr, "  keep the format of the DB they read\n");
+    fprintf(stderr, "wrsort -batch [-out] [-dry-run] [-export <jsonl|csv> <exportfile>] <dbfile> <eventfile>...\n");
+    fprintf(stderr, "  applies the event files in order, as separate runs would,\n");
+    fprintf(stderr, "  reading and writing dbfile once; -out also writes each\n");
+    fprintf(stderr, "  event's outfile/statfile, -export each event's entries and\n");
+    fprintf(stderr, "  division stats to exportfile as JSON Lines or CSV;\n");
+    fprintf(stderr, "  -dry-run never writes dbfile, so exporting the current\n");
+    fprintf(stderr, "  week or the archive leaves the DB as it was\n");
+    fprintf(stderr, "wrsort -sweep <sweepfile> <eventfile> [dbfile]\n");
+    fprintf(stderr, "  rates the event with each Shape/Gold_shift/Squeeze/Scoot\n");
+    fprintf(stderr, "  combination in sweepfile, without updating the DB\n");
+    fprintf(stderr, "wrsort -daemon <socket> <eventfile> [dbfile]\n");
+    fprintf(stderr, "  keeps the event and DB in memory, taking submissions and\n");
+    fprintf(stderr, "  queries on a Unix-domain socket; writes the DB once final\n");
+}
+
+// event_apply
+// write the results of the scanned event and fold it into the DB
+// emit: FALSE skips the outfile/statfile and console results (batch runs)
+// returns: TRUE if the DB should be written; a promotion report that isn't
+//          final leaves the DB alone
+int
+event_apply(context_t *ctx, int emit)
+{
+    FILE *outfile = stdout;
+
+    if (!emit) {
+        // the promotion report updates divs as it prints them
+        outfile = fopen("/dev/null", "w");
+        if (!outfile) {
+            fprintf(stderr, "Failed to open /dev/null\n");
+            return FALSE;
+        }
+    } else if (ctx->event.outfile[0]) {
+        outfile = fopen(ctx->event.outfile, "w"); // overwrite outfile
+        if (!outfile) {
+            fprintf(stderr, "Failed to open outfile '%s', dumping to stdout\n", ctx->event.outfile);
+            outfile = stdout;
+        }
+    }
+    if (ctx->run_mode == RUN_MODE_REPORT) {
+        dump_promotion_report(ctx, outfile, FALSE);
+        if (ctx->event.status != STATUS_FINAL) {
+            if (outfile != stdout) {
+                fclose(outfile);
+            }
+            return FALSE;
+        }
+    } else if (ctx->run_mode == RUN_MODE_DB_FIX) {
+        fix_all_weight(ctx->db, ctx->echo); 
+    } else { 
+        fprintf(stderr, "------stats------\n");
+        collate_stats(ctx);
+        if (emit) {
+            fprintf(stderr, "-------results--------\n");
+            dump_stats(ctx, stdout, FALSE);
+            fprintf(stdout, "\n-----------------------------------\n");
+            if (ctx->event.week == EVENT_QUALIFIER) {
+                dump_qualifier(ctx, outfile);
+            } else {
+                dump_event(ctx, outfile);
+            }
+
+            if (strcmp(ctx->event.outfile, ctx->event.statfile)) {
+                if (outfile != stdout) {
+                    fclose(outfile);
+                }
+                outfile = fopen(ctx->event.statfile, "w"); // overwrite statfile
+                if (!outfile) {
+                    fprintf(stderr, "Failed to open statfile '%s', dumping to stdout\n", ctx->event.statfile);
+                    outfile = stdout;
+                }
+            }
+
+            fprintf(stderr, "-------stats-------\n");
+            dump_stats(ctx, outfile, TRUE);
+        }
+    }
+    if (outfile != stdout) {
+        fclose(outfile);
+    }
+    return TRUE;
+}
+
+// batch_main
+// wrsort -batch [-out] [-dry-run] [-export <jsonl|csv> <exportfile>] <dbfile> <eventfile>...
+// a whole season (registry, weeks, reports) in one process: the DB is read
+// once, each event updates it in memory, and it is written once at the end.
+// An export gets every rated event's records as it goes, so one batch over
+// the archive exports all of it.  -dry-run keeps the updates in memory, for
+// the events after them, and skips the write
+int
+batch_main(context_t *ctx, int argc, char **argv)
+{
+    char *dbfilename;
+    FILE *eventfile, *exportfile = 0;
+    export_format_e export = EXPORT_NONE;
+    int dbfd, emit = FALSE, dry_run = FALSE, dirty = FALSE, i, updates = 0;
+
+    while (argc > 0 && argv[0][0] == '-') {
+        if (!strcmp(argv[0], "-out")) {
+            emit = TRUE;
+            argc--;
+            argv++;
+        } else if (!strcmp(argv[0], "-dry-run")) {
+            dry_run = TRUE;
+            argc--;
+            argv++;
+        } else if (!strcmp(argv[0], "-export") && argc > 2 && !exportfile) {
+            export = export_format(argv[1]);
+            if (export == EXPORT_NONE) {
+                fprintf(stderr, "wrsort error: unknown export format '%s'\n", argv[1]);
+                return -1;
+            }
+            exportfile = fopen(argv[2], "w");
+            if (!exportfile) {
+                fprintf(stderr, "wrsort error: can't write export file '%s'\n", argv[2]);
+                return -1;
+            }
+            dump_export_header(exportfile, export);
+            argc -= 3;
+            argv += 3;
+        } else {
+            break;
+        }
+    }
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+    dbfilename = argv[0];
+    fprintf(stderr, "------wrsort batch------\n");
+
+    dbfd = open(dbfilename, O_RDONLY); // open for reading
+    if (dbfd >= 0) {
+        fprintf(stderr, "------db read------\n");
+        fprintf(stderr, "db file: %s\n", dbfilename);
+        if (db_load(ctx->db, dbfd) < 0) {
+            close(dbfd);
+            return -1;
+        }
+        close(dbfd);
+    }
+    if (db_journal_replay(ctx->db, dbfilename) < 0) {
+        return -1;
+    }
+    for (i = 1; i < argc; i++) {
+        fprintf(stderr, "input file: %s\n", argv[i]);
+        eventfile = fopen(argv[i], "r");
+        if (!eventfile) {
+            // a separate run would stop here too, leaving the DB as it was
+            fprintf(stderr, "wrsort error: file '%s' not found\n", argv[i]);
+            break;
+        }
+        if (dirty) {
+            db_reload(ctx->db); // what the last run's DB write would read back
+            dirty = FALSE;
+        }
+        init_event(ctx);
+        scan_event(ctx, eventfile);
+        fclose(eventfile);
+
+        if (event_apply(ctx, emit)) {
+            if (exportfile && ctx->run_mode != RUN_MODE_REPORT && ctx->run_mode != RUN_MODE_DB_FIX) {
+                dump_export(ctx, exportfile, export);
+            }
+            db_update(ctx);
+            dirty = TRUE;
+            updates++;
+        }
+    }
+    if (exportfile && fclose(exportfile) != 0) {
+        fprintf(stderr, "wrsort error: export file write failed\n");
+        return -1;
+    }
+
+    if (dry_run) {
+        fprintf(stderr, "db file: %s, %d events, dry run: not written\n", dbfilename, updates);
+        fprintf(stderr, "-------done-------\n");
+        return 0;
+    }
+    fprintf(stderr, "------db update------\n");
+    fprintf(stderr, "db file: %s, %d events\n", dbfilename, updates);
+    if (db_save(ctx->db, dbfilename, FALSE) != SUCCESS) {
+        return -1;
+    }
+    fprintf(stderr, "-------done-------\n");
+    return 0;
+}
+
+/************************************************/
+/* parameter sweep                              */
+/************************************************/
+// sweep_read
+// a sweep file holds one line per setting, alternatives split by '|':
+//   Shape: standard | hybrid | custom -0.5 0.0 1.0 2.0 3.5 5.0
+//   Squeeze: auto | 1.1 | 1.2
+// the grid is every combination.  "auto" re-enables auto squeeze/scoot
+// returns: SUCCESS/FAILURE
+int
+sweep_read(FILE *file, sweep_t *sweep)
+{
+    char cur_line[MAX_LINE_LEN];
+    char *ptr, *bar, *end;
+    sweep_axis_t *axis;
+    label_e label;
+    unsigned i;
+
+    sweep->axis_cnt = 0;
+    sweep->task_cnt = 1;
+    while (fgets(cur_line, MAX_LINE_LEN-1, file)) {
+        label = label_get(cur_line);
+        if (label == LABEL_NONE || label == LABEL_COMMENT) {
+            continue;
+        }
+        if (label != LABEL_SHAPE && label != LABEL_GOLD_SHIFT &&
+                label != LABEL_SQUEEZE && label != LABEL_SCOOT) {
+            fprintf(stderr, "sweep: can't sweep '%s'", cur_line);
+            return FAILURE;
+        }
+        for (i = 0; i < sweep->axis_cnt && sweep->axis[i].label != label; i++);
+        if (i < sweep->axis_cnt || i >= SWEEP_MAX_AXES) {
+            fprintf(stderr, "sweep: %s given twice\n", g_label[label]);
+            return FAILURE;
+        }
+        axis = &sweep->axis[sweep->axis_cnt++];
+        axis->label = label;
+        axis->count = 0;
+        for (ptr = label_skip(cur_line); ptr; ptr = (bar ? bar + 1 : 0)) {
+            bar = strchr(ptr, '|');
+            end = (bar ? bar : ptr + strlen(ptr));
+            while (isspace(*ptr)) {
+                ptr++;
+            }
+            while (end > ptr && isspace(end[-1])) {
+                end--;
+            }
+            if (end == ptr) {
+                continue;
+            }
+            if (axis->count >= SWEEP_MAX_VALUES) {
+                fprintf(stderr, "sweep: more than %d %s values\n", SWEEP_MAX_VALUES, g_label[label]);
+                return FAILURE;
+            }
+            axis->value[axis->count++] = strndup(ptr, end - ptr);
+        }
+        if (axis->count == 0) {
+            fprintf(stderr, "sweep: no %s values\n", g_label[label]);
+            return FAILURE;
+        }
+        sweep->task_cnt *= axis->count;
+    }
+    return SUCCESS;
+}
+
+// sweep_apply
+// apply one grid point to a copy of the event, through the same parser the
+// event file went through
+void
+sweep_apply(context_t *ctx, sweep_t *sweep, sweep_task_t *task)
+{
+    char line[MAX_LINE_LEN];
+    sweep_axis_t *axis;
+    char *value;
+    unsigned i;
+
+    for (i = 0; i < sweep->axis_cnt; i++) {
+        axis = &sweep->axis[i];
+        value = axis->value[task->pick[i]];
+        if (!strcasecmp(value, "auto") && axis->label == LABEL_SQUEEZE) {
+            ctx->event.auto_squeeze = TRUE;
+        } else if (!strcasecmp(value, "auto") && axis->label == LABEL_SCOOT) {
+            ctx->event.auto_scoot = TRUE;
+        } else {
+            snprintf(line, MAX_LINE_LEN, "%s: %s\n", g_label[axis->label], value);
+            event_process_line(ctx, line, entry_get(ctx, ctx->entry_cnt));
+        }
+    }
+}
+
+// sweep_run_task
+// rate a copy of the scanned event with the task's settings.  the player DB
+// is only read
+void
+sweep_run_task(context_t *ctx, sweep_t *sweep, sweep_task_t *task)
+{
+    context_copy(ctx, sweep->src);
+    sweep_apply(ctx, sweep, task);
+    collate_stats(ctx);
+    task->squeeze = ctx->event.squeeze;
+    task->scoot = ctx->event.scoot;
+    memcpy(task->div_stat, ctx->div_stat, sizeof(ctx->div_stat));
+    task->ostat = ctx->ostat;
+}
+
+// sweep_thread: run tasks in a context of its own until none are left
+void *
+sweep_thread(void *arg)
+{
+    sweep_t *sweep = arg;
+    context_t *ctx;
+    unsigned i;
+
+    ctx = context_create(sweep->src->db);
+    if (!ctx) {
+        fprintf(stderr, "sweep: out of memory\n");
+        return 0;
+    }
+    while ((i = __atomic_fetch_add(&sweep->next, 1, __ATOMIC_RELAXED)) < sweep->task_cnt) {
+        sweep_run_task(ctx, sweep, &sweep->task[i]);
+    }
+    context_free(ctx);
+    counter_flush();
+    return 0;
+}
+
+void
+dump_sweep(FILE *file, sweep_t *sweep)
+{
+    sweep_task_t *task;
+    stat_t *stat;
+    unsigned i, a;
+    int div;
+
+    fprintf(file, "\nWRS Sweep for Week %d: %u settings\n", sweep->src->event.week, sweep->task_cnt);
+    for (i = 0; i < sweep->task_cnt; i++) {
+        task = &sweep->task[i];
+        fprintf(file, "\n#%u:", i + 1);
+        for (a = 0; a < sweep->axis_cnt; a++) {
+            fprintf(file, " %s: %s", g_label[sweep->axis[a].label], sweep->axis[a].value[task->pick[a]]);
+        }
+        fprintf(file, "\n(Settings: Squeeze = %.3f Scoot = %.3f) average hcp delta: %.3f\n",
+                task->squeeze, task->scoot, task->ostat.hcp_delta);
+        for (div = 1; div <= DIV_IN_USE; div++) {
+            stat = &task->div_stat[div];
+            fprintf(file, "D%d: %3d entries -(%d %d %d)+ average hcp delta: %.3f\n", div,
+                    stat->count, stat->perf[0], stat->perf[1], stat->perf[2], stat->hcp_delta);
+        }
+    }
+}
+
+// sweep_main
+// wrsort -sweep <sweepfile> <eventfile> [dbfile]
+// rate one event with every setting in the sweep grid, on all cores.  the
+// DB is read but never written
+int
+sweep_main(context_t *ctx, int argc, char **argv)
+{
+    sweep_t sweep;
+    pthread_t *thread;
+    FILE *file;
+    long cpus;
+    unsigned i, a, k, threads;
+    int dbfd;
+
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+    memset(&sweep, 0, sizeof(sweep));
+    file = fopen(argv[0], "r");
+    if (!file) {
+        fprintf(stderr, "wrsort error: file '%s' not found\n", argv[0]);
+        return -1;
+    }
+    if (sweep_read(file, &sweep) != SUCCESS) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    file = fopen(argv[1], "r");
+    if (!file) {
+        fprintf(stderr, "wrsort error: file '%s' not found\n", argv[1]);
+        return -1;
+    }
+    dbfd = open((argc > 2 ? argv[2] : DEFAULT_DB_NAME), O_RDONLY);
+    if (dbfd >= 0) {
+        if (db_load(ctx->db, dbfd) < 0) {
+            close(dbfd);
+            return -1;
+        }
+        close(dbfd);
+    }
+    if (db_journal_replay(ctx->db, (argc > 2 ? argv[2] : DEFAULT_DB_NAME)) < 0) {
+        return -1;
+    }
+    scan_event(ctx, file); // players are created here, before any thread starts
+    fclose(file);
+    if (ctx->run_mode != RUN_MODE_EVENT || ctx->entry_cnt == 0) {
+        fprintf(stderr, "sweep: '%s' has no race entries\n", argv[1]);
+        return -1;
+    }
+
+    sweep.src = ctx;
+    sweep.task = calloc(sweep.task_cnt, sizeof(sweep_task_t));
+    if (!sweep.task) {
+        fprintf(stderr, "sweep: out of memory\n");
+        return -1;
+    }
+    // grid order: the last axis changes fastest
+    for (i = 0; i < sweep.task_cnt; i++) {
+        for (k = i, a = sweep.axis_cnt; a-- > 0; ) {
+            sweep.task[i].pick[a] = k % sweep.axis[a].count;
+            k /= sweep.axis[a].count;
+        }
+    }
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0 ? cpus : 1);
+    if (threads > sweep.task_cnt) {
+        threads = sweep.task_cnt;
+    }
+    fprintf(stderr, "------sweep: %u settings, %u threads------\n", sweep.task_cnt, threads);
+    thread = calloc(threads, sizeof(pthread_t));
+    for (i = 0; thread && i < threads; i++) {
+        if (pthread_create(&thread[i], 0, sweep_thread, &sweep)) {
+            break;
+        }
+    }
+    if (!thread || i == 0) {
+        sweep_thread(&sweep); // no threads: run them all here
+    }
+    while (thread && i-- > 0) {
+        pthread_join(thread[i], 0);
+    }
+    free(thread);
+
+    dump_sweep(stdout, &sweep);
+    for (a = 0; a < sweep.axis_cnt; a++) {
+        for (i = 0; i < sweep.axis[a].count; i++) {
+            free(sweep.axis[a].value[i]);
+        }
+    }
+    free(sweep.task);
+    return 0;
+}
+
+// wrsort_main: one run, any mode, after main() has taken the options
+int
+wrsort_main(context_t *ctx, int argc, char **argv)
+{
+    char eventfilename[MAX_STR_LEN];
+    char dbfilename[MAX_STR_LEN];
+    FILE *eventfile;
+    player_db_t *db = ctx->db;
+    int dbfd, len, journal = FALSE;
+
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+    if (!strcmp(argv[1], "-batch")) {
+        return batch_main(ctx, argc - 2, argv + 2);
+    }
+    if (!strcmp(argv[1], "-sweep")) {
+        return sweep_main(ctx, argc - 2, argv + 2);
+    }
+    if (!strcmp(argv[1], "-daemon")) {
+        return daemon_main(argc - 2, argv + 2);
+    }
+    if (!strcmp(argv[1], "-compact")) {
+        len = snprintf(dbfilename, sizeof(dbfilename), "%s", (argc > 2 ? argv[2] : DEFAULT_DB_NAME));
+        if (len < 0 || len >= (int)sizeof(dbfilename)) {
+            fprintf(stderr, "wrsort error: db file name '%s' too long\n", argv[2]);
+            return -1;
+        }
+        dbfd = open(dbfilename, O_RDONLY);
+        if (dbfd >= 0) {
+            if (db_load(db, dbfd) < 0) {
+                close(dbfd);
+                return -1;
+            }
+            close(dbfd);
+        }
+        if (db_journal_replay(db, dbfilename) < 0 || db_save(db, dbfilename, FALSE) != SUCCESS) {
+            return -1;
+        }
+        return 0;
+    }
+    if (!strcmp(argv[1], "-convert")) {
+        if (argc < 4) {
+            usage();
+            return -1;
+        }
+        dbfd = open(argv[2], O_RDONLY);
+        if (dbfd < 0) {
+            fprintf(stderr, "wrsort error: file '%s' not found\n", argv[2]);
+            return -1;
+        }
+        if (db_load(db, dbfd) < 0) {
+            close(dbfd);
+            return -1;
+        }
+        close(dbfd);
+        if (db_journal_replay(db, argv[2]) < 0) {
+            return -1;
+        }
+        db->binary = !db->binary;
+        if (db_save(db, argv[3], FALSE) != SUCCESS) {
+            return -1;
+        }
+        fprintf(stderr, "db convert: %s to %s, %s\n", argv[2], argv[3], (db->binary ? "binary" : "text"));
+        return 0;
+    }
+    if (!strcmp(argv[1], "-journal")) {
+        journal = TRUE;
+        argc--;
+        argv++;
+        if (argc < 2) {
+            usage();
+            return -1;
+        }
+    }
+    strcpy(eventfilename, argv[1]);
+    if (argc == 3) {
+        strcpy(dbfilename, argv[2]);
+    } else {
+        strcpy(dbfilename, DEFAULT_DB_NAME);
+    }
+    fprintf(stderr, "------wrsort------\n");
+    fprintf(stderr, "input file: %s\n", eventfilename);
+
+    eventfile = fopen(eventfilename, "r");
+    if (!eventfile) {
+        fprintf(stderr, "wrsort error: file '%s' not found\n", eventfilename);
+        return -1;
+    }
+    dbfd = open(dbfilename, O_RDONLY); // open for reading
+
+    if (dbfd >= 0) {
+        fprintf(stderr, "------db read------\n");
+        fprintf(stderr, "db file: %s\n", dbfilename);
+        if (db_load(db, dbfd) < 0) {
+            close(dbfd);
+            return -1;
+        }
+        close(dbfd);
+    }
+    if (db_journal_replay(db, dbfilename) < 0) {
+        return -1;
+    }
+    fprintf(stderr, "------parse------\n");
+    scan_event(ctx, eventfile);
+    fclose(eventfile);
+
+    if (!event_apply(ctx, TRUE)) {
+        fprintf(stderr, "-------done-------\n");
+        return 0;
+    }
+
+    fprintf(stderr, "------db update------\n");
+    fprintf(stderr, "db file: %s\n", dbfilename);
+    db_update(ctx); // update database
+    if (db_save(db, dbfilename, journal) != SUCCESS) {
+        return -1;
+    }
+
+    fprintf(stderr, "-------done-------\n");
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    player_db_t *db;
+    context_t *ctx;
+    FILE *tracefile = 0, *counterfile = 0;
+    int counters = FALSE, retval;
+
+    db = player_db_create();
+    ctx = (db ? context_create(db) : 0);
+    if (!ctx) {
+        fprintf(stderr, "wrsort error: out of memory\n");
+        return -1;
+    }
+    while (argc > 1) {
+        if (argc > 2 && !strcmp(argv[1], "-trace") && !tracefile) {
+            tracefile = fopen(argv[2], "w");
+            if (!tracefile) {
+                fprintf(stderr, "wrsort error: can't write trace file '%s'\n", argv[2]);
+                return -1;
+            }
+            db->trace = trace_create(tracefile);
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 2 && !strcmp(argv[1], "-counters-json") && !counterfile) {
+            counterfile = fopen(argv[2], "w");
+            if (!counterfile) {
+                fprintf(stderr, "wrsort error: can't write counter file '%s'\n", argv[2]);
+                return -1;
+            }
+            argc -= 2;
+            argv += 2;
+        } else if (!strcmp(argv[1], "-counters")) {
+            counters = TRUE;
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+    }
+    retval = wrsort_main(ctx, argc, argv);
+    trace_free(db->trace, stderr);
+    if (tracefile) {
+        fclose(tracefile);
+    }
+    if (counters) {
+        counter_report(stderr, FALSE);
+    }
+    if (counterfile) {
+        counter_report(counterfile, TRUE);
+        fclose(counterfile);
+    }
+    return retval;
+}
@@ -30,280 +30,13 @@
 // -- add interactive watchlist
 // -- add interactive promotion interface
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <math.h>
-
-/************************************************/
-/* defines */
-
-#define MAX_LINE_LEN 512
-#define MAX_STR_LEN 128
-#define MAX_NAME_LEN 32
-#define MAX_RACERS  2048
-#define MAX_PLAYERS 2048
-#define RACE_HISTORY 20 // count of "active" races
-#define MAX_SPLITS  5
-#define MAX_IMAGES  7
-#define MAX_POINTS_PLACES  10 // maximum number of places earning points
-#define MAX_RACER_POINTS   20 // maximum number of racers in the points table
-#define MIN_POINTS 0 // minimum points awarded for a valid finish
-#define MAX_SEASON_LENGTH 15
-
-#define DIV_IN_USE  4 // maximum allowable division setting
-#define DIV_COUNT   8 // number of division ranking calculated
-#define DIV_ALL     0 // for iterator
-#define ROOKIE_TIME 3 // events needed to lose rookie status
-
-#define TRUE 1
-#define FALSE 0
-
-#define SUCCESS 1
-#define FAILURE -1
-
-#define BASE_DIV_PER_MIN 0.35f
-#define DEFAULT_DIVISION_STEPPING 0.875f
-#define DEFAULT_SQUEEZE 1.2f  // determines crowding, 1.2 = 5 divisions
-#define DEFAULT_SCOOT  0.0f  // multiplied by zero par to adjust
-#define AUTO_CYCLE_CNT 10 // number of cycles for auto squeeze/scoot calc
-#define AUTO_SCOOT_FRACTION 5 // 1/x of submissions used for auto scoot
-#define SUB_DIVISION_RANGE (1.0f/3.0f)
-#define RATING_WEIGHT_CAP 5 // rating weight cap
-#define MIN_PROMOTION_EVENT_COUNT 4 // minimum events completed prior to promo
-#define NO_HARM_HANDICAP TRUE // prevent submission from harming handicap
-
-#define NULL_PLAYER 0 // "safe" non-player ID
-#define EVENT_QUALIFIER 0 // week 0 is qualifier
-
-#define GTP_TAG "GTP"
-#define DEFAULT_DB_NAME "gt7wrs.wdb"
-
-/************************************************/
-/* enum types */
-
-typedef enum {
-    RUN_MODE_EVENT, // normal mode
-    RUN_MODE_QUALIFIER, // TBD
-    RUN_MODE_REPORT, // check DB for promotions
-    RUN_MODE_DB_FIX, // fix DB weight, etc
-} run_mode_e;
-
-typedef enum {
-    SUB_DIV_GOLD,
-    SUB_DIV_SILVER,
-    SUB_DIV_BRONZE
-} sub_div_e;
-
-typedef enum {
-    SHOW_NONE,
-    SHOW_ALL_TIMES,
-    SHOW_FLAGS,
-    SHOW_RATINGS,
-    SHOW_RATING_DELTA,
-} display_opt_e;
-
-typedef enum {
-    // error
-    LABEL_NONE,
-    // general
-    LABEL_COMMENT,
-    // event
-    LABEL_WEEK,
-    LABEL_SEASON,
-    LABEL_SEASON_RACE,
-    LABEL_EVENT_STATUS,   // provisional/final result (only save final)
-    LABEL_CAR,
-    LABEL_TRACK,
-    LABEL_DESC,
-    LABEL_OUTFILE,
-    LABEL_STATFILE,
-    LABEL_SHAPE,  // par curve shape
-    LABEL_GOLD_SHIFT,  // trophy curve shift
-    LABEL_SQUEEZE,  // par scaling
-    LABEL_SCOOT,    // zero par adjust
-    LABEL_WEIGHT,   // rating weight
-    LABEL_NOTE,   // WRS admin comments field
-    LABEL_IMAGE,   // Images in report
-    LABEL_REPORT,  // Evaluate DB for promotions
-    LABEL_DB_FIX,  // Fix DB
-    // submission/player
-    LABEL_USER,
-    LABEL_NAME,
-    LABEL_PSN,
-    LABEL_COUNTRY,
-    LABEL_TIME,
-    LABEL_TOTAL, // alias for TIME
-    LABEL_SPLIT,
-    LABEL_SECTOR, // alias for SPLIT
-    LABEL_M3, // M3 label, for GT6 qualifier
-    LABEL_MEGANE, // MEGANE label, for GT6 qualifier
-    LABEL_STATUS,
-    LABEL_DISQ,   // alias for LABEL_STATUS
-    // player
-    LABEL_PLAYER_ID, 
-    LABEL_DIV,
-    LABEL_SUB_DIV,
-    LABEL_RATING,
-    LABEL_REAL_RATING,
-    LABEL_EVENT_CNT,
-    LABEL_DQ_CNT,
-    LABEL_VERIFIED_CNT,
-    // player submodes
-    LABEL_QUALIFIER,
-    LABEL_HISTORY,
-    // count of labels
-    LABEL_ENUM_COUNT
-} label_e;
-
-typedef enum {
-    STATUS_NONE, // unset
-    STATUS_PROVISIONAL,
-    STATUS_FINAL,
-} event_status_e;
-
-typedef enum {
-    DQ_OK, // not a DQ... unchecked but assumed ok
-    DQ_SUBMITTED, // not a DQ... replay submitted but not checked
-    DQ_VERIFIED, // not a DQ... verified
-    DQ_OFF_TRACK, // more than 2 wheels off track
-    DQ_CONTACT, // racer hit wall or car
-    DQ_NO_REPLAY, // racer did not provide requested replay
-    DQ_TIME_ERROR, // splits do not add up to final time
-    DQ_NAME_VIOLATION, // name or tag is not appropriate
-    DQ_CUSTOM_VIOLATION, // custom violation, attitude, publicly revealing times, etc
-} dq_reason_e;
-
-typedef enum {
-    FLAG_GREEN,
-    FLAG_RED,
-    FLAG_BLACK,
-} flag_url_e;
-
-typedef enum {
-    ITER_DQ_ALL, // return all entries
-    ITER_DQ_OK, // return only good entries
-    ITER_DQ_BAD, // return only bad entries
-} dq_iter_e;
-
-/************************************************/
-/* data types */
-
-typedef struct {
-    unsigned min;
-    unsigned sec;
-    unsigned msec;
-    double time;
-} ttime_t;
-
-typedef struct _race_result {
-    unsigned    race_id; // week
-    unsigned    status; // provisional/final
-    unsigned    points; // season points for a race
-    dq_reason_e dq;
-    double      rating;
-    double      weight;
-} race_result_t;
-
-typedef struct _player {
-    unsigned        id;             // unique ID
-    unsigned        valid;
-    char            name[MAX_NAME_LEN]; // GTPlanet user name
-    char            psn[MAX_NAME_LEN]; // screen "GTP tag" name
-    char            country[MAX_NAME_LEN]; // residence of user
-    double          real_rating;
-    double          rating;
-    double          total_weight;
-    unsigned        div;     // division 1-5
-    unsigned        sub_div; // gold/silver/bronze
-    unsigned        event_count;
-    unsigned        dq_count; // count of DQ incidences
-    unsigned        verified_count; // count of verified replays
-    unsigned        history_count; // count of events in history
-    race_result_t   qualifier;
-    race_result_t   history[RACE_HISTORY];
-    race_result_t   season[MAX_SEASON_LENGTH];
-    race_result_t   latest;
-} player_t;
-
-typedef struct _player_iter {
-    unsigned idx;
-} player_iter_t;
-
-typedef struct _player_link {
-    player_t *player;
-} player_link_t;
-
-typedef struct _entry {
-    unsigned    player_id;
-    dq_reason_e dq;
-    ttime_t     time;
-    ttime_t     split[MAX_SPLITS];
-    int         prov_div;
-    int         overall_place;
-    int         place;
-    int         points;
-    double      hcp_delta;
-    double      rating;
-} entry_t;
-
-typedef struct _entry_link {
-    struct _entry_link *next;
-    entry_t     *entry;
-} entry_link_t;
-
-typedef struct _entry_iter {
-    int div;
-    dq_iter_e dq;
-    entry_link_t *cur;
-} entry_iter_t;
-
-typedef struct _stat {
-    unsigned count;
-    ttime_t mean;
-    ttime_t par; // min time for division
-    ttime_t gold;
-    ttime_t silver;
-    ttime_t bronze; // max time for division
-    double std_dev;
-    ttime_t q_mean; // mean of best half (overall) or range selection
-    double q_std_dev; // standard deviation of best half
-    unsigned perf[3]; // <, =, > relative div count
-    double hcp_delta; // average handicap delta
-} stat_t;
-
-typedef struct _event {
-    int week;
-    int season;
-    int season_race;
-    event_status_e status;
-    double *par_multiple; 
-    double *trophy_multiple; 
-    double squeeze; 
-    double scoot; 
-    double weight; 
-    int auto_squeeze;
-    int auto_scoot;
-    char car[MAX_STR_LEN];
-    char track[MAX_STR_LEN];
-    char description[MAX_STR_LEN];
-    char outfile[MAX_STR_LEN];
-    char statfile[MAX_STR_LEN];
-    char img[MAX_IMAGES][MAX_STR_LEN];
-    char comment[MAX_STR_LEN];
-} event_t;
-
-typedef struct _season {
-    int season;
-    int race_count;
-    int first_event;
-    int last_event;
-    char season_title[MAX_STR_LEN];
-    event_t event[MAX_SEASON_LENGTH];
-    entry_link_t standings_link[MAX_RACERS];
-    entry_link_t *standings_head[DIV_IN_USE];
-} season_t;
+#include "wrsort.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define STATS_AVX2 // x86 builds pick the AVX2 kernels at run time
+#endif
 
 /************************************************/
 /* static tables */
@@ -349,7 +82,8 @@ char g_color_tag[][MAX_NAME_LEN] = {
     "[COLOR=Black]", // div 8
 };
 
-// note: label text must match order of label enum
+// note: label text must match order of label enum, and each label needs a
+// case in label_lookup()
 char g_label[][MAX_NAME_LEN] = {
     // error
     "NULL", //LABEL_NONE,
@@ -364,7 +98,7 @@ char g_label[][MAX_NAME_LEN] = {
     "TRACK", //LABEL_TRACK,
     "DESC", //LABEL_DESC,
     "OUT", //LABEL_OUTFILE,
-    "STATFILE", //LABEL_OUTFILE,
+    "STATFILE", //LABEL_STATFILE,
     "SHAPE", //LABEL_SHAPE, 
     "GOLD_SHIFT", //LABEL_GOLD_SHIFT, 
     "SQUEEZE", //LABEL_SQUEEZE, 
@@ -448,7 +182,6 @@ double standard_par_multiple[] = { -0.5, 0.0, 1.0, 2.5, 4.5, 7.0, 10.0, 13.5, 17
 double hybrid_par_multiple[] = { -0.5, 0.0, 1.0, 2.75, 5.25, 8.5, 12.5, 17.75, 22.25, 29.0 }; // inc by 0.75
 double double_par_multiple[] = { -0.5, 0.0, 1.0, 3.0, 6.0, 10.0, 15.0, 21.0, 28.0, 36.0 }; // inc by 1 over previous inc
 double multiply_par_multiple[] = { -0.5, 0.0, 1.0, 3.0, 7.0, 15.0, 31.0, 63.0, 127.0, 255.0 }; // double previous inc
-double custom_par_multiple[] = { -0.5, 0.0, 1.0, 2.2, 3.5, 6.0, 8.0, 12.0, 18.0, 26.0 }; // starts with default
 
 double qual_trophy_multiple[] = { (1.0/3.0)-0.05, (2.0/3.0)-0.05, 3.0/3.0 };
 double flat_trophy_multiple[] = { 1.0/3.0, 2.0/3.0, 3.0/3.0 };
@@ -456,7 +189,6 @@ double standard_trophy_multiple[] = { 0.3, (0.3 + 1.0/3.0), 1.0 };
 double hybrid_trophy_multiple[] = { 0.3, (0.3 + 1.0/3.0), 1.0 };
 double double_trophy_multiple[] = { 3.0/12.0, (3.0+4.0)/12.0, (3.0+4.0+5.0)/12.0 };
 double multiply_trophy_multiple[] = { 3.0/12.0, (3.0+4.0)/12.0, (3.0+4.0+5.0)/12.0 };
-double custom_trophy_adjust[] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }; 
 
 /************************************************/
 char g_results_text_1[] = 
@@ -519,804 +251,1087 @@ char g_results_text_5[] =
 
 /************************************************/
 /* globals */
-run_mode_e g_run_mode = RUN_MODE_EVENT;
-event_t g_event;
-season_t g_season;
-entry_t entry_db[MAX_RACERS];
-player_link_t p_sort[MAX_RACERS];
-entry_link_t time_sort[MAX_RACERS];
-entry_link_t rating_sort[MAX_RACERS];
-entry_link_t *ov_head = 0;
-entry_link_t *rat_head = 0;
-player_t player_db[MAX_PLAYERS];
-stat_t div_stat[DIV_COUNT+1] = {0};
-stat_t ostat = {0};
-unsigned g_entry_cnt = 0;
-int player_cnt = -1;
-int max_player_id = -1;
+// no process-wide state: players live in a player_db_t, everything about
+// an event in the context_t evaluating it.  The hot-path counters are the
+// exception, being about the process
 
 /************************************************/
 /* functions */
-int
-dq_ok(dq_reason_e dq)
+
+/************************************************/
+// pool allocator
+void
+pool_reset(pool_t *pool)
 {
-    if (dq == DQ_OK || dq == DQ_VERIFIED || dq == DQ_SUBMITTED) {
-        return TRUE;
+    unsigned i;
+
+    for (i = 0; i < pool->chunk_cnt; i++) {
+        free(pool->chunk[i]);
     }
-    return FALSE;
+    free(pool->chunk);
+    pool->chunk = 0;
+    pool->chunk_cnt = 0;
 }
 
-unsigned
-entry_points(entry_t *entry, unsigned racers)
+// returns: element idx, or 0 if its chunk was never allocated
+void *
+pool_peek(pool_t *pool, unsigned idx)
 {
-    int idx = racers;
-    unsigned points = 0;
+    unsigned c = idx >> POOL_CHUNK_SHIFT;
 
-    if (dq_ok(entry->dq)) {
-        // non-DQ score at least MIN_POINTS (usually 0 or 1)
-        points = MIN_POINTS;
-        // only calculate points if place is within score range 
-        if (entry->place <= MAX_POINTS_PLACES) {
-            // cap row
-            if (idx > MAX_RACER_POINTS) {
-                idx = MAX_RACER_POINTS;
-            }
-            points = g_points_table[idx][entry->place];
-            if (points < MIN_POINTS) {
-                points = MIN_POINTS;
-            }
-        }
+    if (c >= pool->chunk_cnt || !pool->chunk[c]) {
+        return 0;
     }
-    return points;
+    return pool->chunk[c] + (idx & (POOL_CHUNK_SIZE-1)) * pool->elem_size;
 }
 
 /************************************************/
-// player DB interface
-player_t *
-player_get(unsigned id)
-{ 
-    if (id >= MAX_PLAYERS) { 
-        id = NULL_PLAYER;
-    }
-    return &player_db[id];
-}
+// byte buffer
 
-player_t *
-player_create(char *name, char *psn)
+// make room for n more bytes
+// returns: SUCCESS, or FAILURE if out of memory
+int
+buf_reserve(buf_t *buf, size_t n)
 {
-    player_t *p;
-    if (max_player_id >= MAX_PLAYERS) {
-        printf("max_player_id = %d; MAX_PLAYERS=%d\n", max_player_id, MAX_PLAYERS);
-        return 0;
-    }
+    size_t size;
+    char *data;
 
-    player_cnt++;
-    p = &player_db[++max_player_id];
-    p->id = max_player_id;
-    if (p->id > 0) {
-        p->valid = TRUE;
+    if (buf->len + n <= buf->size) {
+        return SUCCESS;
     }
-    strncpy(p->name, (name ? name : "NULL"), MAX_NAME_LEN);
-    strncpy(p->psn, (psn ? psn : "NULL"), MAX_NAME_LEN);
-    p->real_rating = 0.0f;
-    p->rating = 0.0f;
-    p->total_weight = 0.0f;
-    p->div = 0;     // division 1-5; 0 = rookie/unknown
-    p->sub_div = SUB_DIV_GOLD; // gold/silver/bronze
-    p->event_count = 0;
-    p->dq_count = 0;
-
-    return p;
+    for (size = (buf->size ? buf->size : 4096); size < buf->len + n; size *= 2);
+    data = realloc(buf->data, size);
+    if (!data) {
+        buf->failed = TRUE;
+        return FAILURE;
+    }
+    buf->data = data;
+    buf->size = size;
+    return SUCCESS;
 }
 
-char *
-quote_strip(char *out, char *in)
+// returns: length appended, 0 if out of memory
+int
+buf_printf(buf_t *buf, const char *fmt, ...)
 {
-    char *ret = out;
+    va_list ap;
+    int len;
 
-    while (*in) {
-        if (*in == '\"') {
-            in++;
-        } else {
-            *out++ = *in++;
+    if (buf_reserve(buf, MAX_LINE_LEN) == FAILURE) {
+        return 0;
+    }
+    va_start(ap, fmt);
+    len = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+        buf->failed = TRUE;
+        return 0;
+    }
+    if ((size_t)len >= buf->size - buf->len) {
+        if (buf_reserve(buf, len + 1) == FAILURE) {
+            return 0;
         }
+        va_start(ap, fmt);
+        vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+        va_end(ap);
     }
-    *out = 0;
-    return ret;
+    buf->len += len;
+    return len;
 }
 
-char *
-player_name(unsigned id)
+// buf_flush
+// write the buffer out in one piece, and empty it
+// returns: SUCCESS, or FAILURE if the write fell short
+int
+buf_flush(buf_t *buf, FILE *file)
 {
-    static char ret[MAX_NAME_LEN];
-
-    player_t *player = player_get(id);
-    quote_strip(ret, player->name);
+    size_t len = buf->len;
 
-    return ret;
+    buf->len = 0;
+    if (len && fwrite(buf->data, 1, len, file) != len) {
+        return FAILURE;
+    }
+    return SUCCESS;
 }
 
-char *
-player_psn(unsigned id)
+void
+buf_free(buf_t *buf)
 {
-    player_t *player = player_get(id);
-    return player->psn;
+    free(buf->data);
+    memset(buf, 0, sizeof(buf_t));
 }
 
-char *
-player_country(unsigned id)
+int
+buf_append(buf_t *buf, const char *str, size_t len)
 {
-    static char ret[MAX_NAME_LEN];
-
-    player_t *player = player_get(id);
-    if (player->country[0]) {
-        quote_strip(ret, player->country);
-        return ret;
+    if (buf_reserve(buf, len) == FAILURE) {
+        return 0;
     }
-    return "";
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+    return len;
 }
 
-unsigned
-player_is_rookie(unsigned id)
+int
+buf_put_str(buf_t *buf, const char *str)
 {
-    player_t *player = player_get(id);
-    if (player->qualifier.status == STATUS_FINAL ||
-        ((player->total_weight >= ROOKIE_TIME) &&
-         (player->verified_count >= ROOKIE_TIME))) {
-        return FALSE;
-    }
-    return TRUE;
+    return buf_append(buf, str, strlen(str));
 }
 
-unsigned
-player_div(unsigned id)
+int
+buf_put_int(buf_t *buf, int64_t val)
 {
-    player_t *player = player_get(id);
-    return player->div;
+    char num[NUM_MAX_LEN];
+
+    return buf_append(buf, num, num_format_int(num, val) - num);
 }
 
-unsigned
-player_subdiv(unsigned id)
+int
+buf_put_char(buf_t *buf, char c)
 {
-    player_t *player = player_get(id);
-    return player->sub_div;
+    return buf_append(buf, &c, 1);
 }
 
-void
-player_div_set(unsigned id, float rating)
+// same text as "%0*u"
+int
+buf_put_pad(buf_t *buf, unsigned val, int width)
 {
-    player_t *player = player_get(id);
-    if (player->id > 0) {
-        if (!player_is_rookie(player->id)) {
-            player->div = (unsigned)rating;
-        } else { // rookie
-            player->div = 0;
-        }
-        if (player->div > DIV_IN_USE) {
-            player->div = DIV_IN_USE;
-        }
-        if (rating < 1) {
-            player->sub_div = SUB_DIV_GOLD;
-        } else {
-            player->sub_div = (unsigned)((rating - player->div)*3);
-        }
-        if (player->sub_div > SUB_DIV_BRONZE) {
-            player->sub_div = SUB_DIV_BRONZE;
-        }
-    }
+    char num[NUM_MAX_LEN];
+
+    return buf_append(buf, num, num_format_pad(num, val, width) - num);
 }
 
-unsigned
-player_rating(unsigned id)
+// same text as time_display()
+int
+buf_put_time(buf_t *buf, ttime_t *time)
 {
-    player_t *player = player_get(id);
-    return player->rating;
+    char tbuf[MAX_NAME_LEN];
+
+    return buf_put_str(buf, time_display(tbuf, time));
 }
 
-void
-player_update_rating(player_t *p)
+// same text as "%.*f", decimals 0 to 6
+int
+buf_put_fixed(buf_t *buf, double x, int decimals)
 {
-    double agg, real_agg;
-    double adj_rating;
-    double use_weight;
+    char num[NUM_MAX_LEN];
+    char *end = num_format_fixed(num, x, decimals);
 
-    if (p && p->valid) {
-        p->event_count++;
-        if (dq_ok(p->latest.dq)) {
-            use_weight = p->total_weight;
-            if (use_weight >= RATING_WEIGHT_CAP) {
-                use_weight = RATING_WEIGHT_CAP - p->latest.weight;
-                if (use_weight <= 0) {
-                    use_weight = RATING_WEIGHT_CAP;
-                }
-            }
-            real_agg = (p->real_rating * use_weight) + (p->latest.rating * p->latest.weight);
-            adj_rating = (p->latest.rating < p->rating) ? p->latest.rating : p->rating;
-            agg = (p->rating * use_weight) + (adj_rating * p->latest.weight);
-            use_weight += p->latest.weight;
-            if (use_weight > 0.0f) {
-                p->real_rating = real_agg / use_weight;
-                if(NO_HARM_HANDICAP==TRUE && player_is_rookie(p->id)==FALSE) {
-                    p->rating = agg / use_weight;
-                } else {
-                    p->rating = p->real_rating;
-                }
-            } else {
-                p->rating = 0.0f;
-            }
-            if (p->latest.dq == DQ_VERIFIED)  {
-                p->verified_count += p->latest.weight;
-            }
-            p->total_weight += p->latest.weight; // update total weight
-        } else {
-            p->dq_count++;
-        }
-        if (p->real_rating <= 0.0f) {
-            p->real_rating = p->rating;
-        } else if (p->rating <= 0.0f) {
-            p->rating = p->real_rating;
-        }
+    if (!end) {
+        return buf_printf(buf, "%.*f", decimals, x);
     }
+    return buf_append(buf, num, end - num);
 }
 
-player_t *
-player_lookup_by_psn(char *psn)
+/************************************************/
+// numeric codecs: what atoi(), atof() and "%d"/"%f" do for the numbers in
+// DB and event files, without stdio or the locale.  Anything unusual (an
+// exponent, more digits than a double holds exactly) goes to strtod()
+
+// exact powers of ten: a double holds 10^22 exactly
+static const double g_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// num_parse_int
+// as atoi(), but out-of-range values stop at INT_MIN/INT_MAX
+// output: end: first character not parsed, if not 0
+int
+num_parse_int(char *str, char **end)
 {
-    int i;
-    if (!psn || !psn[0]) {
-        return 0;
+    int64_t val = 0;
+    int neg;
+
+    while (isspace(*str)) {
+        str++;
     }
-    for (i = 1; i <= max_player_id; i++) {
-        if (!strcmp(psn, player_db[i].psn)) {
-            return &player_db[i];
+    neg = (*str == '-');
+    if (*str == '-' || *str == '+') {
+        str++;
+    }
+    for (; *str >= '0' && *str <= '9'; str++) {
+        if (val <= (int64_t)INT_MAX + 1) {
+            val = val * 10 + (*str - '0');
         }
     }
-    return 0;
+    if (end) {
+        *end = str;
+    }
+    if (neg) {
+        return (-val < INT_MIN ? INT_MIN : (int)-val);
+    }
+    return (val > INT_MAX ? INT_MAX : (int)val);
 }
 
-player_t *
-player_lookup_by_name(char *name)
+// num_parse_double
+// the value strtod() and atof() give, to the bit.  Up to 15 significant
+// digits and 22 decimals fit a double exactly, so one division by an exact
+// power of ten gives the correctly rounded value strtod() would
+// output: end: first character not parsed, if not 0
+double
+num_parse_double(char *str, char **end)
 {
-    int i;
-    if (!name || !name[0]) {
-        return 0;
+    char *ptr = str;
+    uint64_t mant = 0;
+    int sig = 0, frac = 0, digits = 0;
+    int neg, point = FALSE;
+    double val;
+
+    while (isspace(*ptr)) {
+        ptr++;
     }
-    for (i = 0; i < max_player_id; i++) {
-        if (!strcmp(name, player_db[i+1].name)) {
-            return &player_db[i+1];
+    neg = (*ptr == '-');
+    if (*ptr == '-' || *ptr == '+') {
+        ptr++;
+    }
+    for (;; ptr++) {
+        if (*ptr >= '0' && *ptr <= '9') {
+            digits++;
+            if (mant || *ptr != '0') {
+                sig++;
+            }
+            mant = mant * 10 + (*ptr - '0');
+            frac += point;
+            if (sig > 15 || frac > 22) {
+                return strtod(str, end);
+            }
+        } else if (*ptr == '.' && !point) {
+            point = TRUE;
+        } else {
+            break;
         }
     }
-    return 0;
+    // no digits (inf, nan), exponents and hex go the long way
+    if (!digits || *ptr == 'e' || *ptr == 'E' || *ptr == 'x' || *ptr == 'X') {
+        return strtod(str, end);
+    }
+    if (end) {
+        *end = ptr;
+    }
+    val = (double)mant / g_pow10[frac];
+    return (neg ? -val : val);
 }
 
-player_t *
-player_get_next(player_iter_t *iter)
+// num_format_int
+// output: out: val in decimal, null terminated (NUM_MAX_LEN will do)
+// returns: the terminating null
+char *
+num_format_int(char *out, int64_t val)
 {
-    player_t *p;
+    char digit[NUM_MAX_LEN];
+    uint64_t u = (val < 0 ? -(uint64_t)val : (uint64_t)val);
+    int n = 0;
+
     do {
-        iter->idx++;
-        p = player_get(iter->idx);
-    } while (iter->idx <= max_player_id && p->valid != TRUE);
-    if (iter->idx > max_player_id) {
-        return 0;
+        digit[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (val < 0) {
+        *out++ = '-';
     }
-    return p;
-}
-
-player_t *
-player_get_first(player_iter_t *iter)
-{
-    iter->idx = 0;
-    return player_get_next(iter);
+    while (n) {
+        *out++ = digit[--n];
+    }
+    *out = 0;
+    return out;
 }
 
-/************************************************/
-// race entry API
-
-entry_t *
-entry_find(entry_t *entry)
+// num_fixed
+// input: x: finite, under DB_FIXED6_MAX; decimals: 0 to 6
+// returns: x in units of 10^-decimals, rounded exactly as printf("%.*f")
+//          rounds it; DB_FIXED6_NEG_ZERO for a negative that rounds to 0
+int64_t
+num_fixed(double x, int decimals)
 {
-    int i;
-    for (i = 0; i < g_entry_cnt; i++) {
-        if (entry->player_id == entry_db[i].player_id) {
-            return &entry_db[i];
+    unsigned __int128 scaled, half, rem;
+    uint64_t mant;
+    int64_t retval;
+    int exp;
+
+    // |x| = mant * 2^exp, exactly
+    mant = (uint64_t)ldexp(frexp(fabs(x), &exp), 53);
+    exp -= 53;
+    scaled = (unsigned __int128)mant * (uint64_t)g_pow10[decimals];
+    if (exp >= 0) {
+        retval = (int64_t)(scaled << exp);
+    } else if (exp > -120) {
+        // round to nearest, ties to even
+        rem = scaled & (((unsigned __int128)1 << -exp) - 1);
+        half = (unsigned __int128)1 << (-exp - 1);
+        scaled >>= -exp;
+        if (rem > half || (rem == half && (scaled & 1))) {
+            scaled++;
         }
+        retval = (int64_t)scaled;
+    } else {
+        retval = 0;
     }
-    return 0;
+    if (signbit(x)) {
+        retval = (retval ? -retval : DB_FIXED6_NEG_ZERO);
+    }
+    return retval;
 }
 
+// num_format_fixed
+// output: out: x as "%.*f" prints it with decimals 0 to 6, null terminated
+//         (NUM_MAX_LEN will do)
+// returns: the terminating null, or 0 for a value only printf itself can
+//          print (inf, nan, or DB_FIXED6_MAX and up)
 char *
-entry_name(entry_t *entry)
+num_format_fixed(char *out, double x, int decimals)
 {
-    if (entry) {
-        return player_name(entry->player_id);
+    int64_t m;
+    uint64_t u, scale = (uint64_t)g_pow10[decimals];
+    int i;
+
+    if (isnan(x) || fabs(x) >= DB_FIXED6_MAX) {
+        return 0;
     }
-    return 0;
+    m = num_fixed(x, decimals);
+    if (m == DB_FIXED6_NEG_ZERO || m < 0) {
+        *out++ = '-';
+    }
+    u = (m == DB_FIXED6_NEG_ZERO ? 0 : (m < 0 ? -(uint64_t)m : (uint64_t)m));
+    out = num_format_int(out, u / scale);
+    if (decimals) {
+        *out++ = '.';
+        u %= scale;
+        for (i = decimals - 1; i >= 0; i--) {
+            out[i] = '0' + u % 10;
+            u /= 10;
+        }
+        out += decimals;
+    }
+    *out = 0;
+    return out;
 }
 
+// num_format_pad: val with at least width digits, zero padded, as "%w.wu"
 char *
-entry_psn(entry_t *entry)
+num_format_pad(char *out, unsigned val, int width)
 {
-    if (entry) {
-        return player_psn(entry->player_id);
+    char *end = num_format_int(out, val);
+    int len = end - out;
+
+    if (len < width) {
+        memmove(out + width - len, out, len + 1);
+        memset(out, '0', width - len);
+        end = out + width;
     }
-    return 0;
+    return end;
 }
 
-char
-entry_rookie(entry_t *entry)
+// returns: element idx, allocating a zeroed chunk for it if needed;
+// 0 if out of memory
+void *
+pool_get(pool_t *pool, unsigned idx)
 {
-    char retval = '-';
-    if (entry && player_is_rookie(entry->player_id)) {
-        retval = 'R';
+    unsigned c = idx >> POOL_CHUNK_SHIFT;
+    unsigned cnt;
+    char **dir;
+
+    if (c >= pool->chunk_cnt) {
+        for (cnt = (pool->chunk_cnt ? pool->chunk_cnt : 16); cnt <= c; cnt *= 2);
+        dir = realloc(pool->chunk, cnt * sizeof(char *));
+        if (!dir) {
+            return 0;
+        }
+        memset(dir + pool->chunk_cnt, 0, (cnt - pool->chunk_cnt) * sizeof(char *));
+        pool->chunk = dir;
+        pool->chunk_cnt = cnt;
     }
-    return retval;
-}
-
-unsigned
-entry_div(entry_t *entry)
-{
-    unsigned retval = 0;
-    if (entry) {
-        retval =  player_div(entry->player_id);
-        if (!retval) {
-            retval = entry->prov_div;
+    if (!pool->chunk[c]) {
+        pool->chunk[c] = calloc(POOL_CHUNK_SIZE, pool->elem_size);
+        if (!pool->chunk[c]) {
+            return 0;
         }
     }
-    return retval;
-}
-
-unsigned
-entry_subdiv(entry_t *entry)
-{
-    unsigned retval = 0;
-    if (entry) {
-        retval =  player_subdiv(entry->player_id);
-    }
-    return retval;
+    return pool->chunk[c] + (idx & (POOL_CHUNK_SIZE-1)) * pool->elem_size;
 }
-
 int
-entry_watch(entry_t *e)
+dq_ok(dq_reason_e dq)
 {
-    if (e->rating*3.0f < (entry_div(e)*3.0f + entry_subdiv(e))) {
+    if (dq == DQ_OK || dq == DQ_VERIFIED || dq == DQ_SUBMITTED) {
         return TRUE;
     }
     return FALSE;
 }
 
-int
-entry_struggle(entry_t *e)
+// dq_parse: the Disq: value of an event file, by its first letter
+dq_reason_e
+dq_parse(char *ptr)
 {
-    if (entry_div(e) >= DIV_IN_USE-1) {
-        return FALSE;
-    }
-    if (e->prov_div > entry_div(e) && e->hcp_delta > (SUB_DIVISION_RANGE*2.0f)) {
-        return TRUE;
-    }
-    return FALSE;
+    if (toupper(*ptr) == 'O') {
+        return DQ_OFF_TRACK;
+    } else if (toupper(*ptr) == 'C') {
+        return DQ_CONTACT;
+    } else if (toupper(*ptr) == 'R') {
+        return DQ_NO_REPLAY;
+    } else if (toupper(*ptr) == 'T') {
+        return DQ_TIME_ERROR;
+    } else if (toupper(*ptr) == 'N') {
+        return DQ_NAME_VIOLATION;
+    } else if (toupper(*ptr) == 'X') {
+        return DQ_CUSTOM_VIOLATION;
+    } else if ((toupper(*ptr) == 'S') || (toupper(*ptr) == 'U')) { // unchecked
+        return DQ_SUBMITTED;
+    } else if (toupper(*ptr) == 'V' || toupper(*ptr) == 'G') {
+        return DQ_VERIFIED;
+    }
+    return DQ_OK;
 }
 
-int 
-entry_need_replay(entry_t *e)
+unsigned
+entry_points(entry_t *entry, unsigned racers)
 {
-    if (g_event.status != STATUS_FINAL &&
-        ((e->place <= 3) ||
-         (player_is_rookie(e->player_id)) ||
-         (e->hcp_delta < -(SUB_DIVISION_RANGE)) ) ) {
-        return TRUE;
-    }
-    return FALSE;
-}
+    int idx = racers;
+    unsigned points = 0;
 
-char *
-entry_replay_string(entry_t *e)
-{
-    char *retval = "";
-    if (e->dq >= DQ_VERIFIED) {
-        retval =  g_dq_display_text[e->dq];
-    } else if (entry_need_replay(e)) {
-        retval =  g_replay_request_string;
+    if (dq_ok(entry->dq)) {
+        // non-DQ score at least MIN_POINTS (usually 0 or 1)
+        points = MIN_POINTS;
+        // only calculate points if place is within score range 
+        if (entry->place <= MAX_POINTS_PLACES) {
+            // cap row
+            if (idx > MAX_RACER_POINTS) {
+                idx = MAX_RACER_POINTS;
+            }
+            points = g_points_table[idx][entry->place];
+            if (points < MIN_POINTS) {
+                points = MIN_POINTS;
+            }
+        }
     }
-    return retval;
+    return points;
 }
 
-char *
-entry_dq_flag(entry_t *e)
+/************************************************/
+// phase tracing.  With db->trace unset, trace_begin() and trace_end() are a
+// test and a return, so the calls can stay in; with it set, a span is four
+// clock reads and a locked append
+
+double
+trace_clock(clockid_t id)
 {
-    char *retval = "";
-    if (e->dq == DQ_VERIFIED) {
-        retval = g_dq_flag_url[FLAG_GREEN];
-    } else if (e->dq >= DQ_NO_REPLAY) {
-        retval = g_dq_flag_url[FLAG_BLACK];
-    } else if (e->dq >= DQ_OFF_TRACK) {
-        retval = g_dq_flag_url[FLAG_RED];
-    }
-    return retval;
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-int
-entry_dq_match(dq_reason_e status, dq_iter_e query)
+// file: where trace_free() writes the Chrome trace events, 0 for the
+// totals alone
+// returns: the trace, 0 if out of memory
+trace_t *
+trace_create(FILE *file)
 {
-    if (query == ITER_DQ_ALL) {
-        return TRUE;
-    } else if (query == ITER_DQ_OK) {
-        return dq_ok(status);
-    } else {
-        return !dq_ok(status);
+    trace_t *trace = calloc(1, sizeof(trace_t));
+
+    if (!trace) {
+        return 0;
     }
+    pthread_mutex_init(&trace->lock, 0);
+    trace->file = file;
+    trace->start = trace_clock(CLOCK_MONOTONIC);
+    return trace;
 }
 
-unsigned
-entry_match(entry_iter_t *iter)
+// write the trace file and, to summary if given, the totals per phase
+void
+trace_free(trace_t *trace, FILE *summary)
 {
-    if (!iter->cur || !iter->cur->entry) {
-        return FALSE;
+    trace_total_t *t;
+    unsigned i;
+
+    if (!trace) {
+        return;
     }
-    if (((iter->div == DIV_ALL) ||
-         (entry_div(iter->cur->entry) == iter->div)) &&
-            entry_dq_match(iter->cur->entry->dq, iter->dq)) {
-        return TRUE;
+    if (trace->file) {
+        fputs("{\"traceEvents\":[\n", trace->file);
+        if (trace->events.len > 2) {
+            trace->events.len -= 2; // the last ",\n"
+            buf_put_char(&trace->events, '\n');
+            buf_flush(&trace->events, trace->file);
+        }
+        fputs("],\"displayTimeUnit\":\"ms\"}\n", trace->file);
+    }
+    if (summary) {
+        fprintf(summary, "------phases------\n");
+        fprintf(summary, "%-20s %6s %11s %11s %12s %10s\n", "phase", "count", "wall ms", "cpu ms", "bytes", "items");
+        for (i = 0; i < trace->total_cnt; i++) {
+            t = &trace->total[i];
+            fprintf(summary, "%-20s %6u %11.3f %11.3f %12lld %10lld\n", t->name, t->count,
+                    t->wall * 1e3, t->cpu * 1e3, (long long)t->bytes, (long long)t->items);
+        }
     }
-    return FALSE;
-}
-
-entry_t *
-entry_get_next(entry_iter_t *iter)
-{
-    do {
-        iter->cur = iter->cur->next;
-    } while (iter->cur && !entry_match(iter));
-    return (iter->cur ? iter->cur->entry : 0);
+    buf_free(&trace->events);
+    pthread_mutex_destroy(&trace->lock);
+    free(trace);
 }
 
-entry_t *
-entry_get_first(entry_iter_t *iter, entry_link_t *head, int div, dq_iter_e dq)
+void
+trace_begin(trace_t *trace, trace_span_t *span, const char *name)
 {
-    iter->div = div;
-    iter->dq = dq;
-    iter->cur = head;
-    if (iter->cur && !entry_match(iter)) {
-        entry_get_next(iter);
+    span->name = 0;
+    if (!trace) {
+        return;
     }
-    return (iter->cur ? iter->cur->entry : 0);
+    span->name = name;
+    span->wall = trace_clock(CLOCK_MONOTONIC);
+    span->cpu = trace_clock(CLOCK_THREAD_CPUTIME_ID);
 }
 
-int comparisons = 0;
-int
-player_compare(const void *a, const void *b)
+// bytes, items: how much the phase read or wrote, and of what it handled
+// (players, entries), 0 for none
+void
+trace_end(trace_t *trace, trace_span_t *span, int64_t bytes, int64_t items)
 {
-comparisons++;
-    player_link_t *left = (player_link_t *)a;
-    player_link_t *right = (player_link_t *)b;
-    if (left->player->rating < right->player->rating) {
-        -1;
-    } else if (left->player->rating > right->player->rating) {
-        1;
+    double wall, cpu;
+    pthread_t self;
+    trace_total_t *t;
+    unsigned i, tid;
+
+    if (!trace || !span->name) {
+        return;
     }
-    return 0;
+    wall = trace_clock(CLOCK_MONOTONIC) - span->wall;
+    cpu = trace_clock(CLOCK_THREAD_CPUTIME_ID) - span->cpu;
+    self = pthread_self();
+
+    pthread_mutex_lock(&trace->lock);
+    for (tid = 0; tid < trace->thread_cnt && !pthread_equal(trace->thread[tid], self); tid++);
+    if (tid == trace->thread_cnt && tid < TRACE_THREADS_MAX) {
+        trace->thread[trace->thread_cnt++] = self;
+    }
+    for (i = 0; i < trace->total_cnt && strcmp(trace->total[i].name, span->name); i++);
+    if (i == trace->total_cnt && i < TRACE_PHASES_MAX) {
+        trace->total[trace->total_cnt++].name = span->name;
+    }
+    if (i < trace->total_cnt) {
+        t = &trace->total[i];
+        t->count++;
+        t->wall += wall;
+        t->cpu += cpu;
+        t->bytes += bytes;
+        t->items += items;
+    }
+    if (trace->file) {
+        // a complete event, times in us
+        buf_put_str(&trace->events, "{\"name\":\"");
+        buf_put_str(&trace->events, span->name);
+        buf_put_str(&trace->events, "\",\"cat\":\"wrsort\",\"ph\":\"X\",\"ts\":");
+        buf_put_fixed(&trace->events, (span->wall - trace->start) * 1e6, 3);
+        buf_put_str(&trace->events, ",\"dur\":");
+        buf_put_fixed(&trace->events, wall * 1e6, 3);
+        buf_put_str(&trace->events, ",\"pid\":");
+        buf_put_int(&trace->events, getpid());
+        buf_put_str(&trace->events, ",\"tid\":");
+        buf_put_int(&trace->events, tid + 1);
+        buf_put_str(&trace->events, ",\"args\":{\"cpu_us\":");
+        buf_put_fixed(&trace->events, cpu * 1e6, 3);
+        buf_put_str(&trace->events, ",\"bytes\":");
+        buf_put_int(&trace->events, bytes);
+        buf_put_str(&trace->events, ",\"items\":");
+        buf_put_int(&trace->events, items);
+        buf_put_str(&trace->events, "}},\n");
+    }
+    pthread_mutex_unlock(&trace->lock);
 }
 
+/************************************************/
+// hot-path counters: which paths a run takes, and how often.  Threads count
+// into their own g_thread_counter; counter_flush() adds them to the run's
+// totals, at the end of each worker thread and before the report
+
+char g_counter_name[][MAX_NAME_LEN] = {
+    "label_lookup",       // COUNTER_LABEL_LOOKUP
+    "label_miss",         // COUNTER_LABEL_MISS
+    "label_parse_fail",   // COUNTER_LABEL_PARSE_FAIL
+    "psn_lookup",         // COUNTER_PSN_LOOKUP
+    "psn_probe",          // COUNTER_PSN_PROBE
+    "name_lookup",        // COUNTER_NAME_LOOKUP
+    "name_probe",         // COUNTER_NAME_PROBE
+    "probe_max",          // COUNTER_PROBE_MAX
+    "entry_next",         // COUNTER_ENTRY_NEXT
+    "entry_visit",        // COUNTER_ENTRY_VISIT
+    "time_to_usec",       // COUNTER_TIME_TO_USEC
+    "auto_cycle",         // COUNTER_AUTO_CYCLE
+    "history_swap",       // COUNTER_HISTORY_SWAP
+};
+
+#ifndef WRSORT_NO_COUNTERS
+__thread uint64_t g_thread_counter[COUNTER_ENUM_COUNT];
+#endif
+uint64_t g_counter_total[COUNTER_ENUM_COUNT];
+pthread_mutex_t g_counter_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void
-bsort(player_link_t *base, size_t num, size_t size, int (*compare)(const void*, const void*))
+counter_flush(void)
 {
-    int i, j;
-    player_t *tmp;
-    for (i = 0; i < num; i++) {
-        for (j = i+1; j < num; j++) {
-            if (base[i].player->rating > base[j].player->rating) {
-comparisons++;
-                tmp = base[i].player;
-                base[i].player = base[j].player;
-                base[j].player = tmp;
+#ifndef WRSORT_NO_COUNTERS
+    int c;
+
+    pthread_mutex_lock(&g_counter_lock);
+    for (c = 0; c < COUNTER_ENUM_COUNT; c++) {
+        if (c == COUNTER_PROBE_MAX) {
+            if (g_counter_total[c] < g_thread_counter[c]) {
+                g_counter_total[c] = g_thread_counter[c];
             }
+        } else {
+            g_counter_total[c] += g_thread_counter[c];
         }
+        g_thread_counter[c] = 0;
     }
+    pthread_mutex_unlock(&g_counter_lock);
+#endif
 }
 
-player_link_t *
-player_sort(int div, sub_div_e sub)
+// the totals so far, this thread's included: a table, or one JSON object
+void
+counter_report(FILE *file, int json)
 {
-    player_t *player;
-    int p = 0;
-    int i;
-    for (i = 0; i <= player_cnt; i++) {
-        p_sort[i].player = 0;
-    }
-    for (i = 1; i <= player_cnt; i++) {
-        player = &player_db[i];
-        if (player->div == div && player->sub_div == sub) {
-            p_sort[p++].player = player;
+    int c;
+
+    counter_flush();
+    if (json) {
+        fputc('{', file);
+        for (c = 0; c < COUNTER_ENUM_COUNT; c++) {
+            fprintf(file, "%s\"%s\":%llu", (c ? "," : ""), g_counter_name[c], (unsigned long long)g_counter_total[c]);
         }
+        fputs("}\n", file);
+        return;
     }
-    if (p > 1) {
-//        qsort(p_sort, p, sizeof(player_link_t), player_compare);
-        bsort(p_sort, p, sizeof(player_link_t), player_compare);
-        printf("D%d qsort: %d elements, %d comparisons\n", div, p, comparisons);
-        comparisons = 0;
+    fprintf(file, "------counters------\n");
+#ifdef WRSORT_NO_COUNTERS
+    fprintf(file, "(built without counters)\n");
+#endif
+    for (c = 0; c < COUNTER_ENUM_COUNT; c++) {
+        fprintf(file, "%-20s %12llu\n", g_counter_name[c], (unsigned long long)g_counter_total[c]);
     }
-    return p_sort;
 }
 
 /************************************************/
-// event entry API
-int
-event_season_active()
+// player DB interface
+player_t *
+player_get(player_db_t *db, unsigned id)
+{ 
+    player_t *p = pool_peek(&db->pool, id);
+
+    if (!p) { 
+        p = pool_peek(&db->pool, NULL_PLAYER);
+    }
+    return p;
+}
+
+// returns: player slot id, allocating storage for it if needed
+player_t *
+player_alloc(player_db_t *db, unsigned id)
 {
-    if (g_event.season) {
-        return TRUE;
-    } else {
-        return FALSE;
+    if (id >= MAX_PLAYERS) {
+        return 0;
     }
+    return pool_get(&db->pool, id);
 }
 
-int
-event_season()
+/************************************************/
+// player hash index (PSN, user name)
+unsigned
+index_hash(char *key)
 {
-    return g_event.season;
+    unsigned hash = 2166136261u; // FNV-1a
+
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-int
-event_season_race()
+char *
+index_key(player_index_t *index, player_t *p)
 {
-    return g_event.season_race;
+    return (char *)p + index->key;
 }
 
-/************************************************/
-// init
 void
-init_db()
+index_reset(player_index_t *index)
 {
-    int i;
-
-    g_entry_cnt = 0;
-
-    // init event
-    memset(&g_event, 0, sizeof(event_t));
-    g_event.par_multiple = flat_par_multiple;
-    g_event.trophy_multiple = qual_trophy_multiple;
-    g_event.squeeze = DEFAULT_SQUEEZE;
-    g_event.scoot = DEFAULT_SCOOT;
-    g_event.weight = 1.0f;
-    g_event.auto_squeeze = TRUE;
-    g_event.auto_scoot = TRUE;
-    strcpy(g_event.comment, "Good job everyone!");
-
-    for (i = 0; i < MAX_PLAYERS; i++) {
-        memset(&player_db[i], 0, sizeof(player_t));
-    }
-    player_create("NULL", "NULL"); // add player 0
-    for (i = 0; i < MAX_RACERS; i++) {
-        memset(&entry_db[i], 0, sizeof(entry_t));
-    }
-    ov_head = 0;
-    rat_head = 0;
-    for (i = 0; i <= DIV_COUNT; i++) {
-        memset(&div_stat[i], 0, sizeof(stat_t));
-        custom_trophy_adjust[i] = 0.0;
-        custom_par_multiple[i] = default_par_multiple[i];
-    }
-    memset(&ostat, 0, sizeof(stat_t));
+    free(index->slot);
+    index->slot = 0;
+    index->size = 0;
+    index->used = 0;
 }
 
-/************************************************/
-// generic file scanner...
+// rebuild the slot table sized for the live entries, dropping tombstones
 int
-scan_to(FILE *file, char *string, int max_lines)
+index_grow(player_index_t *index)
 {
-    char cur_line[MAX_LINE_LEN];
-    int len = strlen(string);
-    while (!feof(file) && ((max_lines--) > 0)) {
-        if (fgets(cur_line, MAX_LINE_LEN-1, file) == 0) {
-            continue;
+    index_slot_t *old = index->slot;
+    unsigned old_size = index->size;
+    unsigned live = 0;
+    unsigned size, mask, i, j;
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i].id != INDEX_EMPTY && old[i].id != INDEX_DELETED) {
+            live++;
         }
-        if (!strncmp(cur_line, string, len)) {
-            return SUCCESS;
+    }
+    size = INDEX_MIN_SIZE;
+    while (size < (live+1)*4) {
+        size *= 2;
+    }
+    index->slot = calloc(size, sizeof(index_slot_t));
+    if (!index->slot) {
+        index->slot = old;
+        return FAILURE;
+    }
+    index->size = size;
+    index->used = live;
+    mask = size - 1;
+    for (i = 0; i < old_size; i++) {
+        if (old[i].id != INDEX_EMPTY && old[i].id != INDEX_DELETED) {
+            for (j = old[i].hash & mask; index->slot[j].id != INDEX_EMPTY; j = (j+1) & mask);
+            index->slot[j] = old[i];
         }
     }
-    // may want to rewind in fail case
-    fprintf(stderr, "scan_to(%s), len=%d not found\n", string, len);
-    return FAILURE;
+    free(old);
+    return SUCCESS;
 }
 
-int
-label_end(char c)
+void
+index_insert(player_index_t *index, player_t *p)
 {
-    if (c == ':') {
-//    if (c == ' ') {
-        return TRUE;
+    char *key = index_key(index, p);
+    unsigned hash, mask, i;
+
+    if (p->id == NULL_PLAYER || !*key) {
+        return;
     }
-    return FALSE;
+    if ((index->used+1)*2 > index->size && index_grow(index) == FAILURE) {
+        if (index->used+1 >= index->size) {
+            fprintf(stderr, "index_insert: out of memory\n");
+            return;
+        }
+    }
+    hash = index_hash(key);
+    mask = index->size - 1;
+    for (i = hash & mask;
+            index->slot[i].id != INDEX_EMPTY && index->slot[i].id != INDEX_DELETED;
+            i = (i+1) & mask);
+    if (index->slot[i].id == INDEX_EMPTY) {
+        index->used++;
+    }
+    index->slot[i].id = p->id;
+    index->slot[i].hash = hash;
 }
 
-int
-label_len(char *str)
+// must be called before the key field changes
+void
+index_remove(player_index_t *index, player_t *p)
 {
-    int len = 0;
+    char *key = index_key(index, p);
+    unsigned hash, mask, i;
 
-    if (!str) {
-        return 0;
+    if (!index->size || p->id == NULL_PLAYER || !*key) {
+        return;
     }
-    while (*str && !label_end(*str) && (len < MAX_STR_LEN)) {
-        len++;
-        str++;
+    hash = index_hash(key);
+    mask = index->size - 1;
+    for (i = hash & mask; index->slot[i].id != INDEX_EMPTY; i = (i+1) & mask) {
+        if (index->slot[i].id == p->id) {
+            index->slot[i].id = INDEX_DELETED;
+            return;
+        }
     }
-    len++; // skip past label end
-    return len;
 }
 
-char *
-label_skip(char *str)
+// returns: lowest id player whose key matches (same as a linear scan)
+player_t *
+index_lookup(player_db_t *db, player_index_t *index, char *key)
 {
-    int len = 0;
+    unsigned hash, mask, i, id;
+    unsigned best = INDEX_EMPTY, probes = 0;
+    int psn = (index == &db->psn_index);
 
-    if (!str) {
+    COUNT((psn ? COUNTER_PSN_LOOKUP : COUNTER_NAME_LOOKUP), 1);
+    if (!index->size) {
         return 0;
     }
-    len = label_len(str);
-    str += len;
-    // skip past space following label
-    while (isspace(*str) && len < MAX_STR_LEN) {
-        len++;
-        str++;
+    hash = index_hash(key);
+    mask = index->size - 1;
+    for (i = hash & mask; index->slot[i].id != INDEX_EMPTY; i = (i+1) & mask) {
+        probes++;
+        id = index->slot[i].id;
+        if (id != INDEX_DELETED && index->slot[i].hash == hash &&
+                (best == INDEX_EMPTY || id < best) &&
+                !strcmp(key, index_key(index, player_get(db, id)))) {
+            best = id;
+        }
     }
-    return str;
+    COUNT((psn ? COUNTER_PSN_PROBE : COUNTER_NAME_PROBE), probes);
+    COUNT_MAX(COUNTER_PROBE_MAX, probes);
+    return (best == INDEX_EMPTY ? 0 : player_get(db, best));
 }
 
-int
-label_copy_toupper(char *out, char *in)
+void
+player_set_psn(player_db_t *db, player_t *p, char *psn)
 {
-    int len = 0;
-    // skip past leading spaces
-    while (isspace(*in) && len < MAX_STR_LEN) {
-        in++;
-        len++;
-    }
-    // copy label
-    while (!isspace(*in) && len < MAX_STR_LEN) {
-        len++;
-        *out++ = toupper(*in++);
-    }
-    // null terminate copy
-    *out = 0;
-    return len;
+    index_remove(&db->psn_index, p);
+    strncpy(p->psn, psn, MAX_NAME_LEN-1);
+    p->psn[MAX_NAME_LEN-1] = 0;
+    index_insert(&db->psn_index, p);
 }
 
-// label_get
-// input: string: pointer to string to search for label
-// returns: id of string found, or LABEL_NONE
-label_e
-label_get(char *string)
+void
+player_set_name(player_db_t *db, player_t *p, char *name)
 {
-    label_e label;
-    size_t offset;
-    char copy[MAX_STR_LEN];
+    index_remove(&db->name_index, p);
+    strncpy(p->name, name, MAX_NAME_LEN-1);
+    p->name[MAX_NAME_LEN-1] = 0;
+    index_insert(&db->name_index, p);
+}
 
-    if (!string) {
-        return LABEL_NONE;
-    }
-    offset = label_copy_toupper(copy, string);
-    if (offset == 0) {
-        return LABEL_NONE;
+player_t *
+player_create(player_db_t *db, char *name, char *psn)
+{
+    player_t *p;
+    p = player_alloc(db, db->max_player_id+1);
+    if (!p) {
+        printf("max_player_id = %d; MAX_PLAYERS=%d\n", db->max_player_id, MAX_PLAYERS);
+        return 0;
     }
 
-    for (label = LABEL_COMMENT; label < LABEL_ENUM_COUNT; label++) {
-        if (!strncmp(copy, g_label[label], strlen(g_label[label]))) {
-            // found label
-            return label;
-        }
+    db->player_cnt++;
+    p->id = ++db->max_player_id;
+    if (p->id > 0) {
+        p->valid = TRUE;
     }
-    return LABEL_NONE;
+    player_set_name(db, p, (name ? name : "NULL"));
+    player_set_psn(db, p, (psn ? psn : "NULL"));
+    p->real_rating = 0.0f;
+    p->rating = 0.0f;
+    p->total_weight = 0.0f;
+    p->div = 0;     // division 1-5; 0 = rookie/unknown
+    p->sub_div = SUB_DIV_GOLD; // gold/silver/bronze
+    p->event_count = 0;
+    p->dq_count = 0;
+    p->dirty = TRUE;
+
+    return p;
 }
 
-int
-string_copy(char *out, char *in)
+// player_clear: back to an empty record, keeping the id and the names the
+// indexes hash
+void
+player_clear(player_t *p)
 {
-    int len = 0;
-    if (out && in) {
-        while (isprint(*in) && len < MAX_STR_LEN) {
+    player_t keep = *p;
+
+    memset(p, 0, sizeof(player_t));
+    p->id = keep.id;
+    p->valid = keep.valid;
+    memcpy(p->name, keep.name, MAX_NAME_LEN);
+    memcpy(p->psn, keep.psn, MAX_NAME_LEN);
+}
+
+char *
+quote_strip(char *out, char *in)
+{
+    char *ret = out;
+
+    while (*in) {
+        if (*in == '\"') {
+            in++;
+        } else {
             *out++ = *in++;
-            len++;
         }
-        *out = 0;
     }
-    return len;
+    *out = 0;
+    return ret;
 }
 
-int
-field_len(char *str)
+// output: out, at least MAX_NAME_LEN
+char *
+player_name(player_db_t *db, char *out, unsigned id)
 {
-    int len = 0;
+    player_t *player = player_get(db, id);
 
-    if (!str) {
-        return 0;
+    return quote_strip(out, player->name);
+}
+
+char *
+player_psn(player_db_t *db, unsigned id)
+{
+    player_t *player = player_get(db, id);
+    return player->psn;
+}
+
+// output: out, at least MAX_NAME_LEN
+char *
+player_country(player_db_t *db, char *out, unsigned id)
+{
+    player_t *player = player_get(db, id);
+
+    return quote_strip(out, player->country);
+}
+
+unsigned
+player_rookie(player_t *player)
+{
+    if (player->qualifier.status == STATUS_FINAL ||
+        ((player->total_weight >= ROOKIE_TIME) &&
+         (player->verified_count >= ROOKIE_TIME))) {
+        return FALSE;
     }
-    if (*str == '\"') {
-        len++;
-        str++;
-        while (*str && (*str != '\"') && len < MAX_STR_LEN) { 
-            len++;
-            str++;
+    return TRUE;
+}
+
+unsigned
+player_is_rookie(player_db_t *db, unsigned id)
+{
+    return player_rookie(player_get(db, id));
+}
+
+unsigned
+player_div(player_db_t *db, unsigned id)
+{
+    player_t *player = player_get(db, id);
+    return player->div;
+}
+
+unsigned
+player_subdiv(player_db_t *db, unsigned id)
+{
+    player_t *player = player_get(db, id);
+    return player->sub_div;
+}
+
+void
+player_div_set(player_db_t *db, unsigned id, float rating)
+{
+    player_t *player = player_get(db, id);
+    if (player->id > 0) {
+        player->dirty = TRUE;
+        if (!player_rookie(player)) {
+            player->div = (unsigned)rating;
+        } else { // rookie
+            player->div = 0;
         }
-        if (len < MAX_STR_LEN) {
-            len++;
+        if (player->div > DIV_IN_USE) {
+            player->div = DIV_IN_USE;
         }
-    } else {
-        while (*str && !isspace(*str) && len < MAX_STR_LEN) {
-            len++;
-            str++;
+        if (rating < 1) {
+            player->sub_div = SUB_DIV_GOLD;
+        } else {
+            player->sub_div = (unsigned)((rating - player->div)*3);
+        }
+        if (player->sub_div > SUB_DIV_BRONZE) {
+            player->sub_div = SUB_DIV_BRONZE;
         }
     }
-    return len;
 }
 
-char *
-field_copy(char *dst, char *src) {
-    // strip quotes
-    int len = field_len(src);
-    if (len < 2 && (len == 0 || *src == '\"')) {
-        return 0;
-    }
-    int offset = 0;
-    if (*src == '\"') {
-        offset = 1;
-    }
-    strncpy(dst, src+offset, len-(2*offset));
-    dst[len-(2*offset)] = 0;
-    return dst + len;
+unsigned
+player_rating(player_db_t *db, unsigned id)
+{
+    player_t *player = player_get(db, id);
+    return player->rating;
 }
 
-char *
-field_skip(char *str)
+void
+player_update_rating(player_t *p)
 {
-    int len = 0;
+    double agg, real_agg;
+    double adj_rating;
+    double use_weight;
 
-    if (!str) {
-        return 0;
+    if (p && p->valid) {
+        p->event_count++;
+        if (dq_ok(p->latest.dq)) {
+            use_weight = p->total_weight;
+            if (use_weight >= RATING_WEIGHT_CAP) {
+                use_weight = RATING_WEIGHT_CAP - p->latest.weight;
+                if (use_weight <= 0) {
+                    use_weight = RATING_WEIGHT_CAP;
+                }
+            }
+            real_agg = (p->real_rating * use_weight) + (p->latest.rating * p->latest.weight);
+            adj_rating = (p->latest.rating < p->rating) ? p->latest.rating : p->rating;
+            agg = (p->rating * use_weight) + (adj_rating * p->latest.weight);
+            use_weight += p->latest.weight;
+            if (use_weight > 0.0f) {
+                p->real_rating = real_agg / use_weight;
+                if(NO_HARM_HANDICAP==TRUE && player_rookie(p)==FALSE) {
+                    p->rating = agg / use_weight;
+                } else {
+                    p->rating = p->real_rating;
+                }
+            } else {
+                p->rating = 0.0f;
+            }
+            if (p->latest.dq == DQ_VERIFIED)  {
+                p->verified_count += p->latest.weight;
+            }
+            p->total_weight += p->latest.weight; // update total weight
+        } else {
+            p->dq_count++;
+        }
+        if (p->real_rating <= 0.0f) {
+            p->real_rating = p->rating;
+        } else if (p->rating <= 0.0f) {
+            p->rating = p->real_rating;
+        }
     }
-    len = field_len(str);
-    str += len;
+}
 
-    // skip past space following field
-    while (isspace(*str) && len < MAX_STR_LEN) {
-        len++;
-        str++;
+player_t *
+player_lookup_by_psn(player_db_t *db, char *psn)
+{
+    if (!psn || !psn[0]) {
+        return 0;
     }
-    return str;
+    return index_lookup(db, &db->psn_index, psn);
 }
 
-int
-parse_time(char *str, ttime_t *time)
+player_t *
+player_lookup_by_name(player_db_t *db, char *name)
 {
-    if (!str || !time) {
-        return FAILURE;
-    }
-    time->min = atoi(str);
-    while (isdigit(*str)) str++;
-    while (*str && !isdigit(*str)) str++;
-    time->sec = atoi(str);
-    while (isdigit(*str)) str++;
-    if (isspace(*str)) {
-        // sec.msec format
-        time->msec = time->sec;
-        time->sec = time->min;
-        time->min = 0;
-    } else {
-        while (*str && !isdigit(*str)) str++;
-        time->msec = atoi(str);
+    if (!name || !name[0]) {
+        return 0;
     }
-    while (time->sec > 60) {
-        time->min++;
-        time->sec -= 60;
+    return index_lookup(db, &db->name_index, name);
+}
+
+player_t *
+player_get_next(player_iter_t *iter)
+{
+    player_db_t *db = iter->db;
+    player_t *p;
+    do {
+        iter->idx++;
+        p = player_get(db, iter->idx);
+    } while (iter->idx <= db->max_player_id && p->valid != TRUE);
+    if (iter->idx > db->max_player_id) {
+        return 0;
     }
-    return SUCCESS;
+    return p;
+}
+
+player_t *
+player_get_first(player_db_t *db, player_iter_t *iter)
+{
+    iter->db = db;
+    iter->idx = 0;
+    return player_get_next(iter);
 }
 
 /************************************************/
-// time functions
+// time conversion, needed by the entry columns
 int
 time_to_usec(ttime_t *t)
 {
+    COUNT(COUNTER_TIME_TO_USEC, 1);
     return (t->min * 60 * 1000) + (t->sec * 1000) + t->msec;
 }
 
@@ -1332,637 +1347,2039 @@ time_from_usec(ttime_t *t, int usec)
     }
 }
 
-int
-time_compare(entry_t *left, entry_t *right)
+/************************************************/
+// race entry API
+
+// returns: entry slot idx, allocating storage for it if needed
+entry_t *
+entry_get(context_t *ctx, unsigned idx)
 {
-    return time_to_usec(&left->time) - time_to_usec(&right->time);
+    return pool_get(&ctx->entry_pool, idx);
 }
 
-void
-time_add(ttime_t *dest, ttime_t *a, ttime_t *b)
+entry_t *
+entry_find(context_t *ctx, entry_t *entry)
 {
-    int usec;
-    if (dest && a && b) {
-        usec = time_to_usec(a) + time_to_usec(b);
-        time_from_usec(dest, usec);
+    int i;
+    for (i = 0; i < ctx->entry_cnt; i++) {
+        if (entry->player_id == entry_get(ctx, i)->player_id) {
+            return entry_get(ctx, i);
+        }
+    }
+    return 0;
+}
+
+// returns: pool index of the player's entry, -1 if there is none
+int
+entry_index(context_t *ctx, unsigned player_id)
+{
+    int i;
+    for (i = 0; i < ctx->entry_cnt; i++) {
+        if (player_id == entry_get(ctx, i)->player_id) {
+            return i;
+        }
     }
+    return -1;
 }
 
+// entry_remove: drop entry idx, keeping the rest in input order, which
+// breaks time ties.  Entry pointers from idx on move, so the lists need
+// time_sort_entries() again
 void
-time_subtract(ttime_t *dest, ttime_t *a, ttime_t *b)
+entry_remove(context_t *ctx, unsigned idx)
 {
-    int usec;
-    if (dest && a && b) {
-        usec = time_to_usec(a) - time_to_usec(b);
-        time_from_usec(dest, usec);
+    if (idx >= ctx->entry_cnt) {
+        return;
+    }
+    for (; idx + 1 < ctx->entry_cnt; idx++) {
+        *entry_get(ctx, idx) = *entry_get(ctx, idx + 1);
     }
+    ctx->entry_cnt--;
 }
 
-char *
-time_display(ttime_t *time)
+// entries only count once parsing has found their player, so the cached
+// pointer is always set
+player_t *
+entry_player(entry_t *entry)
 {
-    static char sbuf[MAX_NAME_LEN];
-    sprintf(sbuf, "%u'%2.2u.%3.3u", (unsigned char)time->min, (unsigned char)time->sec, (unsigned short)time->msec);
-    return sbuf;
+    return entry->player;
 }
 
-entry_link_t *
-time_insert(entry_link_t *head, entry_link_t *link, entry_t *entry)
+char *
+entry_psn(entry_t *entry)
 {
-    entry_link_t *prev, *cur;
-
-    link->entry = entry;
-    prev = 0;
-    cur = head;
-    while (cur && time_compare(cur->entry, entry) < 0) {
-        prev = cur;
-        cur = cur->next;
-    }
-    if (prev == 0) { // new head
-        head = link;
-    } else {
-        prev->next = link;
+    if (entry) {
+        return entry_player(entry)->psn;
     }
-    link->next = cur;
-    return head; // return new head
+    return 0;
 }
 
-double
-weight_adjust(double player_rating, double event_rating)
+char
+entry_rookie(entry_t *entry)
 {
-    double delta = event_rating - player_rating;
-
-    if (player_rating <= 0.0f || delta < 1.0f) {
-        delta = 1.0f;
+    char retval = '-';
+    if (entry && player_rookie(entry_player(entry))) {
+        retval = 'R';
     }
-    return (1.0f/2.0f + 1.0f/(2.0f*delta));
+    return retval;
 }
 
-void
-time_rate(entry_t *e)
+unsigned
+entry_div(entry_t *entry)
 {
-    player_t *player;
-    double base, range;
-    stat_t *div;
-    unsigned subdiv;
-
-    div = &div_stat[e->prov_div];
-    e->rating = 3.0*(e->prov_div);
-    if (time_to_usec(&e->time) < time_to_usec(&div->gold)) {
-        subdiv = SUB_DIV_GOLD;
-        base = div->par.time;
-        range = div->gold.time - base;
-    } else if (time_to_usec(&e->time) < time_to_usec(&div->silver)) {
-        subdiv = SUB_DIV_SILVER;
-        base = div->gold.time;
-        range = div->silver.time - base;
-        e->rating += 1.0;
-    } else { // bronze
-        subdiv = SUB_DIV_BRONZE;
-        base = div->silver.time;
-        range = div->bronze.time - base;
-        e->rating += 2.0;
-    }
-    if (range > 0) {
-        e->rating += (e->time.time - base) / range;
+    unsigned retval = 0;
+    if (entry) {
+        retval =  entry_player(entry)->div;
+        if (!retval) {
+            retval = entry->prov_div;
+        }
     }
-    // normalize
-    e->rating = e->rating/3.0f;
-    // cap at max
-    if (e->rating > (DIV_IN_USE+1)) {
-        e->rating = (float)(DIV_IN_USE+1)-0.001;
+    return retval;
+}
+
+unsigned
+entry_subdiv(entry_t *entry)
+{
+    unsigned retval = 0;
+    if (entry) {
+        retval =  entry_player(entry)->sub_div;
     }
+    return retval;
+}
 
-    // compare against handicap
-    e->hcp_delta = 0.0f;
-    player = player_get(e->player_id);
-    if (player && player->rating > 0.0f) {
-        if (player->div > 0) {
-            div = &div_stat[entry_div(e)];
-        }
-        // low numbers indicate underperform
-        e->hcp_delta = (e->rating - player->rating);
-//        e->hcp_delta = 3.0f*(e->rating - div) - player->sub_div - 0.5f;
-        if (e->hcp_delta <= -(SUB_DIVISION_RANGE*0.5f)) { 
-            div->perf[0]++; 
-        } else if (e->hcp_delta >= (SUB_DIVISION_RANGE*0.5f)) {
-            div->perf[2]++; 
-        } else {
-            div->perf[1]++; 
-        }
-    } else if (g_event.week == EVENT_QUALIFIER) {
-        // for qualifier, track division distribution
-        div = &div_stat[e->prov_div];
-        div->perf[subdiv]++;
+int
+entry_watch(entry_t *e)
+{
+    if (e->rating*3.0f < (entry_div(e)*3.0f + entry_subdiv(e))) {
+        return TRUE;
     }
+    return FALSE;
 }
 
-// returns the handicap (in usec) of the entry passed in.
 int
-time_handicap(entry_t *e)
+entry_struggle(entry_t *e)
 {
-    double usec;
-    player_t *player;
+    if (entry_div(e) >= DIV_IN_USE-1) {
+        return FALSE;
+    }
+    if (e->prov_div > entry_div(e) && e->hcp_delta > (SUB_DIVISION_RANGE*2.0f)) {
+        return TRUE;
+    }
+    return FALSE;
+}
 
-    player = player_get(e->player_id);
-    if (!player) {
-        return 0; 
+int 
+entry_need_replay(context_t *ctx, entry_t *e)
+{
+    if (ctx->event.status != STATUS_FINAL &&
+        ((e->place <= 3) ||
+         (player_rookie(entry_player(e))) ||
+         (e->hcp_delta < -(SUB_DIVISION_RANGE)) ) ) {
+        return TRUE;
     }
-    double base = time_to_usec(&div_stat[1].gold);
-    double mid = time_to_usec(&div_stat[3].gold);
-    double handicap = (e->rating - player->rating);
-    usec = mid + ((mid - base) * handicap);
+    return FALSE;
+}
 
-    return usec;
+char *
+entry_replay_string(context_t *ctx, entry_t *e)
+{
+    char *retval = "";
+    if (e->dq >= DQ_VERIFIED) {
+        retval =  g_dq_display_text[e->dq];
+    } else if (entry_need_replay(ctx, e)) {
+        retval =  g_replay_request_string;
+    }
+    return retval;
 }
 
 char *
-rating_delta_display(entry_t *e)
+entry_dq_flag(entry_t *e)
 {
-    static char sbuf[MAX_NAME_LEN];
-    player_t *player;
+    char *retval = "";
+    if (e->dq == DQ_VERIFIED) {
+        retval = g_dq_flag_url[FLAG_GREEN];
+    } else if (e->dq >= DQ_NO_REPLAY) {
+        retval = g_dq_flag_url[FLAG_BLACK];
+    } else if (e->dq >= DQ_OFF_TRACK) {
+        retval = g_dq_flag_url[FLAG_RED];
+    }
+    return retval;
+}
 
-    player = player_get(e->player_id);
-    if (!player || player_is_rookie(e->player_id)) {
-        sbuf[0] = 0;
+int
+entry_dq_match(dq_reason_e status, dq_iter_e query)
+{
+    if (query == ITER_DQ_ALL) {
+        return TRUE;
+    } else if (query == ITER_DQ_OK) {
+        return dq_ok(status);
     } else {
-        sprintf(sbuf, "%.5f", e->rating - player->rating);
+        return !dq_ok(status);
     }
-
-    return sbuf;
 }
 
-double
-rating_compare(entry_t *left, entry_t *right)
+unsigned
+entry_match(entry_iter_t *iter)
 {
-    player_t *left_player, *right_player;
-    double left_delta, right_delta;
+    if (!iter->cur || !iter->cur->entry) {
+        return FALSE;
+    }
+    if (((iter->div == DIV_ALL) ||
+         (entry_div(iter->cur->entry) == iter->div)) &&
+            entry_dq_match(iter->cur->entry->dq, iter->dq)) {
+        return TRUE;
+    }
+    return FALSE;
+}
 
-    left_player = player_get(left->player_id);
-    right_player = player_get(right->player_id);
-    if (!left_player || !right_player) {
-        return 0;
+entry_t *
+entry_get_next(entry_iter_t *iter)
+{
+    COUNT(COUNTER_ENTRY_NEXT, 1);
+    if (iter->pos) {
+        COUNT(COUNTER_ENTRY_VISIT, (iter->pos < iter->end));
+        return (iter->pos < iter->end ? *iter->pos++ : 0);
     }
-    left_delta = left->rating - left_player->rating;
-    right_delta = right->rating - right_player->rating;
-    return left_delta - right_delta;
+    do {
+        iter->cur = iter->cur->next;
+        COUNT(COUNTER_ENTRY_VISIT, (iter->cur != 0));
+    } while (iter->cur && !entry_match(iter));
+    return (iter->cur ? iter->cur->entry : 0);
 }
 
-entry_link_t *
-rating_insert(entry_link_t *head, entry_link_t *link, entry_t *entry)
+entry_t *
+entry_get_first(context_t *ctx, entry_iter_t *iter, entry_link_t *head, int div, dq_iter_e dq)
 {
-    entry_link_t *prev, *cur;
+    int dq_class = (dq == ITER_DQ_BAD);
 
-    link->entry = entry;
-    prev = 0;
-    cur = head;
-    while (cur && rating_compare(cur->entry, entry) < 0) {
-        prev = cur;
-        cur = cur->next;
+    iter->div = div;
+    iter->dq = dq;
+    iter->cur = head;
+    iter->pos = 0;
+    iter->end = 0;
+    if (head && head == ctx->ov_head && ctx->div_index.valid &&
+            dq != ITER_DQ_ALL && div >= DIV_ALL && div <= DIV_COUNT) {
+        iter->pos = &ctx->div_index.entry[ctx->div_index.start[div][dq_class]];
+        iter->end = iter->pos + ctx->div_index.count[div][dq_class];
+        return entry_get_next(iter);
     }
-    if (prev == 0) { // new head
-        head = link;
-    } else {
-        prev->next = link;
+    if (iter->cur && !entry_match(iter)) {
+        entry_get_next(iter);
     }
-    link->next = cur;
-    return head; // return new head
+    return (iter->cur ? iter->cur->entry : 0);
 }
 
 void
-sort_ratings(void)
+div_index_invalidate(context_t *ctx)
 {
-    int i;
-    entry_t *cur;
-    entry_iter_t iter;
+    ctx->div_index.valid = FALSE;
+}
 
-    for (i=0, cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK);
-            cur; i++, cur = entry_get_next(&iter)) {
-        rat_head = rating_insert(rat_head, &rating_sort[i], cur);
-// obsolete
-//        if (player_div(cur->player_id) == 0) {
-//            player_div_set(cur->player_id, cur->rating);
-//        }
-    }
+// div_index_alloc
+// make room for n entries: 2n grouped rows (DIV_ALL plus one division each)
+int
+div_index_alloc(context_t *ctx, unsigned n)
+{
+    void *tmp;
 
+    if (n * 2 <= ctx->div_index.size) {
+        return SUCCESS;
+    }
+    if ((tmp = realloc(ctx->div_index.entry, n * 2 * sizeof(entry_t *))) == 0) {
+        return FAILURE;
+    }
+    ctx->div_index.entry = tmp;
+    if ((tmp = realloc(ctx->div_index.ms, n * 2 * sizeof(int64_t))) == 0) {
+        return FAILURE;
+    }
+    ctx->div_index.ms = tmp;
+    if ((tmp = realloc(ctx->div_index.hcp, n * 2 * sizeof(double))) == 0) {
+        return FAILURE;
+    }
+    ctx->div_index.hcp = tmp;
+    if ((tmp = realloc(ctx->div_index.div, n)) == 0) {
+        return FAILURE;
+    }
+    ctx->div_index.div = tmp;
+    if ((tmp = realloc(ctx->div_index.div_pos, n * sizeof(unsigned))) == 0) {
+        return FAILURE;
+    }
+    ctx->div_index.div_pos = tmp;
+    ctx->div_index.size = n * 2;
+    return SUCCESS;
 }
 
-void
-calculate_par(void)
+// div_index_build
+// group the overall list by division and dq class.  must be redone whenever
+// entry_div() can change: new list, or prov_div reassigned by calculate_par()
+int
+div_index_build(context_t *ctx)
 {
-    int div, q_count;
-    entry_t *cur;
-    entry_iter_t iter;
-    stat_t *stat;
-    double base_time, par_inc, span, parXlo, parXhi;
-
-    base_time = (((double)time_to_usec(&ostat.q_mean))/1000.0 - (ostat.q_std_dev*2.0)) + g_event.scoot;
-    par_inc = ostat.q_std_dev * g_event.squeeze;
-    for (div = 1; div <= DIV_COUNT; div++) {
-        parXlo = g_event.par_multiple[div];
-        parXhi = g_event.par_multiple[div+1];
-        if (div >= DIV_IN_USE) {
-            parXlo += ((float)DIV_IN_USE)*(div-DIV_IN_USE);
+    entry_link_t *link;
+    entry_t *entry;
+    unsigned pos[DIV_COUNT+1][2];
+    unsigned n, row, div, dq_class, next;
+
+    ctx->div_index.valid = FALSE;
+    if (div_index_alloc(ctx, ctx->entry_cnt) != SUCCESS) {
+        fprintf(stderr, "div_index_build: out of memory\n");
+        return FAILURE; // iterators fall back to walking the list
+    }
+    memset(ctx->div_index.count, 0, sizeof(ctx->div_index.count));
+    for (n = 0, link = ctx->ov_head; link; link = link->next, n++) {
+        if (n >= ctx->entry_cnt) {
+            return FAILURE;
+        }
+        dq_class = !dq_ok(link->entry->dq);
+        div = entry_div(link->entry);
+        ctx->div_index.count[DIV_ALL][dq_class]++;
+        if (div > DIV_ALL && div <= DIV_COUNT) {
+            ctx->div_index.count[div][dq_class]++;
         }
-        if (div+1 >= DIV_IN_USE) {
-            parXhi += ((float)DIV_IN_USE)*(div+1-DIV_IN_USE);
-        } 
-        stat = &div_stat[div];
-//        stat->par.time = base_time + (par_inc * g_event.par_multiple[div]);
-        stat->par.time = base_time + (par_inc * parXlo);
-        stat->perf[0] = 0;
-        stat->perf[1] = 0;
-        stat->perf[2] = 0;
-        time_from_usec(&stat->par, stat->par.time*1000.0);
-        stat->bronze.time = base_time + (par_inc * parXhi) - 0.001;
-        span = stat->bronze.time - stat->par.time;
-        stat->gold.time = stat->par.time + (span * (g_event.trophy_multiple[0]+custom_trophy_adjust[div]));
-        stat->silver.time = stat->par.time + (span * (g_event.trophy_multiple[1]+custom_trophy_adjust[div]));
-        time_from_usec(&stat->gold, stat->gold.time*1000.0);
-        time_from_usec(&stat->silver, stat->silver.time*1000.0);
-        time_from_usec(&stat->bronze, stat->bronze.time*1000.0);
     }
-
-    // quality stats for division
-    q_count = 0;
-    div = 1;
-    stat = &div_stat[div];
-    stat->q_mean.msec = 0;
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); ; cur = entry_get_next(&iter)) {
-        if (!cur || (time_to_usec(&cur->time) >= time_to_usec(&stat->bronze))) {
-            // close off current division
-            stat->q_mean.msec += q_count/2;
-            stat->q_mean.msec = (q_count ? stat->q_mean.msec/q_count : 0);
-            time_from_usec(&stat->q_mean, stat->q_mean.msec);
-            // advance division pointer
-            q_count = 0;
-            div++;
-            stat = &div_stat[div];
-            // end of list condition
-            if (!cur || div >= DIV_COUNT) {
-                break;
-            }
-            stat->q_mean.msec = 0;
+    for (next = 0, div = DIV_ALL; div <= DIV_COUNT; div++) {
+        for (dq_class = 0; dq_class < 2; dq_class++) {
+            ctx->div_index.start[div][dq_class] = next;
+            pos[div][dq_class] = next;
+            next += ctx->div_index.count[div][dq_class];
         }
-        cur->prov_div = div;
-        q_count++;
-        stat->q_mean.msec += time_to_usec(&cur->time);
     }
-    div = 1;
-    q_count = 0;
-    stat = &div_stat[div];
-    stat->q_std_dev = 0;
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); ; cur = entry_get_next(&iter)) {
-        if (!cur || cur->prov_div == div+2) {
-            // close off division std deviation
-            if (q_count > 0) {
-                stat->q_std_dev = stat->q_std_dev / (double)q_count;
-                stat->q_std_dev = sqrt(stat->q_std_dev);
-            } else {
-                stat->q_std_dev = 0.0f;
-            }
-            // advance division 
-            q_count = 0;
-            div++;
-            stat = &div_stat[div];
-            // end of list condition
-            if (!cur || div >= DIV_COUNT) {
-                break;
-            }
-            stat->q_std_dev = 0;
+    for (link = ctx->ov_head; link; link = link->next) {
+        entry = link->entry;
+        dq_class = !dq_ok(entry->dq);
+        div = entry_div(entry);
+        row = pos[DIV_ALL][dq_class]++;
+        ctx->div_index.entry[row] = entry;
+        ctx->div_index.ms[row] = time_to_usec(&entry->time);
+        ctx->div_index.hcp[row] = 0;
+        ctx->div_index.div[row] = entry->prov_div;
+        ctx->div_index.div_pos[row] = row;
+        if (div > DIV_ALL && div <= DIV_COUNT) {
+            ctx->div_index.div_pos[row] = pos[div][dq_class];
+            ctx->div_index.entry[pos[div][dq_class]] = entry;
+            ctx->div_index.ms[pos[div][dq_class]] = ctx->div_index.ms[row];
+            ctx->div_index.hcp[pos[div][dq_class]++] = 0;
         }
-        q_count++;
-        stat->q_std_dev += (stat->q_mean.time - cur->time.time) *
-                           (stat->q_mean.time - cur->time.time);
     }
+    ctx->div_index.valid = TRUE;
+    return SUCCESS;
 }
 
-void
-rate_times(void)
+// div_index_ready
+// the stats code reads the columns directly, rebuild them if stale
+int
+div_index_ready(context_t *ctx)
 {
-    int div, i, prior_place;
-    entry_t *cur, *prior;
-    entry_iter_t iter;
-    stat_t *stat;
+    if (ctx->div_index.valid) {
+        return TRUE;
+    }
+    return (div_index_build(ctx) == SUCCESS);
+}
 
-    prior = 0;
-    for (i=1, cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK);
-            cur; i++, cur = entry_get_next(&iter)) {
-        time_rate(cur);
-        if (prior && !time_compare(cur, prior)) {
-            cur->overall_place = prior_place;
+/************************************************/
+// stats kernels over the div_index columns.  ms[] values are whole msec
+// times, so sums and squared deviations are exact in 64 bit integers (lap
+// times under 2^31 msec, fewer than 2^24 entries of ten minutes or less).
+
+// count of the leading ms[] values below limit; columns are in time order
+unsigned
+ms_count_below(int64_t *ms, unsigned from, unsigned n, int64_t limit)
+{
+    unsigned lo = from, hi = n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (ms[mid] < limit) {
+            lo = mid + 1;
         } else {
-            cur->overall_place = i;
-            prior = cur;
-            prior_place = i;
+            hi = mid;
         }
     }
+    return lo;
+}
 
-    // finalize division stats
-    for (div = 1; div <= DIV_COUNT; div++) {
-        stat = &div_stat[div];
-//        memset(stat, 0, sizeof(stat_t));
-        stat->count = 0;
-        stat->mean.msec = 0;
-        stat->hcp_delta = 0;
-        stat->std_dev = 0;
+void
+ms_moments_scalar(int64_t *ms, unsigned n, int64_t *sum, int64_t *sumsq)
+{
+    int64_t s = 0, sq = 0;
+    unsigned i;
 
-        // first, compute mean (average)
-        for (cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
-            stat->count++;
-            stat->mean.msec += time_to_usec(&cur->time);
-            stat->hcp_delta += cur->hcp_delta;
-            cur->time.time = (double)(time_to_usec(&cur->time))/1000.0;
-        }
-        if (stat->count == 0) {
-            continue;
-        }
-        stat->mean.msec += stat->count/2; // for rounding
-        stat->mean.msec = stat->mean.msec / stat->count;
-        time_from_usec(&stat->mean, stat->mean.msec);
-        ostat.hcp_delta += stat->hcp_delta;
-        stat->hcp_delta = stat->hcp_delta / stat->count;
+    for (i = 0; i < n; i++) {
+        s += ms[i];
+        sq += ms[i] * ms[i];
+    }
+    *sum = s;
+    *sumsq = sq;
+}
 
-        // next, compute standard deviation
-        for (cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
-            stat->std_dev += (stat->mean.time - cur->time.time) *
-                             (stat->mean.time - cur->time.time);
-        }
-        stat->std_dev = stat->std_dev / (double)stat->count;
-        stat->std_dev = sqrt(stat->std_dev);
+double
+hcp_sum_scalar(double *hcp, unsigned n)
+{
+    double s[4] = { 0, 0, 0, 0 };
+    unsigned i;
 
-        // assign place/points
-        cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK);
-        prior = 0;
-        for (i = 1; cur; i++, cur = entry_get_next(&iter)) {
-            if (prior && !time_compare(cur, prior)) {
-                cur->place = prior_place;
-            } else {
-                cur->place = i;
-                prior = cur;
-                prior_place = i;
-            }
-            cur->points = entry_points(cur, stat->count);
-        }
+    // same four lane order as the vector kernel
+    for (i = 0; i + 4 <= n; i += 4) {
+        s[0] += hcp[i];
+        s[1] += hcp[i+1];
+        s[2] += hcp[i+2];
+        s[3] += hcp[i+3];
+    }
+    for (; i < n; i++) {
+        s[i & 3] += hcp[i];
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+#ifdef STATS_AVX2
+__attribute__((target("avx2")))
+void
+ms_moments_avx2(int64_t *ms, unsigned n, int64_t *sum, int64_t *sumsq)
+{
+    __m256i s = _mm256_setzero_si256();
+    __m256i sq = _mm256_setzero_si256();
+    __m256i v;
+    int64_t lane[4];
+    unsigned i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        v = _mm256_loadu_si256((__m256i *)&ms[i]);
+        s = _mm256_add_epi64(s, v);
+        // times fit in 32 bits, so the low half product is the full square
+        sq = _mm256_add_epi64(sq, _mm256_mul_epi32(v, v));
+    }
+    _mm256_storeu_si256((__m256i *)lane, s);
+    *sum = lane[0] + lane[1] + lane[2] + lane[3];
+    _mm256_storeu_si256((__m256i *)lane, sq);
+    *sumsq = lane[0] + lane[1] + lane[2] + lane[3];
+    for (; i < n; i++) {
+        *sum += ms[i];
+        *sumsq += ms[i] * ms[i];
     }
-    ostat.hcp_delta = ostat.hcp_delta / ostat.count;
 }
 
+__attribute__((target("avx2")))
 double
-calculate_auto_scoot(void)
+hcp_sum_avx2(double *hcp, unsigned n)
 {
-    int i, hcp, div;
-    double accum, usec;
-    entry_t *cur;
-    entry_iter_t iter;
+    __m256d s = _mm256_setzero_pd();
+    double lane[4];
+    unsigned i;
 
-    hcp = 0;
-    accum = 0;
-    // calculate the average handicap of the top division
-    div = 1;
-    if (div_stat[div].count < 3) {
-        div = DIV_ALL;
+    for (i = 0; i + 4 <= n; i += 4) {
+        s = _mm256_add_pd(s, _mm256_loadu_pd(&hcp[i]));
     }
-    for (i = 0, cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK);
-            cur && i < (ostat.count/AUTO_SCOOT_FRACTION);
-            i++, cur = entry_get_next(&iter)) {
-        usec = (player_get(cur->player_id)->rating - cur->rating);
-        usec *= g_event.par_multiple[2];
-        usec *= ostat.q_std_dev;
+    _mm256_storeu_pd(lane, s);
+    for (; i < n; i++) {
+        lane[i & 3] += hcp[i];
+    }
+    return (lane[0] + lane[1]) + (lane[2] + lane[3]);
+}
+#endif /* STATS_AVX2 */
 
-        accum += usec*0.75;
+int
+stats_use_avx2(void)
+{
+#ifdef STATS_AVX2
+    return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+#else
+    return FALSE;
+#endif
+}
+
+// ms_moments
+// sum and sum of squares of n msec times in one pass
+void
+ms_moments(int64_t *ms, unsigned n, int64_t *sum, int64_t *sumsq)
+{
+#ifdef STATS_AVX2
+    if (stats_use_avx2()) {
+        ms_moments_avx2(ms, n, sum, sumsq);
+        return;
     }
-    if (i > 0) {
-        accum = accum / i;
+#endif
+    ms_moments_scalar(ms, n, sum, sumsq);
+}
+
+double
+hcp_sum(double *hcp, unsigned n)
+{
+#ifdef STATS_AVX2
+    if (stats_use_avx2()) {
+        return hcp_sum_avx2(hcp, n);
     }
-    accum = g_event.scoot - accum;
+#endif
+    return hcp_sum_scalar(hcp, n);
+}
 
-    return accum;
+// rounded mean in msec, as the stats have always been kept
+int64_t
+ms_mean(unsigned n, int64_t sum)
+{
+    return (n ? (sum + n/2) / n : 0);
 }
 
+// standard deviation (in seconds) of n times about mean, from their moments
 double
-calculate_auto_squeeze(void)
+ms_std_dev(unsigned n, int64_t sum, int64_t sumsq, int64_t mean)
 {
-    int div;
-    double accum;
-    stat_t *stat;
+    int64_t dev;
 
-    accum = 0;
-    for (div = 1; div <= DIV_IN_USE; div++) {
-        stat = &div_stat[div];
-        accum += stat->count * stat->hcp_delta; 
-    }
-    if (ostat.count > 0) {
-        accum = accum / ostat.count;
+    if (n == 0) {
+        return 0;
     }
-    accum += g_event.squeeze;
+    dev = sumsq - 2 * mean * sum + (int64_t)n * mean * mean;
+    return sqrt(((double)dev / 1000000.0) / (double)n);
+}
 
-    return accum;
+// rating order within a registry bucket, player id breaks ties
+int
+player_compare(const void *a, const void *b)
+{
+    player_link_t *left = (player_link_t *)a;
+    player_link_t *right = (player_link_t *)b;
+    if (left->player->rating < right->player->rating) {
+        return -1;
+    } else if (left->player->rating > right->player->rating) {
+        return 1;
+    }
+    if (left->player->id < right->player->id) {
+        return -1;
+    } else if (left->player->id > right->player->id) {
+        return 1;
+    }
+    return 0;
 }
 
+// counts of ids already placed, for player_sort_ties()
 void
-collate_stats(void)
+id_count_add(unsigned *count, unsigned size, unsigned id, int delta)
 {
-    int i, q_count;
-    entry_t *cur;
-    entry_iter_t iter;
+    for (; id < size; id |= id + 1) {
+        count[id] += delta;
+    }
+}
 
-    if (g_entry_cnt == 0) {
-        fprintf(stderr, "collate_stats: no entries found\n");
-        return;
+unsigned
+id_count_below(unsigned *count, unsigned id)
+{
+    unsigned sum = 0;
+    for (; id > 0; id &= id - 1) {
+        sum += count[id - 1];
     }
-    // overall stats
-    ostat.count = 0;
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
-        ostat.count++;
-        ostat.mean.msec += time_to_usec(&cur->time);
-        cur->time.time = (double)(time_to_usec(&cur->time))/1000.0;
+    return sum;
+}
+
+// player_sort_ties
+// the registry used to be sorted with an exchange sort (swap a[i] and a[j]
+// whenever a[j] rated lower), which does not keep equal ratings in id order.
+// for a run of equal ratings it works out to: walk the bucket in id order,
+// append each tied player to a list, and rotate that list left by one for
+// every lower rated player met once the list is non empty.  count[] holds
+// the ids of the lower rated players in the bucket.
+void
+player_sort_ties(player_db_t *db, player_link_t *run, unsigned k, unsigned *count, player_t **list)
+{
+    unsigned t, len, rotate, next_id, between;
+    player_t *tmp;
+
+    for (len = 0, t = 0; t < k; t++) {
+        list[len++] = run[t].player;
+        next_id = (t+1 < k ? run[t+1].player->id : db->player_cnt + 1);
+        between = id_count_below(count, next_id) -
+                  id_count_below(count, run[t].player->id + 1);
+        for (rotate = between % len; rotate > 0; rotate--) {
+            tmp = list[0];
+            memmove(&list[0], &list[1], (len-1) * sizeof(player_t *));
+            list[len-1] = tmp;
+        }
     }
-    if (ostat.count == 0) {
-        fprintf(stderr, "collate_stats: no valid entries found\n");
-        return;
+    for (t = 0; t < k; t++) {
+        run[t].player = list[t];
     }
-    ostat.mean.msec += ostat.count/2; // for rounding
-    ostat.mean.msec = ostat.mean.msec / ostat.count;
-    time_from_usec(&ostat.mean, ostat.mean.msec);
+}
 
-    q_count = 0;
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
-        ostat.std_dev += (ostat.mean.time - cur->time.time) *
-                         (ostat.mean.time - cur->time.time);
-        // compute quality time stats
-        if (time_to_usec(&cur->time) <= time_to_usec(&ostat.mean)) {
-            q_count++;
-            ostat.q_mean.msec += time_to_usec(&cur->time);
+// player_sort
+// partition the registry into (div, sub_div) buckets in one pass over the
+// players and sort each bucket by rating.  each bucket in p_sort is null
+// terminated; player_bucket() returns its first link.
+int
+player_sort(context_t *ctx)
+{
+    player_t *player;
+    unsigned count[DIV_COUNT+1][SUB_DIV_BRONZE+1];
+    unsigned pos[DIV_COUNT+1][SUB_DIV_BRONZE+1];
+    unsigned *id_count;
+    player_t **list;
+    player_link_t *run;
+    unsigned size, next, t, k, u;
+    int i, div, sub;
+
+    memset(count, 0, sizeof(count));
+    for (i = 1; i <= ctx->db->player_cnt; i++) {
+        player = player_get(ctx->db, i);
+        if (player->div >= 1 && player->div <= DIV_COUNT &&
+                player->sub_div <= SUB_DIV_BRONZE) {
+            count[player->div][player->sub_div]++;
         }
     }
-    ostat.std_dev = ostat.std_dev / (double)ostat.count;
-    ostat.std_dev = sqrt(ostat.std_dev);
-
-    // finish quality stats calculation
-    ostat.q_mean.msec += q_count/2; // for rounding
-    if (q_count > 0) {
-        ostat.q_mean.msec = ostat.q_mean.msec / q_count;
-    } else {
-        ostat.q_mean.msec = 0;
+    size = ctx->db->player_cnt + sizeof(count)/sizeof(count[0][0]);
+    if (ctx->p_sort_size < size) {
+        player_link_t *tmp = realloc(ctx->p_sort, size * sizeof(player_link_t));
+        if (!tmp) {
+            fprintf(stderr, "player_sort: out of memory\n");
+            return FAILURE;
+        }
+        ctx->p_sort = tmp;
+        ctx->p_sort_size = size;
+    }
+    for (next = 0, div = 0; div <= DIV_COUNT; div++) {
+        for (sub = SUB_DIV_GOLD; sub <= SUB_DIV_BRONZE; sub++) {
+            ctx->p_bucket[div][sub] = next;
+            pos[div][sub] = next;
+            next += count[div][sub];
+            ctx->p_sort[next++].player = 0; // terminator
+        }
     }
-    time_from_usec(&ostat.q_mean, ostat.q_mean.msec);
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
-        if (time_to_usec(&cur->time) <= time_to_usec(&ostat.mean)) {
-            ostat.q_std_dev += (ostat.q_mean.time - cur->time.time) *
-                               (ostat.q_mean.time - cur->time.time);
+    for (i = 1; i <= ctx->db->player_cnt; i++) {
+        player = player_get(ctx->db, i);
+        if (player->div >= 1 && player->div <= DIV_COUNT &&
+                player->sub_div <= SUB_DIV_BRONZE) {
+            ctx->p_sort[pos[player->div][player->sub_div]++].player = player;
         }
     }
-    if (q_count) {
-        ostat.q_std_dev = ostat.q_std_dev / (double)q_count;
-    } else {
-        ostat.q_std_dev = 0;
+    id_count = calloc(ctx->db->player_cnt + 1, sizeof(unsigned));
+    list = malloc((ctx->db->player_cnt + 1) * sizeof(player_t *));
+    if (!id_count || !list) {
+        fprintf(stderr, "player_sort: out of memory\n");
+        free(id_count);
+        free(list);
+        return FAILURE;
     }
-    ostat.q_std_dev = sqrt(ostat.q_std_dev);
-
-    calculate_par();
-    rate_times();
-
-    // do a few iterations of this
-    if (g_event.auto_scoot == TRUE || g_event.auto_squeeze == TRUE) {
-        for (i = 0; i < AUTO_CYCLE_CNT; i++) {
-            if (g_event.auto_scoot == TRUE && i < AUTO_CYCLE_CNT-2) {
-                g_event.scoot = calculate_auto_scoot();
-                calculate_par();
-                rate_times();
+    for (div = 1; div <= DIV_COUNT; div++) {
+        for (sub = SUB_DIV_GOLD; sub <= SUB_DIV_BRONZE; sub++) {
+            if (count[div][sub] <= 1) {
+                continue;
             }
-            if (g_event.auto_squeeze == TRUE) {
-                g_event.squeeze = calculate_auto_squeeze();
-                calculate_par();
-                rate_times();
+            run = &ctx->p_sort[ctx->p_bucket[div][sub]];
+            qsort(run, count[div][sub], sizeof(player_link_t), player_compare);
+            // reorder runs of equal rating, lowest rating first
+            for (t = 0; t < count[div][sub]; t += k) {
+                for (k = 1; t+k < count[div][sub] &&
+                        run[t+k].player->rating == run[t].player->rating; k++);
+                if (k > 1) {
+                    player_sort_ties(ctx->db, &run[t], k, id_count, list);
+                }
+                for (u = t; u < t+k; u++) {
+                    id_count_add(id_count, ctx->db->player_cnt + 1, run[u].player->id, 1);
+                }
+            }
+            for (t = 0; t < count[div][sub]; t++) {
+                id_count_add(id_count, ctx->db->player_cnt + 1, run[t].player->id, -1);
             }
-            fprintf(stderr, "temp auto adjust: scoot=%.3f, squeeze=%.3f\n", g_event.scoot, g_event.squeeze);
-        }
-        if (g_event.auto_scoot == TRUE) {
-            fprintf(stderr, "scoot auto adjust to %.3f\n", g_event.scoot);
-        }
-        if (g_event.auto_squeeze == TRUE) {
-            fprintf(stderr, "squeeze auto adjust to %.3f\n", g_event.squeeze);
         }
     }
-    sort_ratings();
+    free(id_count);
+    free(list);
+    return SUCCESS;
 }
 
+player_link_t *
+player_bucket(context_t *ctx, int div, sub_div_e sub)
+{
+    static player_link_t empty = { 0 };
+
+    if (!ctx->p_sort || div < 0 || div > DIV_COUNT || sub > SUB_DIV_BRONZE) {
+        return &empty;
+    }
+    return &ctx->p_sort[ctx->p_bucket[div][sub]];
+}
 
 /************************************************/
-/* parser                                       */
+// event entry API
+int
+event_season_active(context_t *ctx)
+{
+    if (ctx->event.season) {
+        return TRUE;
+    } else {
+        return FALSE;
+    }
+}
+
+int
+event_season(context_t *ctx)
+{
+    return ctx->event.season;
+}
+
+int
+event_season_race(context_t *ctx)
+{
+    return ctx->event.season_race;
+}
+
 /************************************************/
+// init
+// init_event: per-event state only, so a batch run can apply several events
+// to one loaded DB
 void
-add_splits(entry_t *e)
+init_event(context_t *ctx)
 {
     int i;
 
-    memset(&e->time, 0, sizeof(ttime_t));
-    for (i = 0; i < MAX_SPLITS; i++) {
-        time_add(&e->time, &e->time, &e->split[i]);
+    ctx->run_mode = RUN_MODE_EVENT;
+    ctx->entry_cnt = 0;
+
+    // init event
+    memset(&ctx->event, 0, sizeof(event_t));
+    ctx->event.par_multiple = flat_par_multiple;
+    ctx->event.trophy_multiple = qual_trophy_multiple;
+    ctx->event.squeeze = DEFAULT_SQUEEZE;
+    ctx->event.scoot = DEFAULT_SCOOT;
+    ctx->event.weight = 1.0f;
+    ctx->event.auto_squeeze = TRUE;
+    ctx->event.auto_scoot = TRUE;
+    strcpy(ctx->event.comment, "Good job everyone!");
+
+    pool_reset(&ctx->entry_pool);
+    pool_reset(&ctx->time_sort);
+    pool_reset(&ctx->rating_sort);
+    ctx->ov_head = 0;
+    ctx->rat_head = 0;
+    div_index_invalidate(ctx);
+    memset(ctx->div_stat, 0, sizeof(ctx->div_stat));
+    memset(&ctx->ostat, 0, sizeof(stat_t));
+    for (i = 0; i < DIV_COUNT+2; i++) {
+        ctx->custom_trophy_adjust[i] = 0.0;
+        ctx->custom_par_multiple[i] = default_par_multiple[i];
     }
 }
 
+// init_players: empty player DB, holding only player 0
 void
-check_splits(entry_t *e)
+init_players(player_db_t *db)
 {
-    int i;
-    ttime_t accum;
+    // storage is allocated as players/entries are loaded
+    pool_reset(&db->pool);
+    db->player_cnt = -1;
+    db->max_player_id = -1;
+    index_reset(&db->psn_index);
+    index_reset(&db->name_index);
+    player_create(db, "NULL", "NULL"); // add player 0
+}
 
-    memset(&accum, 0, sizeof(ttime_t));
-    for (i = 0; i < MAX_SPLITS; i++) {
-        time_add(&accum, &accum, &e->split[i]);
-    }
-    if (time_to_usec(&accum) &&
-            time_to_usec(&e->time) != time_to_usec(&accum)) {
-        fprintf(stderr, "Split addition error for %s: Time=(%s), ",
-                entry_psn(e), time_display(&e->time));
-        fprintf(stderr, "Splits=(%s)\n", time_display(&accum));
-        e->dq = DQ_TIME_ERROR;
+// player_db_create
+// returns: an empty player DB, or 0 if out of memory
+player_db_t *
+player_db_create(void)
+{
+    player_db_t *db = calloc(1, sizeof(player_db_t));
+
+    if (!db) {
+        return 0;
     }
+    db->pool.elem_size = sizeof(player_t);
+    db->psn_index.key = offsetof(player_t, psn);
+    db->name_index.key = offsetof(player_t, name);
+    init_players(db);
+    return db;
 }
 
 void
-parse_custom_curve_shape(char *ptr)
+player_db_free(player_db_t *db)
 {
-    int i = 0;
-    ptr = field_skip(ptr);
-    while (*ptr) {
-        if ((*ptr == '-' || *ptr == '.' || isdigit(*ptr)) && i <= DIV_COUNT) {
-            custom_par_multiple[i] = atof(ptr);
-            i++;
-        }
-        ptr = field_skip(ptr);
+    if (db) {
+        pool_reset(&db->pool);
+        index_reset(&db->psn_index);
+        index_reset(&db->name_index);
+        free(db);
     }
-    printf("Custom par: ");
-    for (i = 0; i < DIV_COUNT; i++) {
-        printf("%.3f ", custom_par_multiple[i]);
+}
+
+// context_create
+// returns: a context for evaluating events against db, or 0 if out of memory
+context_t *
+context_create(player_db_t *db)
+{
+    context_t *ctx = calloc(1, sizeof(context_t));
+
+    if (!ctx) {
+        return 0;
     }
-    printf("\n");
+    ctx->db = db;
+    ctx->echo = stdout;
+    ctx->entry_pool.elem_size = sizeof(entry_t);
+    ctx->time_sort.elem_size = sizeof(entry_link_t);
+    ctx->rating_sort.elem_size = sizeof(entry_link_t);
+    init_event(ctx);
+    return ctx;
 }
 
+// context_free: the context only, not its DB
 void
-parse_custom_gold_shift(char *ptr)
+context_free(context_t *ctx)
 {
-    int i = 0;
-    double val;
+    if (ctx) {
+        pool_reset(&ctx->entry_pool);
+        pool_reset(&ctx->time_sort);
+        pool_reset(&ctx->rating_sort);
+        free(ctx->div_index.entry);
+        free(ctx->div_index.ms);
+        free(ctx->div_index.hcp);
+        free(ctx->div_index.div);
+        free(ctx->div_index.div_pos);
+        free(ctx->p_sort);
+        free(ctx);
+    }
+}
 
-    while (*ptr) {
-        if ((*ptr == '-' || *ptr == '.' || isdigit(*ptr)) && i <= DIV_COUNT) {
-            val = atof(ptr);
-            if (val > -2.0/3.0 && val < 2.0/3.0) { // allowable range
-                custom_trophy_adjust[i] = atof(ptr);
-                i++;
-            } else {
-                printf("Gold Trophy Shift range error: %.3f should be from -2/3 and 2/3\n", val);
-            }
+
+/************************************************/
+// generic file scanner...
+int
+scan_to(FILE *file, char *string, int max_lines)
+{
+    char cur_line[MAX_LINE_LEN];
+    int len = strlen(string);
+    while (!feof(file) && ((max_lines--) > 0)) {
+        if (fgets(cur_line, MAX_LINE_LEN-1, file) == 0) {
+            continue;
+        }
+        if (!strncmp(cur_line, string, len)) {
+            return SUCCESS;
         }
-        ptr = field_skip(ptr);
     }
-    printf("Gold Trophy Shift: ");
-    for (i = 0; i <= DIV_COUNT; i++) {
-        printf("%.3f ", custom_trophy_adjust[i]);
+    // may want to rewind in fail case
+    fprintf(stderr, "scan_to(%s), len=%d not found\n", string, len);
+    return FAILURE;
+}
+
+int
+label_end(char c)
+{
+    if (c == ':') {
+//    if (c == ' ') {
+        return TRUE;
     }
-    printf("\n");
+    return FALSE;
 }
 
-// Returns: count of tokens processed
 int
-event_process_line(char *line, entry_t *entry)
+label_len(char *str)
 {
-    int retval = 0;
-    label_e label;
-    player_t *player = 0;
-    ttime_t time;
-    entry_t *prior_entry;
-    char buf[MAX_STR_LEN];
-    int len, i;
-    int got_entry = FALSE;
-    char *ptr = line;
-    char *pptr;
-    do {
-        time_from_usec(&time, 0);
-        pptr = ptr;
-        label = label_get(ptr);
-        ptr = label_skip(ptr); // skip label
-        retval++;
-        switch(label) {
-        case LABEL_COMMENT:
-            label = LABEL_NONE;
-            retval--; // skip rest of line
-            break;
-        case LABEL_NAME:
-        case LABEL_PSN:
-            field_copy(buf, ptr);
-            if (!player) {
-                player = player_lookup_by_psn(buf);
-            }
-            if (player) {
-                strcpy(player->psn, buf);
-            } else if (g_event.week == EVENT_QUALIFIER) {
-                player = player_create(0, buf);
-                if (!player) {
-                    fprintf(stderr, "max player count exceeded\n");
+    int len = 0;
+
+    if (!str) {
+        return 0;
+    }
+    while (*str && !label_end(*str) && (len < MAX_STR_LEN)) {
+        len++;
+        str++;
+    }
+    len++; // skip past label end
+    return len;
+}
+
+char *
+label_skip(char *str)
+{
+    int len = 0;
+
+    if (!str) {
+        return 0;
+    }
+    len = label_len(str);
+    str += len;
+    // skip past space following label
+    while (isspace(*str) && len < MAX_STR_LEN) {
+        len++;
+        str++;
+    }
+    return str;
+}
+
+int
+label_copy_toupper(char *out, char *in)
+{
+    int len = 0;
+    // skip past leading spaces
+    while (isspace(*in) && len < MAX_STR_LEN) {
+        in++;
+        len++;
+    }
+    // copy label
+    while (*in && !isspace(*in) && len < MAX_STR_LEN-1) {
+        len++;
+        *out++ = toupper(*in++);
+    }
+    // null terminate copy
+    *out = 0;
+    return len;
+}
+
+// label_equal
+// case-insensitive exact compare of a token against an upper case label name
+int
+label_equal(char *str, int len, const char *name)
+{
+    int i;
+    char c, n;
+
+    for (i = 0; i < len; i++) {
+        c = str[i];
+        n = name[i];
+        if (c != n && !(n >= 'A' && n <= 'Z' && c == n + ('a' - 'A'))) {
+            return FALSE;
+        }
+    }
+    return (name[len] == 0);
+}
+
+// label_lookup
+// input: str/len: label text, not including the ':' terminator
+// returns: id of label, or LABEL_NONE
+// note: labels match exactly (ignoring case); a few long forms seen in our
+// event files are accepted as aliases, and anything starting with '#' is a
+// comment.  candidates are picked by length and leading characters, then
+// verified against g_label[], so the table stays the one source of names.
+label_e
+label_lookup(char *str, int len)
+{
+    label_e label = LABEL_NONE;
+    const char *name = 0; // alias spelling, if not g_label[label]
+
+    COUNT(COUNTER_LABEL_LOOKUP, 1);
+    if (len <= 0) {
+        COUNT(COUNTER_LABEL_MISS, 1);
+        return LABEL_NONE;
+    }
+    if (str[0] == '#') {
+        return LABEL_COMMENT;
+    }
+    // (c | 0x20) folds letters to lower case; verification rejects any
+    // non-letter that happens to fold onto a case below
+    switch (len) {
+    case 2:
+        label = LABEL_M3;
+        break;
+    case 3:
+        switch (str[0] | 0x20) {
+        case 'c': label = LABEL_CAR; break;
+        case 'o': label = LABEL_OUTFILE; break;
+        case 'p': label = LABEL_PSN; break;
+        case 's': label = LABEL_SUB_DIV; break;
+        case 'd': label = ((str[1] | 0x20) == 'i') ? LABEL_DIV : LABEL_DQ_CNT; break;
+        }
+        break;
+    case 4:
+        switch (str[0] | 0x20) {
+        case 'w': label = LABEL_WEEK; break;
+        case 'u': label = LABEL_USER; break;
+        case 'n': label = LABEL_NAME; break;
+        case 't': label = LABEL_TIME; break;
+        case 'v': label = LABEL_VERIFIED_CNT; break;
+        case 'q': label = LABEL_QUALIFIER; break;
+        case 'd': label = ((str[1] | 0x20) == 'e') ? LABEL_DESC : LABEL_DISQ; break;
+        }
+        break;
+    case 5:
+        switch (str[0] | 0x20) {
+        case 'i': label = LABEL_IMAGE; break;
+        case 't': label = ((str[1] | 0x20) == 'r') ? LABEL_TRACK : LABEL_TOTAL; break;
+        case 's':
+            switch (str[1] | 0x20) {
+            case 'h': label = LABEL_SHAPE; break;
+            case 'c': label = LABEL_SCOOT; break;
+            case 'p': label = LABEL_SPLIT; break;
+            }
+            break;
+        }
+        break;
+    case 6:
+        switch (str[0] | 0x20) {
+        case 'w': label = LABEL_WEIGHT; break;
+        case 'd': label = LABEL_DB_FIX; break;
+        case 'm': label = LABEL_MEGANE; break;
+        case 'e': label = LABEL_EVENT_CNT; break;
+        case 'r': label = ((str[1] | 0x20) == 'e') ? LABEL_REPORT : LABEL_RATING; break;
+        case 's':
+            if ((str[1] | 0x20) == 't') {
+                label = LABEL_STATUS;
+            } else {
+                label = ((str[2] | 0x20) == 'a') ? LABEL_SEASON : LABEL_SECTOR;
+            }
+            break;
+        }
+        break;
+    case 7:
+        switch (str[0] | 0x20) {
+        case 's': label = LABEL_SQUEEZE; break;
+        case 'r': label = LABEL_REAL_RATING; break;
+        case 'h': label = LABEL_HISTORY; break;
+        case 'o': label = LABEL_OUTFILE; name = "OUTFILE"; break;
+        case 'c': label = ((str[2] | 0x20) == 'm') ? LABEL_NOTE : LABEL_COUNTRY; break;
+        }
+        break;
+    case 8:
+        switch (str[0] | 0x20) {
+        case 's': label = LABEL_STATFILE; break;
+        case 'c': label = LABEL_NOTE; name = "COMMENTS"; break;
+        }
+        break;
+    case 9:
+        label = LABEL_PLAYER_ID;
+        break;
+    case 10:
+        label = LABEL_GOLD_SHIFT;
+        break;
+    case 11:
+        switch (str[0] | 0x20) {
+        case 's': label = LABEL_SEASON_RACE; break;
+        case 'd': label = LABEL_DESC; name = "DESCRIPTION"; break;
+        }
+        break;
+    case 12:
+        label = LABEL_EVENT_STATUS;
+        break;
+    }
+    if (label != LABEL_NONE &&
+            label_equal(str, len, (name ? name : g_label[label]))) {
+        return label;
+    }
+    COUNT(COUNTER_LABEL_MISS, 1);
+    return LABEL_NONE;
+}
+
+// label_get_view
+// input: tok: token to classify (need not be null terminated)
+// returns: id of label found, or LABEL_NONE
+label_e
+label_get_view(str_view_t *tok)
+{
+    int len = 0;
+
+    if (!tok) {
+        return LABEL_NONE;
+    }
+    while (len < tok->len && !label_end(tok->ptr[len])) {
+        len++;
+    }
+    return label_lookup(tok->ptr, len);
+}
+
+// label_get
+// input: string: pointer to string to search for label
+// returns: id of string found, or LABEL_NONE
+label_e
+label_get(char *string)
+{
+    int len = 0;
+
+    if (!string) {
+        return LABEL_NONE;
+    }
+    // skip past leading spaces
+    while (isspace(*string)) {
+        string++;
+    }
+    while (string[len] && !isspace(string[len]) && !label_end(string[len]) &&
+            len < MAX_STR_LEN) {
+        len++;
+    }
+    return label_lookup(string, len);
+}
+
+int
+string_copy(char *out, char *in)
+{
+    int len = 0;
+    if (out && in) {
+        while (isprint(*in) && len < MAX_STR_LEN) {
+            *out++ = *in++;
+            len++;
+        }
+        *out = 0;
+    }
+    return len;
+}
+
+int
+field_len(char *str)
+{
+    int len = 0;
+
+    if (!str) {
+        return 0;
+    }
+    if (*str == '\"') {
+        len++;
+        str++;
+        while (*str && (*str != '\"') && len < MAX_STR_LEN) { 
+            len++;
+            str++;
+        }
+        if (len < MAX_STR_LEN) {
+            len++;
+        }
+    } else {
+        while (*str && !isspace(*str) && len < MAX_STR_LEN) {
+            len++;
+            str++;
+        }
+    }
+    return len;
+}
+
+char *
+field_copy(char *dst, char *src) {
+    // strip quotes
+    int len = field_len(src);
+    if (len < 2 && (len == 0 || *src == '\"')) {
+        return 0;
+    }
+    int offset = 0;
+    if (*src == '\"') {
+        offset = 1;
+    }
+    strncpy(dst, src+offset, len-(2*offset));
+    dst[len-(2*offset)] = 0;
+    return dst + len;
+}
+
+char *
+field_skip(char *str)
+{
+    int len = 0;
+
+    if (!str) {
+        return 0;
+    }
+    len = field_len(str);
+    str += len;
+
+    // skip past space following field
+    while (isspace(*str) && len < MAX_STR_LEN) {
+        len++;
+        str++;
+    }
+    return str;
+}
+
+// view_token
+// input: pos: scan position, advanced past the token; end: end of line
+// output: tok: next whitespace delimited token, quotes stripped
+// returns: TRUE if a token was found before end
+int
+view_token(char **pos, char *end, str_view_t *tok)
+{
+    char *str = *pos;
+
+    while (str < end && isspace(*str)) {
+        str++;
+    }
+    if (str >= end) {
+        *pos = str;
+        return FALSE;
+    }
+    if (*str == '\"') {
+        tok->ptr = ++str;
+        while (str < end && *str != '\"' && *str != '\n') {
+            str++;
+        }
+        tok->len = str - tok->ptr;
+        if (str < end && *str == '\"') {
+            str++;
+        }
+    } else {
+        tok->ptr = str;
+        while (str < end && !isspace(*str)) {
+            str++;
+        }
+        tok->len = str - tok->ptr;
+    }
+    *pos = str;
+    return TRUE;
+}
+
+// view_copy: copy token into a fixed size field, truncating if needed
+char *
+view_copy(char *dst, int size, str_view_t *tok)
+{
+    int len = tok->len;
+
+    if (len > size-1) {
+        len = size-1;
+    }
+    memcpy(dst, tok->ptr, len);
+    dst[len] = 0;
+    return dst;
+}
+
+// parse_time
+// input: str: m'ss.mmm, or ss.mmm when followed by a space
+// any separator works between the fields; seconds past 60 carry to minutes
+int
+parse_time(char *str, ttime_t *time)
+{
+    unsigned field;
+
+    if (!str || !time) {
+        return FAILURE;
+    }
+    if (*str >= '0' && *str <= '9') {
+        for (field = 0; *str >= '0' && *str <= '9'; str++) {
+            field = field * 10 + (*str - '0');
+        }
+        time->min = field;
+    } else {
+        time->min = num_parse_int(str, 0);
+    }
+    while (*str && !(*str >= '0' && *str <= '9')) str++;
+    for (field = 0; *str >= '0' && *str <= '9'; str++) {
+        field = field * 10 + (*str - '0');
+    }
+    time->sec = field;
+    if (isspace(*str)) {
+        // sec.msec format
+        time->msec = time->sec;
+        time->sec = time->min;
+        time->min = 0;
+    } else {
+        while (*str && !(*str >= '0' && *str <= '9')) str++;
+        for (field = 0; *str >= '0' && *str <= '9'; str++) {
+            field = field * 10 + (*str - '0');
+        }
+        time->msec = field;
+    }
+    while (time->sec > 60) {
+        time->min++;
+        time->sec -= 60;
+    }
+    return SUCCESS;
+}
+
+/************************************************/
+// time functions
+int
+time_compare(entry_t *left, entry_t *right)
+{
+    return time_to_usec(&left->time) - time_to_usec(&right->time);
+}
+
+void
+time_add(ttime_t *dest, ttime_t *a, ttime_t *b)
+{
+    int usec;
+    if (dest && a && b) {
+        usec = time_to_usec(a) + time_to_usec(b);
+        time_from_usec(dest, usec);
+    }
+}
+
+void
+time_subtract(ttime_t *dest, ttime_t *a, ttime_t *b)
+{
+    int usec;
+    if (dest && a && b) {
+        usec = time_to_usec(a) - time_to_usec(b);
+        time_from_usec(dest, usec);
+    }
+}
+
+// output: out, at least MAX_NAME_LEN
+char *
+time_display(char *out, ttime_t *time)
+{
+    char *ptr = num_format_int(out, (unsigned char)time->min);
+
+    *ptr++ = '\'';
+    ptr = num_format_pad(ptr, (unsigned char)time->sec, 2);
+    *ptr++ = '.';
+    num_format_pad(ptr, (unsigned short)time->msec, 3);
+    return out;
+}
+
+// time_sort_entries
+// order all parsed entries by time into the overall list (ov_head).  LSD
+// radix sort on the msec time, one byte per pass.  entries are fed in
+// reverse parse order so ties come out latest-first, as the old insertion
+// sort left them.
+int
+time_sort_entries(context_t *ctx)
+{
+    time_key_t *key, *tmp, *swap;
+    entry_link_t *link, *prev;
+    unsigned count[256];
+    unsigned n = ctx->entry_cnt;
+    unsigned i, c, sum, shift, digit;
+    int retval = SUCCESS;
+
+    ctx->ov_head = 0;
+    if (n == 0) {
+        return SUCCESS;
+    }
+    key = malloc(n * sizeof(time_key_t));
+    tmp = malloc(n * sizeof(time_key_t));
+    if (!key || !tmp) {
+        fprintf(stderr, "time_sort_entries: out of memory\n");
+        free(key);
+        free(tmp);
+        return FAILURE;
+    }
+    for (i = 0; i < n; i++) {
+        key[i].entry = entry_get(ctx, n-1-i);
+        key[i].entry->time.time = (double)(time_to_usec(&key[i].entry->time))/1000.0;
+        // flip the sign bit so unsigned digits sort in signed order
+        key[i].key = (unsigned)time_to_usec(&key[i].entry->time) ^ 0x80000000u;
+    }
+    for (shift = 0; shift < 32; shift += 8) {
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < n; i++) {
+            count[(key[i].key >> shift) & 0xff]++;
+        }
+        if (count[(key[0].key >> shift) & 0xff] == n) {
+            continue; // same digit everywhere, nothing to do
+        }
+        for (c = 0, sum = 0; c < 256; c++) {
+            digit = count[c];
+            count[c] = sum;
+            sum += digit;
+        }
+        for (i = 0; i < n; i++) {
+            tmp[count[(key[i].key >> shift) & 0xff]++] = key[i];
+        }
+        swap = key;
+        key = tmp;
+        tmp = swap;
+    }
+
+    for (i = 0, prev = 0; i < n; i++, prev = link) {
+        link = pool_get(&ctx->time_sort, i);
+        if (!link) {
+            fprintf(stderr, "time_sort_entries: out of memory\n");
+            retval = FAILURE;
+            break;
+        }
+        link->entry = key[i].entry;
+        link->next = 0;
+        if (prev) {
+            prev->next = link;
+        } else {
+            ctx->ov_head = link;
+        }
+    }
+    free(key);
+    free(tmp);
+    if (retval == SUCCESS) {
+        div_index_build(ctx);
+    }
+    return retval;
+}
+
+double
+weight_adjust(double player_rating, double event_rating)
+{
+    double delta = event_rating - player_rating;
+
+    if (player_rating <= 0.0f || delta < 1.0f) {
+        delta = 1.0f;
+    }
+    return (1.0f/2.0f + 1.0f/(2.0f*delta));
+}
+
+void
+time_rate(context_t *ctx, entry_t *e)
+{
+    player_t *player;
+    double base, range;
+    stat_t *div;
+    unsigned subdiv;
+
+    div = &ctx->div_stat[e->prov_div];
+    e->rating = 3.0*(e->prov_div);
+    if (time_to_usec(&e->time) < time_to_usec(&div->gold)) {
+        subdiv = SUB_DIV_GOLD;
+        base = div->par.time;
+        range = div->gold.time - base;
+    } else if (time_to_usec(&e->time) < time_to_usec(&div->silver)) {
+        subdiv = SUB_DIV_SILVER;
+        base = div->gold.time;
+        range = div->silver.time - base;
+        e->rating += 1.0;
+    } else { // bronze
+        subdiv = SUB_DIV_BRONZE;
+        base = div->silver.time;
+        range = div->bronze.time - base;
+        e->rating += 2.0;
+    }
+    if (range > 0) {
+        e->rating += (e->time.time - base) / range;
+    }
+    // normalize
+    e->rating = e->rating/3.0f;
+    // cap at max
+    if (e->rating > (DIV_IN_USE+1)) {
+        e->rating = (float)(DIV_IN_USE+1)-0.001;
+    }
+
+    // compare against handicap
+    e->hcp_delta = 0.0f;
+    player = entry_player(e);
+    if (player && player->rating > 0.0f) {
+        if (player->div > 0) {
+            div = &ctx->div_stat[entry_div(e)];
+        }
+        // low numbers indicate underperform
+        e->hcp_delta = (e->rating - player->rating);
+//        e->hcp_delta = 3.0f*(e->rating - div) - player->sub_div - 0.5f;
+        if (e->hcp_delta <= -(SUB_DIVISION_RANGE*0.5f)) { 
+            div->perf[0]++; 
+        } else if (e->hcp_delta >= (SUB_DIVISION_RANGE*0.5f)) {
+            div->perf[2]++; 
+        } else {
+            div->perf[1]++; 
+        }
+    } else if (ctx->event.week == EVENT_QUALIFIER) {
+        // for qualifier, track division distribution
+        div = &ctx->div_stat[e->prov_div];
+        div->perf[subdiv]++;
+    }
+}
+
+// returns the handicap (in usec) of the entry passed in.
+int
+time_handicap(context_t *ctx, entry_t *e)
+{
+    double usec;
+    player_t *player;
+
+    player = player_get(ctx->db, e->player_id);
+    if (!player) {
+        return 0; 
+    }
+    double base = time_to_usec(&ctx->div_stat[1].gold);
+    double mid = time_to_usec(&ctx->div_stat[3].gold);
+    double handicap = (e->rating - player->rating);
+    usec = mid + ((mid - base) * handicap);
+
+    return usec;
+}
+
+// output: out, at least MAX_NAME_LEN
+char *
+rating_delta_display(char *out, entry_t *e)
+{
+    player_t *player;
+
+    player = entry_player(e);
+    if (!player || player_rookie(player)) {
+        out[0] = 0;
+    } else {
+        if (!num_format_fixed(out, e->rating - player->rating, 5)) {
+            sprintf(out, "%.5f", e->rating - player->rating);
+        }
+    }
+
+    return out;
+}
+
+// cached sort key: compare doubles, ties go to input order
+int
+rating_key_compare(const void *a, const void *b)
+{
+    const rating_key_t *left = a;
+    const rating_key_t *right = b;
+
+    if (left->key < right->key) {
+        return -1;
+    } else if (left->key > right->key) {
+        return 1;
+    }
+    return (left->seq > right->seq) - (left->seq < right->seq);
+}
+
+// sort_ratings
+// order valid entries by handicap delta (rat_head).  each delta is computed
+// once; entries are keyed in reverse time order so equal deltas come out
+// latest-first, as the old insertion sort left them.
+void
+sort_ratings(context_t *ctx)
+{
+    unsigned i, n;
+    entry_t *cur;
+    entry_link_t *link, *prev;
+    entry_iter_t iter;
+    rating_key_t *key;
+
+    ctx->rat_head = 0;
+    for (n = 0, cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK);
+            cur; n++, cur = entry_get_next(&iter));
+    if (n == 0) {
+        return;
+    }
+    key = malloc(n * sizeof(rating_key_t));
+    if (!key) {
+        fprintf(stderr, "sort_ratings: out of memory\n");
+        return;
+    }
+    for (i = n, cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK);
+            cur; cur = entry_get_next(&iter)) {
+        i--;
+        key[i].key = cur->rating - entry_player(cur)->rating;
+        key[i].seq = i;
+        key[i].entry = cur;
+    }
+    qsort(key, n, sizeof(rating_key_t), rating_key_compare);
+
+    for (i = 0, prev = 0; i < n; i++, prev = link) {
+        link = pool_get(&ctx->rating_sort, i);
+        if (!link) {
+            fprintf(stderr, "sort_ratings: out of memory\n");
+            break;
+        }
+        link->entry = key[i].entry;
+        link->next = 0;
+        if (prev) {
+            prev->next = link;
+        } else {
+            ctx->rat_head = link;
+        }
+    }
+    free(key);
+}
+
+// par_set_times
+// division par and trophy times from the quality stats, scoot and squeeze
+void
+par_set_times(context_t *ctx)
+{
+    int div;
+    stat_t *stat;
+    double base_time, par_inc, span, parXlo, parXhi;
+
+    base_time = (((double)time_to_usec(&ctx->ostat.q_mean))/1000.0 - (ctx->ostat.q_std_dev*2.0)) + ctx->event.scoot;
+    par_inc = ctx->ostat.q_std_dev * ctx->event.squeeze;
+    for (div = 1; div <= DIV_COUNT; div++) {
+        parXlo = ctx->event.par_multiple[div];
+        parXhi = ctx->event.par_multiple[div+1];
+        if (div >= DIV_IN_USE) {
+            parXlo += ((float)DIV_IN_USE)*(div-DIV_IN_USE);
+        }
+        if (div+1 >= DIV_IN_USE) {
+            parXhi += ((float)DIV_IN_USE)*(div+1-DIV_IN_USE);
+        } 
+        stat = &ctx->div_stat[div];
+//        stat->par.time = base_time + (par_inc * ctx->event.par_multiple[div]);
+        stat->par.time = base_time + (par_inc * parXlo);
+        stat->perf[0] = 0;
+        stat->perf[1] = 0;
+        stat->perf[2] = 0;
+        time_from_usec(&stat->par, stat->par.time*1000.0);
+        stat->bronze.time = base_time + (par_inc * parXhi) - 0.001;
+        span = stat->bronze.time - stat->par.time;
+        stat->gold.time = stat->par.time + (span * (ctx->event.trophy_multiple[0]+ctx->custom_trophy_adjust[div]));
+        stat->silver.time = stat->par.time + (span * (ctx->event.trophy_multiple[1]+ctx->custom_trophy_adjust[div]));
+        time_from_usec(&stat->gold, stat->gold.time*1000.0);
+        time_from_usec(&stat->silver, stat->silver.time*1000.0);
+        time_from_usec(&stat->bronze, stat->bronze.time*1000.0);
+    }
+}
+
+// par_assign_divs
+// divisions split the time ordered list at each bronze time; the entry that
+// closes a division opens the next one.  sets prov_div and division q_mean
+void
+par_assign_divs(context_t *ctx)
+{
+    int div;
+    stat_t *stat;
+    int64_t *ms, sum, sumsq;
+    unsigned n, start, end, row;
+
+    ms = ctx->div_index.ms;
+    n = ctx->div_index.count[DIV_ALL][0];
+    start = 0;
+    for (div = 1; ; div++) {
+        stat = &ctx->div_stat[div];
+        end = ms_count_below(ms, (div == 1 ? start : start+1), n,
+                             time_to_usec(&stat->bronze));
+        ms_moments(&ms[start], end - start, &sum, &sumsq);
+        time_from_usec(&stat->q_mean, ms_mean(end - start, sum));
+        for (row = start; row < end; row++) {
+            ctx->div_index.entry[row]->prov_div = div;
+        }
+        memset(&ctx->div_index.div[start], div, end - start);
+        if (end >= n || div+1 >= DIV_COUNT) {
+            break;
+        }
+        start = end;
+    }
+}
+
+void
+calculate_par(context_t *ctx)
+{
+    int div;
+    stat_t *stat;
+    int64_t *ms, sum, sumsq;
+    unsigned n, start, end, row;
+    unsigned char *next;
+    trace_span_t span;
+
+    par_set_times(ctx);
+    if (!div_index_ready(ctx)) {
+        return;
+    }
+    trace_begin(ctx->db->trace, &span, "calculate_par");
+    par_assign_divs(ctx);
+
+    // quality deviation, taken from the division's first entry until one
+    // placed two divisions further down
+    ms = ctx->div_index.ms;
+    n = ctx->div_index.count[DIV_ALL][0];
+    start = 0;
+    for (div = 1; ; div++) {
+        stat = &ctx->div_stat[div];
+        row = (div == 1 ? start : start+1);
+        next = (row < n ? memchr(&ctx->div_index.div[row], div+2, n - row) : 0);
+        end = (next ? next - ctx->div_index.div : n);
+        ms_moments(&ms[start], end - start, &sum, &sumsq);
+        stat->q_std_dev = ms_std_dev(end - start, sum, sumsq, time_to_usec(&stat->q_mean));
+        if (end >= n || div+1 >= DIV_COUNT) {
+            break;
+        }
+        start = end;
+    }
+    // prov_div just changed, regroup the per division iterators
+    div_index_build(ctx);
+    trace_end(ctx->db->trace, &span, 0, n);
+}
+
+void
+rate_times(context_t *ctx)
+{
+    int div, i, prior_place;
+    entry_t *cur, *prior;
+    stat_t *stat;
+    int64_t sum, sumsq;
+    unsigned n, row, start;
+
+    if (!div_index_ready(ctx)) {
+        return;
+    }
+    prior = 0;
+    n = ctx->div_index.count[DIV_ALL][0];
+    for (row = 0; row < n; row++) {
+        cur = ctx->div_index.entry[row];
+        time_rate(ctx, cur);
+        ctx->div_index.hcp[ctx->div_index.div_pos[row]] = cur->hcp_delta;
+        if (prior && !time_compare(cur, prior)) {
+            cur->overall_place = prior_place;
+        } else {
+            cur->overall_place = row + 1;
+            prior = cur;
+            prior_place = row + 1;
+        }
+    }
+
+    // finalize division stats
+    for (div = 1; div <= DIV_COUNT; div++) {
+        stat = &ctx->div_stat[div];
+//        memset(stat, 0, sizeof(stat_t));
+        stat->count = ctx->div_index.count[div][0];
+        stat->mean.msec = 0;
+        stat->hcp_delta = 0;
+        stat->std_dev = 0;
+        if (stat->count == 0) {
+            continue;
+        }
+        start = ctx->div_index.start[div][0];
+
+        // mean, deviation and handicap delta in one pass over the columns
+        ms_moments(&ctx->div_index.ms[start], stat->count, &sum, &sumsq);
+        time_from_usec(&stat->mean, ms_mean(stat->count, sum));
+        stat->std_dev = ms_std_dev(stat->count, sum, sumsq, time_to_usec(&stat->mean));
+        stat->hcp_delta = hcp_sum(&ctx->div_index.hcp[start], stat->count);
+        ctx->ostat.hcp_delta += stat->hcp_delta;
+        stat->hcp_delta = stat->hcp_delta / stat->count;
+
+        // assign place/points
+        prior = 0;
+        for (i = 1; i <= stat->count; i++) {
+            cur = ctx->div_index.entry[start + i - 1];
+            if (prior && !time_compare(cur, prior)) {
+                cur->place = prior_place;
+            } else {
+                cur->place = i;
+                prior = cur;
+                prior_place = i;
+            }
+            cur->points = entry_points(cur, stat->count);
+        }
+    }
+    ctx->ostat.hcp_delta = ctx->ostat.hcp_delta / ctx->ostat.count;
+}
+
+double
+calculate_auto_scoot(context_t *ctx)
+{
+    int i, div;
+    double accum, usec;
+    entry_t *cur;
+    entry_iter_t iter;
+
+    accum = 0;
+    // calculate the average handicap of the top division
+    div = 1;
+    if (ctx->div_stat[div].count < 3) {
+        div = DIV_ALL;
+    }
+    for (i = 0, cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK);
+            cur && i < (ctx->ostat.count/AUTO_SCOOT_FRACTION);
+            i++, cur = entry_get_next(&iter)) {
+        usec = (entry_player(cur)->rating - cur->rating);
+        usec *= ctx->event.par_multiple[2];
+        usec *= ctx->ostat.q_std_dev;
+
+        accum += usec*0.75;
+    }
+    if (i > 0) {
+        accum = accum / i;
+    }
+    accum = ctx->event.scoot - accum;
+
+    return accum;
+}
+
+double
+calculate_auto_squeeze(context_t *ctx)
+{
+    int div;
+    double accum;
+    stat_t *stat;
+
+    accum = 0;
+    for (div = 1; div <= DIV_IN_USE; div++) {
+        stat = &ctx->div_stat[div];
+        accum += stat->count * stat->hcp_delta; 
+    }
+    if (ctx->ostat.count > 0) {
+        accum = accum / ctx->ostat.count;
+    }
+    accum += ctx->event.squeeze;
+
+    return accum;
+}
+
+// auto_cycle
+// one cycle of the auto schedule: scoot, except in the last AUTO_SCOOT_HOLD
+// cycles, then squeeze, each followed by a rating pass
+// returns: the larger of the two changes
+double
+auto_cycle(context_t *ctx, int cycle)
+{
+    double prior, delta = 0;
+    trace_span_t span;
+
+    trace_begin(ctx->db->trace, &span, "auto_adjust_cycle");
+    if (ctx->event.auto_scoot == TRUE && cycle < AUTO_CYCLE_CNT-AUTO_SCOOT_HOLD) {
+        prior = ctx->event.scoot;
+        ctx->event.scoot = calculate_auto_scoot(ctx);
+        delta = fabs(ctx->event.scoot - prior);
+        calculate_par(ctx);
+        rate_times(ctx);
+    }
+    if (ctx->event.auto_squeeze == TRUE) {
+        prior = ctx->event.squeeze;
+        ctx->event.squeeze = calculate_auto_squeeze(ctx);
+        delta = fmax(delta, fabs(ctx->event.squeeze - prior));
+        calculate_par(ctx);
+        rate_times(ctx);
+    }
+    trace_end(ctx->db->trace, &span, 0, ctx->ostat.count);
+    return delta;
+}
+
+// auto_adjust
+// up to AUTO_CYCLE_CNT cycles, stopping once one moves neither scoot nor
+// squeeze by AUTO_EPSILON.  once the changes have grown AUTO_DIVERGE_CNT
+// cycles in a row the early stop is off: the event gets the settings of
+// the full schedule, with a warning
+void
+auto_adjust(context_t *ctx)
+{
+    double delta, prior = HUGE_VAL;
+    int i, growing = 0, diverging = FALSE;
+
+    for (i = 0; i < AUTO_CYCLE_CNT; i++) {
+        COUNT(COUNTER_AUTO_CYCLE, 1);
+        delta = auto_cycle(ctx, i);
+        if (!isfinite(delta)) {
+            diverging = TRUE;
+        }
+        if (delta < AUTO_EPSILON && !diverging) {
+            fprintf(stderr, "auto adjust converged after %d iterations\n", i+1);
+            return;
+        }
+        growing = (delta > prior ? growing + 1 : 0);
+        if (growing >= AUTO_DIVERGE_CNT) {
+            diverging = TRUE;
+        }
+        prior = delta;
+    }
+    if (diverging) {
+        fprintf(stderr, "WARNING: auto adjust diverging, using the %d cycle settings\n", AUTO_CYCLE_CNT);
+    } else {
+        fprintf(stderr, "auto adjust not converged after %d iterations\n", AUTO_CYCLE_CNT);
+    }
+}
+
+void
+collate_stats(context_t *ctx)
+{
+    unsigned q_count;
+    int64_t sum, sumsq, mean;
+    trace_span_t span;
+
+    if (ctx->entry_cnt == 0) {
+        fprintf(stderr, "collate_stats: no entries found\n");
+        return;
+    }
+    trace_begin(ctx->db->trace, &span, "collate_stats");
+    if (!div_index_ready(ctx)) {
+        fprintf(stderr, "collate_stats: out of memory\n");
+        trace_end(ctx->db->trace, &span, 0, 0);
+        return;
+    }
+    // overall stats
+    ctx->ostat.count = ctx->div_index.count[DIV_ALL][0];
+    if (ctx->ostat.count == 0) {
+        fprintf(stderr, "collate_stats: no valid entries found\n");
+        trace_end(ctx->db->trace, &span, 0, 0);
+        return;
+    }
+    ms_moments(ctx->div_index.ms, ctx->ostat.count, &sum, &sumsq);
+    mean = ms_mean(ctx->ostat.count, sum);
+    time_from_usec(&ctx->ostat.mean, mean);
+    ctx->ostat.std_dev = ms_std_dev(ctx->ostat.count, sum, sumsq, mean);
+
+    // quality stats: the entries at or under the mean, a prefix of the
+    // time ordered list
+    q_count = ms_count_below(ctx->div_index.ms, 0, ctx->ostat.count, mean + 1);
+    ms_moments(ctx->div_index.ms, q_count, &sum, &sumsq);
+    mean = ms_mean(q_count, sum);
+    time_from_usec(&ctx->ostat.q_mean, mean);
+    ctx->ostat.q_std_dev = ms_std_dev(q_count, sum, sumsq, mean);
+
+    ctx->scoot_start = ctx->event.scoot;
+    ctx->squeeze_start = ctx->event.squeeze;
+    calculate_par(ctx);
+    rate_times(ctx);
+    if (ctx->event.auto_scoot == TRUE || ctx->event.auto_squeeze == TRUE) {
+        auto_adjust(ctx);
+        if (ctx->event.auto_scoot == TRUE) {
+            fprintf(stderr, "scoot auto adjust to %.3f\n", ctx->event.scoot);
+        }
+        if (ctx->event.auto_squeeze == TRUE) {
+            fprintf(stderr, "squeeze auto adjust to %.3f\n", ctx->event.squeeze);
+        }
+    }
+    sort_ratings(ctx);
+    trace_end(ctx->db->trace, &span, 0, ctx->entry_cnt);
+}
+
+// collate_update: change one entry of a collated event and redo only what
+// the change can reach.  next is the entry's new state as parsed (0 to
+// remove it); an entry is added if the player has none.  Every stat comes
+// from the good entries alone, so a flag change within the good or the
+// disqualified entries, or any change to disqualified entries, leaves them
+// as they are.  When the good entries change, par and every rating move
+// with them, and auto adjust is solved again from the event's own settings
+// rather than the last solution, so the results match a fresh run.
+// returns: what had to be redone
+recalc_e
+collate_update(context_t *ctx, unsigned player_id, entry_t *next)
+{
+    entry_t *entry = 0;
+    int idx, was_ok, now_ok;
+
+    idx = entry_index(ctx, player_id);
+    if (idx >= 0) {
+        entry = entry_get(ctx, idx);
+    }
+    was_ok = (entry && dq_ok(entry->dq));
+    now_ok = (next && dq_ok(next->dq));
+    if (entry && next && was_ok == now_ok && time_to_usec(&entry->time) == time_to_usec(&next->time)) {
+        entry->dq = next->dq;
+        entry->time = next->time;
+        memcpy(entry->split, next->split, sizeof(entry->split));
+        return RECALC_NONE;
+    }
+
+    if (!next) {
+        if (entry) {
+            entry_remove(ctx, idx);
+        }
+    } else if (entry) {
+        *entry = *next;
+    } else {
+        entry = entry_get(ctx, ctx->entry_cnt);
+        if (!entry) {
+            fprintf(stderr, "collate_update: out of memory at %d entries\n", ctx->entry_cnt);
+            return RECALC_NONE;
+        }
+        *entry = *next;
+        ctx->entry_cnt++;
+    }
+    time_sort_entries(ctx);
+    if (!was_ok && !now_ok) {
+        sort_ratings(ctx); // same ratings, but removal moves the entries
+        return RECALC_LISTS;
+    }
+
+    // as a fresh context starts out: collate_stats() leaves the lists when
+    // there are no good entries, and entries past the last division keep
+    // their parsed prov_div and places
+    for (idx = 0; idx < ctx->entry_cnt; idx++) {
+        entry = entry_get(ctx, idx);
+        entry->prov_div = 0;
+        entry->overall_place = 0;
+        entry->place = 0;
+        entry->points = 0;
+        entry->hcp_delta = 0.0;
+        entry->rating = 0.0;
+    }
+    ctx->rat_head = 0;
+    memset(ctx->div_stat, 0, sizeof(ctx->div_stat));
+    memset(&ctx->ostat, 0, sizeof(ctx->ostat));
+    ctx->event.scoot = ctx->scoot_start;
+    ctx->event.squeeze = ctx->squeeze_start;
+    collate_stats(ctx);
+    return RECALC_FULL;
+}
+
+
+/************************************************/
+/* parser                                       */
+/************************************************/
+void
+add_splits(entry_t *e)
+{
+    int i;
+
+    memset(&e->time, 0, sizeof(ttime_t));
+    for (i = 0; i < MAX_SPLITS; i++) {
+        time_add(&e->time, &e->time, &e->split[i]);
+    }
+}
+
+void
+check_splits(entry_t *e)
+{
+    int i;
+    ttime_t accum;
+    char tbuf[MAX_NAME_LEN];
+
+    memset(&accum, 0, sizeof(ttime_t));
+    for (i = 0; i < MAX_SPLITS; i++) {
+        time_add(&accum, &accum, &e->split[i]);
+    }
+    if (time_to_usec(&accum) &&
+            time_to_usec(&e->time) != time_to_usec(&accum)) {
+        fprintf(stderr, "Split addition error for %s: Time=(%s), ",
+                entry_psn(e), time_display(tbuf, &e->time));
+        fprintf(stderr, "Splits=(%s)\n", time_display(tbuf, &accum));
+        e->dq = DQ_TIME_ERROR;
+    }
+}
+
+void
+parse_custom_curve_shape(context_t *ctx, char *ptr)
+{
+    int i = 0;
+    ptr = field_skip(ptr);
+    while (*ptr) {
+        if ((*ptr == '-' || *ptr == '.' || isdigit(*ptr)) && i <= DIV_COUNT) {
+            ctx->custom_par_multiple[i] = num_parse_double(ptr, 0);
+            i++;
+        }
+        ptr = field_skip(ptr);
+    }
+    if (ctx->echo) {
+        fprintf(ctx->echo, "Custom par: ");
+        for (i = 0; i < DIV_COUNT; i++) {
+            fprintf(ctx->echo, "%.3f ", ctx->custom_par_multiple[i]);
+        }
+        fprintf(ctx->echo, "\n");
+    }
+}
+
+void
+parse_custom_gold_shift(context_t *ctx, char *ptr)
+{
+    int i = 0;
+    double val;
+
+    while (*ptr) {
+        if ((*ptr == '-' || *ptr == '.' || isdigit(*ptr)) && i <= DIV_COUNT) {
+            val = num_parse_double(ptr, 0);
+            if (val > -2.0/3.0 && val < 2.0/3.0) { // allowable range
+                ctx->custom_trophy_adjust[i] = val;
+                i++;
+            } else if (ctx->echo) {
+                fprintf(ctx->echo, "Gold Trophy Shift range error: %.3f should be from -2/3 and 2/3\n", val);
+            }
+        }
+        ptr = field_skip(ptr);
+    }
+    if (ctx->echo) {
+        fprintf(ctx->echo, "Gold Trophy Shift: ");
+        for (i = 0; i <= DIV_COUNT; i++) {
+            fprintf(ctx->echo, "%.3f ", ctx->custom_trophy_adjust[i]);
+        }
+        fprintf(ctx->echo, "\n");
+    }
+}
+
+// Returns: count of tokens processed
+int
+event_process_line(context_t *ctx, char *line, entry_t *entry)
+{
+    int retval = 0;
+    label_e label;
+    player_t *player = 0;
+    ttime_t time;
+    entry_t *prior_entry;
+    char buf[MAX_STR_LEN];
+    int len, i;
+    int got_entry = FALSE;
+    char *ptr = line;
+    char *pptr;
+    do {
+        time_from_usec(&time, 0);
+        pptr = ptr;
+        label = label_get(ptr);
+        ptr = label_skip(ptr); // skip label
+        retval++;
+        switch(label) {
+        case LABEL_COMMENT:
+            label = LABEL_NONE;
+            retval--; // skip rest of line
+            break;
+        case LABEL_NAME:
+        case LABEL_PSN:
+            field_copy(buf, ptr);
+            if (!player) {
+                player = player_lookup_by_psn(ctx->db, buf);
+            }
+            if (player) {
+                player_set_psn(ctx->db, player, buf);
+                player->dirty = TRUE;
+            } else if (ctx->event.week == EVENT_QUALIFIER) {
+                player = player_create(ctx->db, 0, buf);
+                if (!player) {
+                    fprintf(stderr, "max player count exceeded\n");
                     return FAILURE;
                 }
             } else {
@@ -1980,12 +3397,13 @@ event_process_line(char *line, entry_t *entry)
         case LABEL_USER:
             field_copy(buf, ptr);
             if (!player) {
-                player = player_lookup_by_name(buf);
+                player = player_lookup_by_name(ctx->db, buf);
             }
             if (player) {
-                strcpy(player->name, buf);
-            } else if (g_event.week == EVENT_QUALIFIER) {
-                player = player_create(buf, 0);
+                player_set_name(ctx->db, player, buf);
+                player->dirty = TRUE;
+            } else if (ctx->event.week == EVENT_QUALIFIER) {
+                player = player_create(ctx->db, buf, 0);
                 if (!player) {
                     fprintf(stderr, "max player count exceeded\n");
                     return FAILURE;
@@ -1998,6 +3416,7 @@ event_process_line(char *line, entry_t *entry)
         case LABEL_COUNTRY:
             if (player) {
                 field_copy(player->country, ptr);
+                player->dirty = TRUE;
             }
             break;
         case LABEL_TIME:
@@ -2019,442 +3438,1445 @@ event_process_line(char *line, entry_t *entry)
             break;
         case LABEL_STATUS:
         case LABEL_DISQ:
-            if (toupper(*ptr) == 'O') {
-                entry->dq = DQ_OFF_TRACK;
-            } else if (toupper(*ptr) == 'C') {
-                entry->dq = DQ_CONTACT;
-            } else if (toupper(*ptr) == 'R') {
-                entry->dq = DQ_NO_REPLAY;
-            } else if (toupper(*ptr) == 'T') {
-                entry->dq = DQ_TIME_ERROR;
-            } else if (toupper(*ptr) == 'N') {
-                entry->dq = DQ_NAME_VIOLATION;
-            } else if (toupper(*ptr) == 'X') {
-                entry->dq = DQ_CUSTOM_VIOLATION;
-            } else if ((toupper(*ptr) == 'S') || (toupper(*ptr) == 'U')) { // unchecked
-                entry->dq = DQ_SUBMITTED;
-            } else if (toupper(*ptr) == 'V' || toupper(*ptr) == 'G') {
-                entry->dq = DQ_VERIFIED;
-            } else {
-                entry->dq = DQ_OK;
-            }
+            entry->dq = dq_parse(ptr);
             break;
         case LABEL_WEEK:
-            g_event.week = atoi(ptr);
+            ctx->event.week = num_parse_int(ptr, 0);
             break;
         case LABEL_SEASON:
-            g_event.season = atoi(ptr);
+            ctx->event.season = num_parse_int(ptr, 0);
             break;
         case LABEL_SEASON_RACE:
-            g_event.season_race = atoi(ptr);
+            ctx->event.season_race = num_parse_int(ptr, 0);
             break;
         case LABEL_EVENT_STATUS:
             if (toupper(*ptr) == 'F') {
-                g_event.status = STATUS_FINAL;
+                ctx->event.status = STATUS_FINAL;
             } else if (toupper(*ptr) == 'P') {
-                g_event.status = STATUS_PROVISIONAL;
+                ctx->event.status = STATUS_PROVISIONAL;
             } else {
                 fprintf(stderr, "Unknown status: '%s'\n", ptr);
             }
             break;
         case LABEL_CAR:
-            string_copy(g_event.car, ptr); // to end of line
-            g_event.car[strlen(ptr)] = 0;
+            string_copy(ctx->event.car, ptr); // to end of line
+            ctx->event.car[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_TRACK:
-            string_copy(g_event.track, ptr); // to end of line
-            g_event.track[strlen(ptr)] = 0;
+            string_copy(ctx->event.track, ptr); // to end of line
+            ctx->event.track[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_DESC:
-            string_copy(g_event.description, ptr); // to end of line
-            g_event.description[strlen(ptr)] = 0;
+            string_copy(ctx->event.description, ptr); // to end of line
+            ctx->event.description[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_OUTFILE:
-            string_copy(g_event.outfile, ptr); // to end of line
-            g_event.outfile[strlen(ptr)] = 0;
+            string_copy(ctx->event.outfile, ptr); // to end of line
+            ctx->event.outfile[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_STATFILE:
-            string_copy(g_event.statfile, ptr); // to end of line
-            g_event.statfile[strlen(ptr)] = 0;
+            string_copy(ctx->event.statfile, ptr); // to end of line
+            ctx->event.statfile[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_NOTE:
-            string_copy(g_event.comment, ptr); // to end of line
-            g_event.comment[strlen(ptr)] = 0;
+            string_copy(ctx->event.comment, ptr); // to end of line
+            ctx->event.comment[strlen(ptr)] = 0;
             return retval;
             break;
         case LABEL_IMAGE:
             for (i = 0; i < MAX_IMAGES; i++) {
-                if (g_event.img[i][0] == 0) {
-                    string_copy(g_event.img[i], ptr); // to end of line
-                    g_event.img[i][strlen(ptr)] = 0;
+                if (ctx->event.img[i][0] == 0) {
+                    string_copy(ctx->event.img[i], ptr); // to end of line
+                    ctx->event.img[i][strlen(ptr)] = 0;
                     return retval;
                 }
             }
             break;
         case LABEL_REPORT:
-            g_run_mode = RUN_MODE_REPORT;
+            ctx->run_mode = RUN_MODE_REPORT;
             break;
         case LABEL_DB_FIX:
-            g_run_mode = RUN_MODE_DB_FIX;
+            ctx->run_mode = RUN_MODE_DB_FIX;
             break;
         case LABEL_SHAPE:
             if (toupper(*ptr) == 'F') { // flat curve
-                g_event.par_multiple = flat_par_multiple;
-                g_event.trophy_multiple = flat_trophy_multiple;
+                ctx->event.par_multiple = flat_par_multiple;
+                ctx->event.trophy_multiple = flat_trophy_multiple;
             } else if (toupper(*ptr) == 'S') { // standard curve
-                g_event.par_multiple = standard_par_multiple;
-                g_event.trophy_multiple = standard_trophy_multiple;
+                ctx->event.par_multiple = standard_par_multiple;
+                ctx->event.trophy_multiple = standard_trophy_multiple;
             } else if (toupper(*ptr) == 'H') { // hybrid curve
-                g_event.par_multiple = hybrid_par_multiple;
-                g_event.trophy_multiple = hybrid_trophy_multiple;
+                ctx->event.par_multiple = hybrid_par_multiple;
+                ctx->event.trophy_multiple = hybrid_trophy_multiple;
             } else if (toupper(*ptr) == 'D') { // double standard curve
-                g_event.par_multiple = double_par_multiple;
-                g_event.trophy_multiple = double_trophy_multiple;
+                ctx->event.par_multiple = double_par_multiple;
+                ctx->event.trophy_multiple = double_trophy_multiple;
             } else if (toupper(*ptr) == 'M') { // muliply curve
-                g_event.par_multiple = multiply_par_multiple;
-                g_event.trophy_multiple = multiply_trophy_multiple;
+                ctx->event.par_multiple = multiply_par_multiple;
+                ctx->event.trophy_multiple = multiply_trophy_multiple;
             } else if (toupper(*ptr) == 'C') { // custom curve
-                g_event.par_multiple = custom_par_multiple;
-                g_event.trophy_multiple = flat_trophy_multiple;
-                parse_custom_curve_shape(ptr);
+                ctx->event.par_multiple = ctx->custom_par_multiple;
+                ctx->event.trophy_multiple = flat_trophy_multiple;
+                parse_custom_curve_shape(ctx, ptr);
                 return retval;
             } else {
                 fprintf(stderr, "Unknown shape type: %s\n", ptr);
             }
             break;
         case LABEL_GOLD_SHIFT:
-            parse_custom_gold_shift(ptr);
+            parse_custom_gold_shift(ctx, ptr);
             return retval;
             break;
         case LABEL_SQUEEZE:
-            g_event.squeeze = atof(ptr);
-            g_event.auto_squeeze = FALSE;
-            if (g_event.squeeze <= 0.0f) {
-                fprintf(stderr, "Failed squeeze parse: '%s' = %.3f\n", ptr, g_event.squeeze);
-                g_event.squeeze = DEFAULT_SQUEEZE;
+            ctx->event.squeeze = num_parse_double(ptr, 0);
+            ctx->event.auto_squeeze = FALSE;
+            if (ctx->event.squeeze <= 0.0f) {
+                fprintf(stderr, "Failed squeeze parse: '%s' = %.3f\n", ptr, ctx->event.squeeze);
+                ctx->event.squeeze = DEFAULT_SQUEEZE;
             }
             break;
         case LABEL_SCOOT:
-            g_event.auto_scoot = FALSE;
-            g_event.scoot = atof(ptr);
+            ctx->event.auto_scoot = FALSE;
+            ctx->event.scoot = num_parse_double(ptr, 0);
+            break;
+        case LABEL_WEIGHT:
+            ctx->event.weight = num_parse_double(ptr, 0);
+            if (ctx->event.weight < 0.0f) {
+                fprintf(stderr, "Failed weight parse: '%s' = %.3f\n", ptr, ctx->event.weight);
+                ctx->event.weight = 1.0f;
+            }
+            break;
+        default:
+            if (isgraph(*ptr)) {
+                fprintf(stderr, "Failed label parse for '%s'\n", pptr);
+                COUNT(COUNTER_LABEL_PARSE_FAIL, 1);
+            }
+            retval--; // didn't find a label after all
+            continue; // check "value" token to see if it's a label
+        }
+        ptr = field_skip(ptr); // skip value
+    } while (*ptr && label != LABEL_NONE);
+
+    if (got_entry && player) {
+        entry->player_id = player->id;
+        entry->player = player;
+        if (time_to_usec(&time) > 0) {
+            entry->time = time;
+        } else if (time_to_usec(&entry->split[0]) > 0) {
+            add_splits(entry);
+        }
+        ctx->entry_cnt++; // ordered by time_sort_entries(ctx) once parsing is done
+    }
+    return retval;
+}
+
+int
+scan_event(context_t *ctx, FILE *file)
+{
+    char cur_line[MAX_LINE_LEN];
+    entry_t *entry;
+    trace_span_t span;
+    long bytes;
+
+    if (!file) {
+        return 0;
+    }
+    trace_begin(ctx->db->trace, &span, "scan_event");
+    while (!feof(file)) {
+        entry = entry_get(ctx, ctx->entry_cnt);
+        if (!entry) {
+            fprintf(stderr, "scan_event: out of memory at %d entries\n", ctx->entry_cnt);
+            break;
+        }
+        memset(cur_line, 0, MAX_LINE_LEN);
+        if (fgets(cur_line, MAX_LINE_LEN-1, file) == 0) {
+            break;
+        }
+        event_process_line(ctx, cur_line, entry);
+    }
+    time_sort_entries(ctx);
+    bytes = ftell(file);
+    trace_end(ctx->db->trace, &span, (bytes > 0 ? bytes : 0), ctx->entry_cnt);
+    fprintf(stderr, "scan_event done: found %d entries; %d players in DB\n", ctx->entry_cnt, ctx->db->player_cnt);
+    return ctx->entry_cnt;
+}
+
+// context_copy
+// start ctx over with the event and entries parsed into src, ready for
+// collate_stats().  src is only read
+void
+context_copy(context_t *ctx, context_t *src)
+{
+    entry_t *entry, *from;
+    unsigned i;
+
+    init_event(ctx);
+    ctx->run_mode = src->run_mode;
+    ctx->event = src->event;
+    memcpy(ctx->custom_par_multiple, src->custom_par_multiple, sizeof(ctx->custom_par_multiple));
+    memcpy(ctx->custom_trophy_adjust, src->custom_trophy_adjust, sizeof(ctx->custom_trophy_adjust));
+    if (ctx->event.par_multiple == src->custom_par_multiple) {
+        ctx->event.par_multiple = ctx->custom_par_multiple;
+    }
+    for (i = 0; i < src->entry_cnt; i++) {
+        entry = entry_get(ctx, i);
+        from = pool_peek(&src->entry_pool, i);
+        if (!entry || !from) {
+            fprintf(stderr, "context_copy: out of memory at %d entries\n", i);
+            break;
+        }
+        *entry = *from;
+    }
+    ctx->entry_cnt = i;
+    time_sort_entries(ctx);
+}
+
+/************************************************/
+/* player database                              */
+/************************************************/
+char *
+db_parse_history(char *ptr, char *end, race_result_t *race)
+{
+    label_e label;
+    str_view_t tok, val;
+    char *pptr;
+
+    if (!ptr || !race) {
+        return 0;
+    }
+    for (pptr = ptr; view_token(&ptr, end, &tok); pptr = ptr) {
+        label = label_get_view(&tok);
+        switch (label) {
+        case LABEL_WEEK:
+        case LABEL_EVENT_STATUS:
+        case LABEL_RATING:
+        case LABEL_WEIGHT:
+        case LABEL_STATUS:
+        case LABEL_DISQ:
+            break;
+        default:
+            return pptr; // points to first unhandled token
+        }
+        if (!view_token(&ptr, end, &val)) {
+            break;
+        }
+        switch (label) {
+        case LABEL_WEEK:
+            race->race_id = num_parse_int(val.ptr, 0);
+            break;
+        case LABEL_EVENT_STATUS:
+            if (toupper(*val.ptr) == 'F') {
+                race->status = STATUS_FINAL;
+            } else if (toupper(*val.ptr) == 'P') {
+                race->status = STATUS_PROVISIONAL;
+            } else {
+                fprintf(stderr, "History: Unknown status: '%.*s'\n", val.len, val.ptr);
+            }
+            break;
+        case LABEL_RATING:
+            race->rating = num_parse_double(val.ptr, 0);
+            break;
+        case LABEL_WEIGHT:
+            race->weight = num_parse_double(val.ptr, 0);
+            if (race->weight < 0.0f) {
+                fprintf(stderr, "History: Failed weight parse: '%.*s' = %.3f\n", val.len, val.ptr, race->weight);
+                race->weight = 1.0f;
+            }
+            break;
+        case LABEL_STATUS:
+        case LABEL_DISQ:
+            if (toupper(*val.ptr) == 'O') {
+                race->dq = DQ_OFF_TRACK;
+            } else if (toupper(*val.ptr) == 'C') {
+                race->dq = DQ_CONTACT;
+            } else if (toupper(*val.ptr) == 'R') {
+                race->dq = DQ_NO_REPLAY;
+            } else if (toupper(*val.ptr) == 'T') {
+                race->dq = DQ_TIME_ERROR;
+            } else if (toupper(*val.ptr) == 'N') {
+                race->dq = DQ_NAME_VIOLATION;
+            } else if (toupper(*val.ptr) == 'X') {
+                race->dq = DQ_CUSTOM_VIOLATION;
+            } else if ((toupper(*val.ptr) == 'S') || (toupper(*val.ptr) == 'U')) {
+                race->dq = DQ_SUBMITTED;
+            } else if (toupper(*val.ptr) == 'V' || toupper(*val.ptr) == 'G') {
+                race->dq = DQ_VERIFIED;
+            } else {
+                race->dq = DQ_OK;
+            }
+            break;
+        }
+    }
+
+    return ptr;
+}
+
+// db_claim_player
+// the player a Player_id line starts.  A serial reader lets a later record
+// replace an earlier one (the journal does this); parallel chunks can't
+// order records between them, so a repeated id aborts them instead
+// returns: player to fill in, 0 to skip the record
+player_t *
+db_claim_player(db_reader_t *rd, int id)
+{
+    player_db_t *db = rd->db;
+    player_t *player = 0;
+
+    if (rd->lock) {
+        pthread_mutex_lock(rd->lock);
+        if (*rd->abort) {
+            pthread_mutex_unlock(rd->lock);
+            return 0;
+        }
+    }
+    player = player_alloc(db, id);
+    if (!player) {
+        fprintf(stderr, "db_read_player: out of memory at id %d\n", id);
+    } else if (player->valid && rd->lock) {
+        __atomic_store_n(rd->abort, TRUE, __ATOMIC_RELAXED); // read unlocked by db_read_lines()
+        player = 0;
+    } else {
+        if (player->valid) {
+            player_clear(player); // a journal record replaces the earlier one
+        } else {
+            db->player_cnt++;
+        }
+        player->id = id;
+        player->valid = TRUE;
+        if (id > db->max_player_id) {
+            db->max_player_id = id;
+        }
+    }
+    if (rd->lock) {
+        pthread_mutex_unlock(rd->lock);
+    }
+    return player;
+}
+
+// db_read_line
+// input: line: start of a DB line; end: end of line (need not be null
+//        terminated, so lines may be parsed in place in a mapped file)
+// History and other continuation lines belong to rd->player, the player
+// of the last Player_id line
+int
+db_read_line(db_reader_t *rd, char *line, char *end)
+{
+    player_db_t *db = rd->db;
+    player_t *player = rd->player;
+    label_e label;
+    str_view_t tok, val;
+    char buf[MAX_NAME_LEN];
+    double num;
+    int id;
+    char *ptr = line;
+
+    while (view_token(&ptr, end, &tok)) {
+        label = label_get_view(&tok);
+        if (label == LABEL_NONE) {
+            break;
+        }
+        if (label == LABEL_PLAYER_ID) {
+            if (!view_token(&ptr, end, &val)) {
+                break;
+            }
+            id = num_parse_int(val.ptr, 0);
+            if (id <= 0 || id >= MAX_PLAYERS) {
+                fprintf(stderr, "bad player id = %d\n", id);
+                return 0;
+            }
+            player = rd->player = db_claim_player(rd, id);
+            if (!player) {
+                return 0;
+            }
+            rd->history = -1;
+            continue;
+        }
+        if (!player) {
+            continue;
+        }
+        switch(label) {
+        case LABEL_COMMENT:
+            return 0; // skip rest of line
+        case LABEL_QUALIFIER:
+            player->qualifier.race_id = 0;
+            ptr = db_parse_history(ptr, end, &player->qualifier);
+            continue; // avoid value skip
+        case LABEL_HISTORY:
+            rd->history++;
+            if (rd->history < RACE_HISTORY) {
+                ptr = db_parse_history(ptr, end, &player->history[rd->history]);
+                continue; // avoid value skip
+            }
+            fprintf(stderr, "LABEL_HISTORY: too much history (%d) for player %d\n", rd->history, player->id);
+            return 0;
+        default:
+            break;
+        }
+        if (!view_token(&ptr, end, &val)) {
+            break;
+        }
+        switch(label) {
+        case LABEL_NAME:
+        case LABEL_PSN:
+            if (rd->lock) {
+                view_copy(player->psn, MAX_NAME_LEN, &val); // indexed after the merge
+            } else {
+                player_set_psn(db, player, view_copy(buf, MAX_NAME_LEN, &val));
+            }
+            break;
+        case LABEL_USER:
+            if (rd->lock) {
+                view_copy(player->name, MAX_NAME_LEN, &val);
+            } else {
+                player_set_name(db, player, view_copy(buf, MAX_NAME_LEN, &val));
+            }
+            break;
+        case LABEL_COUNTRY:
+            view_copy(player->country, MAX_NAME_LEN, &val);
+            break;
+        case LABEL_DIV:
+            player->div = num_parse_int(val.ptr, 0);
+            break;
+        case LABEL_SUB_DIV:
+            if (isdigit(val.ptr[0])) {
+                player->sub_div = num_parse_int(val.ptr, 0);
+            } else if (val.ptr[0] == 'g' || val.ptr[0] == 'G') {
+                player->sub_div = SUB_DIV_GOLD;
+            } else if (val.ptr[0] == 's' || val.ptr[0] == 'S') {
+                player->sub_div = SUB_DIV_SILVER;
+            } else if (val.ptr[0] == 'b' || val.ptr[0] == 'B') {
+                player->sub_div = SUB_DIV_BRONZE;
+            }
+            break;
+        case LABEL_REAL_RATING:
+            num = num_parse_double(val.ptr, 0);
+            if (num > 0.0f) {
+                player->real_rating = num;
+                if (player->rating <= 0.0f) {
+                    player->rating = player->real_rating;
+                }
+            }
+            break;
+        case LABEL_RATING:
+            num = num_parse_double(val.ptr, 0);
+            if (num > 0.0f) {
+                player->rating = num;
+                // fix for real rating introduction
+                if (player->real_rating <= 0.0f) {
+                    player->real_rating = player->rating;
+                }
+            }
+            break;
+        case LABEL_WEIGHT:
+            player->total_weight = num_parse_double(val.ptr, 0);
+            break;
+        case LABEL_EVENT_CNT:
+            player->event_count = num_parse_int(val.ptr, 0);
+            break;
+        case LABEL_DQ_CNT:
+            player->dq_count = num_parse_int(val.ptr, 0);
+            break;
+        case LABEL_VERIFIED_CNT:
+            player->verified_count = num_parse_int(val.ptr, 0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// db_read_player
+// parse one DB line with the DB's own reader; line 0 starts a new DB
+int
+db_read_player(player_db_t *db, char *line, char *end)
+{
+    if (!line) {
+        memset(&db->reader, 0, sizeof(db_reader_t)); // forget the last player parsed
+        db->reader.db = db;
+        return 0;
+    }
+    return db_read_line(&db->reader, line, end);
+}
+
+int
+db_read(player_db_t *db, FILE *file)
+{
+    char *cur_line = 0;
+    size_t size = 0;
+    ssize_t len;
+
+    if (!file) {
+        return 0;
+    }
+    db_read_player(db, 0, 0);
+
+    // getline: no line length limit
+    while (TRUE) {
+        len = getline(&cur_line, &size, file);
+        if (len < 0) {
+            fprintf(stderr, "db_read done: found %d players\n", db->player_cnt);
             break;
-        case LABEL_WEIGHT:
-            g_event.weight = atof(ptr);
-            if (g_event.weight < 0.0f) {
-                fprintf(stderr, "Failed weight parse: '%s' = %.3f\n", ptr, g_event.weight);
-                g_event.weight = 1.0f;
+        }
+        db_read_player(db, cur_line, cur_line + len);
+    }
+    free(cur_line);
+    return db->player_cnt;
+}
+
+// db_read_lines
+// parse a DB image in place, one line at a time, without copying lines
+void
+db_read_lines(db_reader_t *rd, char *line, char *end)
+{
+    char *eol, *tail;
+
+    while (line < end) {
+        if (rd->abort && __atomic_load_n(rd->abort, __ATOMIC_RELAXED)) {
+            return;
+        }
+        eol = memchr(line, '\n', end - line);
+        if (!eol) {
+            // unterminated last line: the number parsers need a terminator
+            tail = malloc(end - line + 1);
+            if (tail) {
+                memcpy(tail, line, end - line);
+                tail[end - line] = 0;
+                db_read_line(rd, tail, tail + (end - line));
+                free(tail);
             }
+            return;
+        }
+        db_read_line(rd, line, eol);
+        line = eol + 1;
+    }
+}
+
+// db_record_start
+// returns: the first line at or after pos that starts a player record, as
+// db_write() puts them, with a usable id; end if there's none
+char *
+db_record_start(char *base, char *pos, char *end)
+{
+    static const char tag[] = "Player_id:";
+    char *eol, *ptr;
+    int id;
+
+    if (pos > base && pos[-1] != '\n') {
+        pos = memchr(pos, '\n', end - pos);
+        pos = (pos ? pos + 1 : end);
+    }
+    for (; pos < end; pos = eol + 1) {
+        eol = memchr(pos, '\n', end - pos);
+        if (!eol) {
+            return end; // the last line stays with the chunk before it
+        }
+        if (eol - pos <= (int)sizeof(tag) || memcmp(pos, tag, sizeof(tag)-1)) {
+            continue;
+        }
+        for (ptr = pos + sizeof(tag)-1; ptr < eol && *ptr == ' '; ptr++);
+        for (id = 0; ptr < eol && isdigit(*ptr) && id < MAX_PLAYERS; ptr++) {
+            id = id * 10 + (*ptr - '0');
+        }
+        if (id > 0 && id < MAX_PLAYERS && (ptr == eol || isspace(*ptr))) {
+            return pos;
+        }
+    }
+    return end;
+}
+
+// one chunk of a text DB and the thread parsing it
+typedef struct _db_chunk {
+    db_reader_t rd;
+    char *start;
+    char *end;
+    pthread_t thread;
+} db_chunk_t;
+
+void *
+db_read_thread(void *arg)
+{
+    db_chunk_t *chunk = arg;
+
+    db_read_lines(&chunk->rd, chunk->start, chunk->end);
+    counter_flush();
+    return 0;
+}
+
+// db_read_chunked
+// parse a text DB split at player records, one chunk per thread.  Only an
+// empty DB is read in parallel; names are indexed once all chunks are in.
+// A repeated player id (only the journal repeats them) drops back to the
+// serial reader, so the result always matches it
+// returns: count of players read
+int
+db_read_chunked(player_db_t *db, char *base, size_t size, unsigned threads)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    db_chunk_t chunk[DB_READ_THREADS_MAX];
+    char *end = base + size;
+    char *pos;
+    player_iter_t iter;
+    player_t *player;
+    unsigned n, i, started;
+    int abort = FALSE;
+
+    if (threads > DB_READ_THREADS_MAX) {
+        threads = DB_READ_THREADS_MAX;
+    }
+    db_read_player(db, 0, 0);
+    if (threads < 2 || db->player_cnt != 0 || db->max_player_id != NULL_PLAYER) {
+        db_read_lines(&db->reader, base, end);
+        return db->player_cnt;
+    }
+    // the first chunk also holds the header lines ahead of every record
+    memset(chunk, 0, sizeof(chunk));
+    chunk[0].start = base;
+    for (n = 1; n < threads; n++) {
+        pos = db_record_start(base, base + size / threads * n, end);
+        if (pos <= chunk[n-1].start || pos == end) {
             break;
-        default:
-            if (isgraph(*ptr)) {
-                fprintf(stderr, "Failed label parse for '%s'\n", pptr);
-            }
-            retval--; // didn't find a label after all
-            continue; // check "value" token to see if it's a label
         }
-        ptr = field_skip(ptr); // skip value
-    } while (*ptr && label != LABEL_NONE);
+        chunk[n].start = chunk[n-1].end = pos;
+    }
+    chunk[n-1].end = end;
+    for (i = 0; i < n; i++) {
+        chunk[i].rd.db = db;
+        chunk[i].rd.lock = &lock;
+        chunk[i].rd.abort = &abort;
+    }
+    for (started = 1; started < n; started++) {
+        if (pthread_create(&chunk[started].thread, 0, db_read_thread, &chunk[started])) {
+            break;
+        }
+    }
+    db_read_thread(&chunk[0]);
+    for (i = started; i < n; i++) {
+        db_read_thread(&chunk[i]); // threads that didn't start
+    }
+    for (i = 1; i < started; i++) {
+        pthread_join(chunk[i].thread, 0);
+    }
+    pthread_mutex_destroy(&lock);
 
-    if (got_entry && player) {
-        entry->player_id = player->id;
-        if (time_to_usec(&time) > 0) {
-            entry->time = time;
-        } else if (time_to_usec(&entry->split[0]) > 0) {
-            add_splits(entry);
+    if (abort) {
+        fprintf(stderr, "db_read: repeated player id, reading serially\n");
+        init_players(db);
+        db_read_player(db, 0, 0);
+        db_read_lines(&db->reader, base, end);
+        return db->player_cnt;
+    }
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter)) {
+        index_insert(&db->psn_index, player);
+        index_insert(&db->name_index, player);
+    }
+    return db->player_cnt;
+}
+
+// db_read_mapped
+// parse a DB image in place.  A large image is split across the CPUs
+int
+db_read_mapped(player_db_t *db, char *base, size_t size)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = size / DB_READ_CHUNK_MIN;
+
+    if (cpus > 0 && threads > (size_t)cpus) {
+        threads = cpus;
+    }
+    db_read_chunked(db, base, size, threads);
+    fprintf(stderr, "db_read done: found %d players\n", db->player_cnt);
+    return db->player_cnt;
+}
+
+// db_load
+// memory-map the DB and read it in place, text or binary snapshot; fall
+// back to stdio for anything that can't be mapped (pipes, empty files)
+// returns: count of players read, FAILURE if the DB can't be used
+int
+db_load(player_db_t *db, int fd)
+{
+    struct stat st;
+    char *base;
+    FILE *file;
+    int retval;
+    trace_span_t span;
+
+    if (fd < 0) {
+        return 0;
+    }
+    trace_begin(db->trace, &span, "db_load");
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base != MAP_FAILED) {
+            madvise(base, st.st_size, MADV_SEQUENTIAL);
+            retval = db_read_image(db, base, st.st_size);
+            munmap(base, st.st_size);
+            trace_end(db->trace, &span, st.st_size, db->player_cnt);
+            return retval;
         }
-        ov_head = time_insert(ov_head, &time_sort[g_entry_cnt], entry);
-        g_entry_cnt++;
     }
+    file = fdopen(dup(fd), "r");
+    if (!file) {
+        trace_end(db->trace, &span, 0, 0);
+        return 0;
+    }
+    retval = db_read(db, file);
+    trace_end(db->trace, &span, ftell(file), db->player_cnt);
+    fclose(file);
     return retval;
 }
 
+// the rest of a Qual or History line, from " Event_Status:"
+void
+db_format_race(buf_t *out, race_result_t *rr)
+{
+    buf_put_str(out, (rr->status == STATUS_FINAL ? " Event_Status: F Rating: " : " Event_Status: P Rating: "));
+    buf_put_fixed(out, rr->rating, 6);
+    buf_put_str(out, " Weight: ");
+    buf_put_fixed(out, rr->weight, 6);
+    buf_put_str(out, " ");
+    if (rr->dq) {
+        buf_put_str(out, "DISQ: ");
+        buf_put_str(out, g_dq_text[rr->dq]);
+    }
+    buf_put_str(out, "\n");
+}
+
+// db_format_player
+// append a player's DB record: the player line, then qualifier and history
+// returns: length appended, 0 if out of memory
 int
-scan_event(FILE *file)
+db_format_player(buf_t *out, player_t *player)
 {
-    char cur_line[MAX_LINE_LEN];
-    if (!file) {
+    size_t start = out->len;
+    race_result_t *rr;
+    int i;
+
+    buf_put_str(out, "Player_id: ");
+    buf_put_int(out, (int)player->id);
+    buf_put_str(out, " User: \"");
+    buf_put_str(out, player->name);
+    buf_put_str(out, "\" PSN: \"");
+    buf_put_str(out, player->psn);
+    buf_put_str(out, "\" Div: ");
+    buf_put_int(out, (int)player->div);
+    buf_put_str(out, " Sub: ");
+    buf_append(out, g_subdiv_text[player->sub_div], 1);
+    buf_put_str(out, " Rating: ");
+    buf_put_fixed(out, player->rating, 6);
+    buf_put_str(out, " RRating: ");
+    buf_put_fixed(out, player->real_rating, 6);
+    buf_put_str(out, " Weight: ");
+    buf_put_fixed(out, player->total_weight, 6);
+    buf_put_str(out, " Events: ");
+    buf_put_int(out, (int)player->event_count);
+    buf_put_str(out, " DQS: ");
+    buf_put_int(out, (int)player->dq_count);
+    buf_put_str(out, " VERI: ");
+    buf_put_int(out, (int)player->verified_count);
+    if (*player->country) {
+        buf_put_str(out, "  Country: \"");
+        buf_put_str(out, player->country);
+        buf_put_str(out, "\"\n");
+    } else {
+        buf_put_str(out, " \n");
+    }
+    if (player->qualifier.status != STATUS_NONE) {
+        buf_put_str(out, "Qual:");
+        db_format_race(out, &player->qualifier);
+    }
+    for (i = 0, rr = &player->history[i];
+            i < RACE_HISTORY && rr->status != STATUS_NONE;
+            i++, rr = &player->history[i]) {
+        buf_put_str(out, "History: Week: ");
+        buf_put_int(out, (int)rr->race_id);
+        db_format_race(out, rr);
+    }
+    if (out->failed) { // drop the partial record
+        out->len = start;
         return 0;
     }
-    while (!feof(file) && (g_entry_cnt < MAX_RACERS)) {
-        memset(cur_line, 0, MAX_LINE_LEN);
-        if (fgets(cur_line, MAX_LINE_LEN-1, file) == 0) {
-            fprintf(stderr, "scan_event done: found %d entries; %d players in DB\n", g_entry_cnt, player_cnt);
-            return g_entry_cnt;
+    return out->len - start;
+}
+
+int
+db_write_player(FILE *file, player_t *player)
+{
+    buf_t out = { 0 };
+    int retval;
+
+    if (!file || !player) {
+        return 0;
+    }
+    retval = db_format_player(&out, player);
+    fwrite(out.data, 1, out.len, file);
+    buf_free(&out);
+    return retval;
+}
+
+// one thread's share of a db_write() batch: players first..last-1
+typedef struct _db_format_job {
+    player_db_t *db;
+    unsigned first;
+    unsigned last;
+    int count;
+    buf_t out;
+    pthread_t thread;
+} db_format_job_t;
+
+void *
+db_format_thread(void *arg)
+{
+    db_format_job_t *job = arg;
+    player_t *player;
+    unsigned id;
+
+    job->out.len = 0;
+    job->count = 0;
+    for (id = job->first; id < job->last; id++) {
+        player = pool_peek(&job->db->pool, id);
+        if (player && player->valid == TRUE && db_format_player(&job->out, player)) {
+            job->count++;
         }
-        event_process_line(cur_line, &entry_db[g_entry_cnt]);
     }
-    fprintf(stderr, "scan_event done: max players (%d) exceeded\n", g_entry_cnt);
-    return g_entry_cnt;
+    return 0;
 }
 
-/************************************************/
-/* player database                              */
-/************************************************/
-char *
-db_parse_history(char *ptr, race_result_t *race)
+// db_write_threads
+// format the players in batches of id ranges, one range per thread, each
+// into its own buffer, then write the buffers in id order
+// returns: count of players written
+int
+db_write_threads(player_db_t *db, FILE *file, unsigned threads)
 {
-    label_e label;
-    char *pptr;
+    db_format_job_t *job;
+    unsigned next, i, started;
+    unsigned end = db->max_player_id + 1;
+    int retval = 0;
 
-    if (!ptr || !race) {
+    if (!file) {
         return 0;
     }
-    do {
-        pptr = ptr;
-        label = label_get(ptr);
-        ptr = label_skip(ptr);
-        switch (label) {
-        case LABEL_WEEK:
-            race->race_id = atoi(ptr);
-            break;
-        case LABEL_EVENT_STATUS:
-            if (toupper(*ptr) == 'F') {
-                race->status = STATUS_FINAL;
-            } else if (toupper(*ptr) == 'P') {
-                race->status = STATUS_PROVISIONAL;
-            } else {
-                fprintf(stderr, "History: Unknown status: '%s'\n", ptr);
-            }
-            break;
-        case LABEL_RATING:
-            race->rating = atof(ptr);
-            break;
-        case LABEL_WEIGHT:
-            race->weight = atof(ptr);
-            if (race->weight < 0.0f) {
-                fprintf(stderr, "History: Failed weight parse: '%s' = %.3f\n", ptr, race->weight);
-                race->weight = 1.0f;
-            }
-            break;
-        case LABEL_STATUS:
-        case LABEL_DISQ:
-            if (toupper(*ptr) == 'O') {
-                race->dq = DQ_OFF_TRACK;
-            } else if (toupper(*ptr) == 'C') {
-                race->dq = DQ_CONTACT;
-            } else if (toupper(*ptr) == 'R') {
-                race->dq = DQ_NO_REPLAY;
-            } else if (toupper(*ptr) == 'T') {
-                race->dq = DQ_TIME_ERROR;
-            } else if (toupper(*ptr) == 'N') {
-                race->dq = DQ_NAME_VIOLATION;
-            } else if (toupper(*ptr) == 'X') {
-                race->dq = DQ_CUSTOM_VIOLATION;
-            } else if ((toupper(*ptr) == 'S') || (toupper(*ptr) == 'U')) {
-                race->dq = DQ_SUBMITTED;
-            } else if (toupper(*ptr) == 'V' || toupper(*ptr) == 'G') {
-                race->dq = DQ_VERIFIED;
-            } else {
-                race->dq = DQ_OK;
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > end / DB_WRITE_BATCH + 1) {
+        threads = end / DB_WRITE_BATCH + 1;
+    }
+    job = calloc(threads, sizeof(db_format_job_t));
+    if (!job) {
+        return 0;
+    }
+    fprintf(file, "# WRS DB START\n\n");
+    for (next = 1; next < end; ) {
+        for (i = 0; i < threads; i++) {
+            job[i].db = db;
+            job[i].first = next;
+            next = (end - next > DB_WRITE_BATCH ? next + DB_WRITE_BATCH : end);
+            job[i].last = next;
+        }
+        for (started = 1; started < threads; started++) {
+            if (pthread_create(&job[started].thread, 0, db_format_thread, &job[started])) {
+                break;
             }
+        }
+        db_format_thread(&job[0]);
+        for (i = started; i < threads; i++) {
+            db_format_thread(&job[i]); // threads that didn't start
+        }
+        for (i = 1; i < started; i++) {
+            pthread_join(job[i].thread, 0);
+        }
+        for (i = 0; i < threads; i++) {
+            fwrite(job[i].out.data, 1, job[i].out.len, file);
+            retval += job[i].count;
+        }
+    }
+    fprintf(file, "\n# WRS DB END\n");
+    for (i = 0; i < threads; i++) {
+        buf_free(&job[i].out);
+    }
+    free(job);
+    return retval;
+}
+
+// db_write
+// the DB in text, formatted on all CPUs
+// returns: count of players written
+int
+db_write(player_db_t *db, FILE *file)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return db_write_threads(db, file, (cpus > 0 ? cpus : 1));
+}
+
+// db_reload
+// round-trip the in-memory DB through the file format, so the next event in
+// a batch sees exactly what a separate run would read back (ratings and
+// weights are only stored to 6 decimals, latest results aren't stored)
+// returns: count of players read
+int
+db_reload(player_db_t *db)
+{
+    char *buf = 0;
+    size_t size = 0;
+    FILE *file;
+    int retval;
+    trace_span_t span;
+
+    file = open_memstream(&buf, &size);
+    if (!file) {
+        fprintf(stderr, "db_reload: out of memory\n");
+        return db->player_cnt;
+    }
+    trace_begin(db->trace, &span, "db_reload");
+    db_write(db, file);
+    fclose(file);
+    init_players(db);
+    retval = db_read_mapped(db, buf, size);
+    free(buf);
+    trace_end(db->trace, &span, size, db->player_cnt);
+    return retval;
+}
+
+/************************************************/
+// DB journal: a run appends the players it changed to dbfile.jnl, in DB
+// format, as one batch ending in a commit line, rather than rewriting the
+// whole registry.  A later record of a player replaces the earlier one, so
+// the DB is the snapshot read, then the journal.  Once the journal passes
+// 1/DB_JOURNAL_RATIO of the snapshot, the next save compacts both into a
+// new snapshot.
+
+char *
+db_journal_name(char *out, char *dbfilename)
+{
+    snprintf(out, MAX_STR_LEN, "%s%s", dbfilename, DB_JOURNAL_EXT);
+    return out;
+}
+
+// db_journal_committed
+// returns: length of a journal image up to the end of its last commit line;
+// anything after that is a batch cut short, which doesn't count
+size_t
+db_journal_committed(char *base, size_t size)
+{
+    char *line = base;
+    char *end = base + size;
+    char *eol;
+    size_t committed = 0;
+    size_t len = strlen(DB_JOURNAL_COMMIT);
+
+    while (line < end) {
+        eol = memchr(line, '\n', end - line);
+        if (!eol) {
             break;
-        default:
-            return pptr; // points to first unhandled token
         }
-        ptr = field_skip(ptr); // skip value
-    } while (*ptr && label != LABEL_NONE);
+        if (eol - line >= len && !memcmp(line, DB_JOURNAL_COMMIT, len)) {
+            committed = eol + 1 - base;
+        }
+        line = eol + 1;
+    }
+    return committed;
+}
 
-    return ptr;
+// db_journal_replay
+// apply the DB's journal, if it has one, over the snapshot already read
+// returns: count of players, FAILURE if the journal can't be read
+int
+db_journal_replay(player_db_t *db, char *dbfilename)
+{
+    char name[MAX_STR_LEN];
+    char *buf;
+    size_t size;
+    FILE *file;
+    long len;
+
+    db->journal_len = 0;
+    file = fopen(db_journal_name(name, dbfilename), "r");
+    if (!file) {
+        return db->player_cnt;
+    }
+    fseek(file, 0, SEEK_END);
+    len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buf = (len >= 0 ? malloc(len + 1) : 0);
+    if (!buf) {
+        fprintf(stderr, "db journal: can't read '%s'\n", name);
+        fclose(file);
+        return FAILURE;
+    }
+    size = fread(buf, 1, len, file);
+    fclose(file);
+    db->journal_len = db_journal_committed(buf, size);
+    fprintf(stderr, "db journal: %s\n", name);
+    if (db->journal_len < size) {
+        fprintf(stderr, "db journal: dropping %zu bytes of an unfinished batch\n", size - db->journal_len);
+    }
+    db_read_mapped(db, buf, db->journal_len);
+    free(buf);
+    return db->player_cnt;
+}
+
+void
+db_mark_clean(player_db_t *db)
+{
+    player_t *player;
+    player_iter_t iter;
+
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter)) {
+        player->dirty = FALSE;
+    }
 }
 
+// db_journal_append
+// append the players changed since the DB was read or saved as one batch,
+// on disk before it counts.  An unfinished batch left by a crash is cut
+// off first
+// returns: SUCCESS or FAILURE
 int
-db_read_player(char *line)
+db_journal_append(player_db_t *db, char *dbfilename)
 {
-    static player_t *player = 0;
-    static int history_idx;
-    int retval = 0;
-    label_e label;
-    char buf[MAX_STR_LEN];
-    int len, id;
-    char *ptr = line;
-    char *pptr;
+    char name[MAX_STR_LEN];
+    char *buf = 0;
+    size_t size = 0, done;
+    ssize_t len;
+    FILE *file;
+    player_t *player;
+    player_iter_t iter;
+    int fd, count = 0, retval = SUCCESS;
+    trace_span_t span;
 
-    if (!line) {
-        return 0;
+    file = open_memstream(&buf, &size);
+    if (!file) {
+        return FAILURE;
     }
-    do {
-        pptr = ptr;
-        label = label_get(ptr);
-        ptr = label_skip(ptr); // skip label
-        retval++;
-        if (label == LABEL_PLAYER_ID) {
-            id = atoi(ptr);
-            ptr = field_skip(ptr); // skip field
-            if (id <= 0 || id >= MAX_PLAYERS) {
-                fprintf(stderr, "bad player id = %d\n", id);
-                return 0;
-            }
-            player = &player_db[id];
-            player->id = id;
-            player->valid = TRUE;
-            player_cnt++;
-            history_idx = -1;
-            if (id > max_player_id) {
-                max_player_id = id;
-            }
-        } else if (player) {
-            switch(label) {
-            case LABEL_COMMENT:
-                retval--; // skip rest of line
-                break;
-            case LABEL_NAME:
-            case LABEL_PSN:
-                field_copy(player->psn, ptr);
-                break;
-            case LABEL_USER:
-                field_copy(player->name, ptr);
-                break;
-            case LABEL_COUNTRY:
-                field_copy(player->country, ptr);
-                break;
-            case LABEL_DIV:
-                player->div = atoi(ptr);
-                break;
-            case LABEL_SUB_DIV:
-                if (isdigit(ptr[0])) {
-                    player->sub_div = atoi(ptr);
-                } else if (ptr[0] == 'g' || ptr[0] == 'G') {
-                    player->sub_div = SUB_DIV_GOLD;
-                } else if (ptr[0] == 's' || ptr[0] == 'S') {
-                    player->sub_div = SUB_DIV_SILVER;
-                } else if (ptr[0] == 'b' || ptr[0] == 'B') {
-                    player->sub_div = SUB_DIV_BRONZE;
-                }
-                break;
-            case LABEL_REAL_RATING:
-                if (atof(ptr) > 0.0f) {
-                    player->real_rating = atof(ptr);
-                    if (player->rating <= 0.0f) {
-                        player->rating = player->real_rating;
-                    }
-                }
-                break;
-            case LABEL_RATING:
-                if (atof(ptr) > 0.0f) {
-                    player->rating = atof(ptr);
-                    // fix for real rating introduction
-                    if (player->real_rating <= 0.0f) {
-                        player->real_rating = player->rating;
-                    }
-                }
-                break;
-            case LABEL_WEIGHT:
-                player->total_weight = atof(ptr);
-                break;
-            case LABEL_EVENT_CNT:
-                player->event_count = atoi(ptr);
-                break;
-            case LABEL_DQ_CNT:
-                player->dq_count = atoi(ptr);
-                break;
-            case LABEL_VERIFIED_CNT:
-                player->verified_count = atoi(ptr);
-                break;
-            case LABEL_QUALIFIER:
-                player->qualifier.race_id = 0;
-                ptr = db_parse_history(ptr, &player->qualifier);
-                continue; // avoid value field_skip
-            case LABEL_HISTORY:
-                history_idx++;
-                if (history_idx < RACE_HISTORY) {
-                    ptr = db_parse_history(ptr, &player->history[history_idx]);
-                    continue; // avoid value field_skip
-                } else {
-                    fprintf(stderr, "LABEL_HISTORY: too much history (%d) for player %d\n", history_idx, id);
-                }
-                break;
-            }
-            ptr = field_skip(ptr); // skip value
+    trace_begin(db->trace, &span, "db_journal_append");
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter)) {
+        if (player->dirty) {
+            db_write_player(file, player);
+            count++;
+        }
+    }
+    fprintf(file, "%s %d players\n", DB_JOURNAL_COMMIT, count);
+    fclose(file);
+    if (count == 0) {
+        free(buf);
+        trace_end(db->trace, &span, 0, 0);
+        return SUCCESS;
+    }
+
+    fd = open(db_journal_name(name, dbfilename), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, db->journal_len) || lseek(fd, db->journal_len, SEEK_SET) < 0) {
+        retval = FAILURE;
+    }
+    for (done = 0; retval == SUCCESS && done < size; done += len) {
+        len = write(fd, buf + done, size - done);
+        if (len <= 0) {
+            retval = FAILURE;
+            len = 0;
         }
-    } while (*ptr && label != LABEL_NONE);
+    }
+    if (retval == SUCCESS && fsync(fd)) {
+        retval = FAILURE;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+    trace_end(db->trace, &span, (retval == SUCCESS ? size : 0), count);
+    if (retval != SUCCESS) {
+        fprintf(stderr, "Failed to write db journal '%s'\n", name);
+        return FAILURE;
+    }
+    fprintf(stderr, "db journal: %s, %d players\n", name, count);
+    db->journal_len += size;
+    db_mark_clean(db);
+    return SUCCESS;
+}
 
-    return 0;
+// db_snapshot
+// write the whole DB next to dbfile and rename it into place, then drop the
+// journal it now holds.  A crash in between leaves a journal that replays
+// to the same players
+int
+db_snapshot(player_db_t *db, char *dbfilename)
+{
+    char tmpname[MAX_STR_LEN + 8], name[MAX_STR_LEN];
+    FILE *file;
+    int count, retval;
+    long bytes;
+    trace_span_t span;
+
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", dbfilename);
+    file = fopen(tmpname, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open dbfile '%s'\n", tmpname);
+        return FAILURE;
+    }
+    trace_begin(db->trace, &span, "db_write");
+    if (db->binary) {
+        count = db_write_binary(db, file);
+    } else {
+        count = db_write(db, file);
+    }
+    // a short write keeps the old DB and its journal
+    retval = (count != db->player_cnt || fflush(file) || fsync(fileno(file)));
+    bytes = ftell(file);
+    if (fclose(file) || retval || rename(tmpname, dbfilename)) {
+        fprintf(stderr, "Failed to write dbfile '%s'\n", dbfilename);
+        unlink(tmpname);
+        trace_end(db->trace, &span, 0, 0);
+        return FAILURE;
+    }
+    unlink(db_journal_name(name, dbfilename));
+    db->journal_len = 0;
+    db_mark_clean(db);
+    trace_end(db->trace, &span, bytes, db->player_cnt);
+    return SUCCESS;
 }
 
+// db_save
+// journal: TRUE appends the changed players to the journal, compacting once
+//          it passes 1/DB_JOURNAL_RATIO of the snapshot; FALSE writes a new
+//          snapshot, folding in any journal.  The journal picks up from what
+//          db_journal_replay() found
+// returns: SUCCESS or FAILURE
 int
-db_read(FILE *file)
+db_save(player_db_t *db, char *dbfilename, int journal)
 {
-    char cur_line[MAX_LINE_LEN];
+    struct stat st;
 
-    if (!file) {
+    if (journal && stat(dbfilename, &st) == 0 &&
+            db_journal_append(db, dbfilename) == SUCCESS) {
+        if (db->journal_len * DB_JOURNAL_RATIO <= (size_t)st.st_size) {
+            return SUCCESS;
+        }
+        fprintf(stderr, "db journal: %zu bytes, compacting\n", db->journal_len);
+    }
+    return db_snapshot(db, dbfilename);
+}
+
+/************************************************/
+// binary DB snapshot: the registry in fixed size records, so a load is
+// page faults and copies rather than tokens and atof().  Numbers are stored
+// as the text DB prints them (%f: millionths), so a DB converted either way
+// reads back to the same players, and writes back to the same text
+
+// db_fixed6
+// returns: x in millionths, rounded exactly as printf("%f") rounds it
+int64_t
+db_fixed6(double x)
+{
+    if (isnan(x)) {
         return 0;
     }
+    if (fabs(x) >= DB_FIXED6_MAX) {
+        return (int64_t)(signbit(x) ? -DB_FIXED6_MAX : DB_FIXED6_MAX) * 1000000;
+    }
+    return num_fixed(x, 6);
+}
 
-    while (!feof(file) && (player_cnt < MAX_PLAYERS)) {
-        memset(cur_line, 0, MAX_LINE_LEN);
-        if (fgets(cur_line, MAX_LINE_LEN-1, file) == 0) {
-            fprintf(stderr, "db_read done: found %d players\n", player_cnt);
-            return player_cnt;
-        }
-        db_read_player(cur_line);
+// db_fixed6_double
+// returns: the double atof() reads back from the printed value
+double
+db_fixed6_double(int64_t m)
+{
+    if (m == DB_FIXED6_NEG_ZERO) {
+        return -0.0;
     }
-    return player_cnt;
+    return (double)m / 1e6;
 }
 
-int
-db_write_player(FILE *file, player_t *player)
+// db_bin_size
+// returns: size of the binary snapshot at the start of an image, 0 if it
+// doesn't hold one (a text DB) or the snapshot is damaged
+size_t
+db_bin_size(char *base, size_t size)
 {
-    char line[MAX_LINE_LEN];
-    int retval = 0, len, i;
-    race_result_t *rr;
+    db_bin_header_t hdr;
 
-    if (!file || !player) {
+    if (!base || size < sizeof(hdr) || memcmp(base, DB_BIN_MAGIC, sizeof(hdr.magic))) {
+        return 0;
+    }
+    memcpy(&hdr, base, sizeof(hdr));
+    if (hdr.version != DB_BIN_VERSION || hdr.order != DB_BIN_ORDER) {
+        fprintf(stderr, "db_bin_size: unknown binary DB version %u order %08x\n", hdr.version, hdr.order);
         return 0;
     }
+    // the regions in order inside the snapshot, each checked on its own:
+    // no sum of header fields, which could wrap
+    if (hdr.header_size < sizeof(db_bin_header_t) ||
+            hdr.player_size < sizeof(db_bin_player_t) ||
+            hdr.race_size < sizeof(db_bin_race_t) ||
+            hdr.total_size > size ||
+            hdr.player_off < hdr.header_size ||
+            hdr.history_off < hdr.player_off ||
+            hdr.string_off < hdr.history_off ||
+            hdr.string_off > hdr.total_size ||
+            hdr.player_cnt > (hdr.history_off - hdr.player_off) / hdr.player_size ||
+            hdr.history_cnt > (hdr.string_off - hdr.history_off) / hdr.race_size ||
+            hdr.string_size == 0 ||
+            hdr.string_size > hdr.total_size - hdr.string_off ||
+            base[hdr.string_off + hdr.string_size - 1] != 0) {
+        fprintf(stderr, "db_bin_size: damaged binary DB\n");
+        return 0;
+    }
+    return hdr.total_size;
+}
 
-    retval = sprintf(line, "Player_id: %d User: \"%s\" PSN: \"%s\" Div: %d Sub: %c Rating: %f RRating: %f Weight: %f Events: %d DQS: %d VERI: %d ", player->id, player->name, player->psn, player->div, g_subdiv_text[player->sub_div][0], player->rating, player->real_rating, player->total_weight, player->event_count, player->dq_count, player->verified_count);
-    if (retval) {
-        if (*player->country) {
-            retval = fprintf(file, "%s Country: \"%s\"\n", line, player->country);
-        } else {
-            fprintf(file, "%s\n", line);
-        }
+// db_bin_string: copy of string table entry off, "" if out of range
+char *
+db_bin_string(char *out, char *strings, uint64_t string_size, uint32_t off)
+{
+    if (off >= string_size) {
+        off = 0;
     }
-    if (player->qualifier.status != STATUS_NONE) {
-        rr = &player->qualifier;
-        len = sprintf(line, "Qual: Event_Status: %c Rating: %f Weight: %f %s%s", (rr->status == STATUS_FINAL ? 'F' : 'P'), rr->rating, rr->weight, (rr->dq ? "DISQ: " : ""), (rr->dq ? g_dq_text[rr->dq] : ""));
-        retval += len;
-        if (len) {
-            fprintf(file, "%s\n", line);
-        }
+    strncpy(out, strings + off, MAX_NAME_LEN-1);
+    out[MAX_NAME_LEN-1] = 0;
+    return out;
+}
+
+uint32_t
+db_bin_string_add(char *strings, size_t *used, char *string)
+{
+    size_t off = *used;
+
+    if (!*string) {
+        return 0; // offset 0 holds ""
     }
-    for (i = 0, rr = &player->history[i];
-            i < RACE_HISTORY && rr->status != STATUS_NONE;
-            i++, rr = &player->history[i]) {
-        len = sprintf(line, "History: Week: %d Event_Status: %c Rating: %f Weight: %f %s%s", rr->race_id, (rr->status == STATUS_FINAL ? 'F' : 'P'), rr->rating, rr->weight, (rr->dq ? "DISQ: " : ""), (rr->dq ? g_dq_text[rr->dq] : ""));
-        retval += len;
-        if (len) {
-            fprintf(file, "%s\n", line);
-        }
+    if (strings) {
+        strcpy(strings + off, string);
     }
+    *used += strlen(string) + 1;
+    return off;
+}
 
-    return retval;
+// db_bin_race_set: a race as db_write_player() prints it
+void
+db_bin_race_set(db_bin_race_t *out, race_result_t *rr, unsigned race_id)
+{
+    memset(out, 0, sizeof(db_bin_race_t));
+    out->race_id = race_id;
+    out->status = (rr->status == STATUS_FINAL ? STATUS_FINAL : STATUS_PROVISIONAL);
+    out->dq = rr->dq;
+    out->rating = db_fixed6(rr->rating);
+    out->weight = db_fixed6(rr->weight);
+}
+
+// db_bin_race_get: a race as db_parse_history() reads it
+void
+db_bin_race_get(race_result_t *rr, db_bin_race_t *in)
+{
+    rr->race_id = in->race_id;
+    rr->status = in->status;
+    rr->dq = in->dq;
+    rr->rating = db_fixed6_double(in->rating);
+    rr->weight = db_fixed6_double(in->weight);
+    if (rr->weight < 0.0f) {
+        fprintf(stderr, "History: Failed weight parse: '%f' = %.3f\n", rr->weight, rr->weight);
+        rr->weight = 1.0f;
+    }
 }
 
+// db_write_binary
+// the DB as a binary snapshot, holding what db_write() would write
+// returns: count of players written
 int
-db_write(FILE *file)
+db_write_binary(player_db_t *db, FILE *file)
 {
+    db_bin_header_t hdr;
+    db_bin_player_t *rec;
+    db_bin_race_t *race;
     player_t *player;
     player_iter_t iter;
-    int retval = 0;
+    char *buf, *strings;
+    size_t used;
+    unsigned i;
 
     if (!file) {
         return 0;
     }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DB_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = DB_BIN_VERSION;
+    hdr.order = DB_BIN_ORDER;
+    hdr.header_size = sizeof(db_bin_header_t);
+    hdr.player_size = sizeof(db_bin_player_t);
+    hdr.race_size = sizeof(db_bin_race_t);
+
+    // sizing pass
+    used = 1;
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter)) {
+        hdr.player_cnt++;
+        for (i = 0; i < RACE_HISTORY && player->history[i].status != STATUS_NONE; i++) {
+            hdr.history_cnt++;
+        }
+        db_bin_string_add(0, &used, player->name);
+        db_bin_string_add(0, &used, player->psn);
+        db_bin_string_add(0, &used, player->country);
+    }
+    hdr.player_off = (sizeof(hdr) + 7) & ~7;
+    hdr.history_off = hdr.player_off + (uint64_t)hdr.player_cnt * sizeof(db_bin_player_t);
+    hdr.string_off = hdr.history_off + (uint64_t)hdr.history_cnt * sizeof(db_bin_race_t);
+    hdr.string_size = used;
+    hdr.total_size = hdr.string_off + hdr.string_size;
+    buf = calloc(1, hdr.total_size);
+    if (!buf) {
+        fprintf(stderr, "db_write_binary: out of memory\n");
+        return 0;
+    }
+    memcpy(buf, &hdr, sizeof(hdr));
+
+    rec = (db_bin_player_t *)(buf + hdr.player_off);
+    race = (db_bin_race_t *)(buf + hdr.history_off);
+    strings = buf + hdr.string_off;
+    used = 1;
+    for (player = player_get_first(db, &iter); player; player = player_get_next(&iter), rec++) {
+        rec->id = player->id;
+        rec->name = db_bin_string_add(strings, &used, player->name);
+        rec->psn = db_bin_string_add(strings, &used, player->psn);
+        rec->country = db_bin_string_add(strings, &used, player->country);
+        rec->rating = db_fixed6(player->rating);
+        rec->real_rating = db_fixed6(player->real_rating);
+        rec->total_weight = db_fixed6(player->total_weight);
+        rec->div = player->div;
+        rec->sub_div = player->sub_div;
+        rec->event_count = player->event_count;
+        rec->dq_count = player->dq_count;
+        rec->verified_count = player->verified_count;
+        if (player->qualifier.status != STATUS_NONE) {
+            db_bin_race_set(&rec->qualifier, &player->qualifier, 0);
+        }
+        rec->history = race - (db_bin_race_t *)(buf + hdr.history_off);
+        for (i = 0; i < RACE_HISTORY && player->history[i].status != STATUS_NONE; i++) {
+            db_bin_race_set(race++, &player->history[i], player->history[i].race_id);
+            rec->history_cnt++;
+        }
+    }
+    if (fwrite(buf, 1, hdr.total_size, file) != hdr.total_size) {
+        hdr.player_cnt = 0;
+    }
+    free(buf);
+    return hdr.player_cnt;
+}
 
-    fprintf(file, "# WRS DB START\n\n");
-    for (player = player_get_first(&iter); player; player = player_get_next(&iter)) {
-        if (db_write_player(file, player)) {
-            retval++;
+// db_read_binary
+// load a binary snapshot, as db_read_player() would the same DB in text
+// returns: count of players read
+int
+db_read_binary(player_db_t *db, char *base, size_t size)
+{
+    db_bin_header_t hdr;
+    db_bin_player_t rec;
+    db_bin_race_t race;
+    player_t *player;
+    char *strings, buf[MAX_NAME_LEN];
+    unsigned i, j, cnt;
+
+    if (!db_bin_size(base, size)) {
+        return db->player_cnt;
+    }
+    memcpy(&hdr, base, sizeof(hdr));
+    strings = base + hdr.string_off;
+    db_read_player(db, 0, 0);
+    for (i = 0; i < hdr.player_cnt; i++) {
+        // records are copied out: a buffer handed in need not be aligned
+        memcpy(&rec, base + hdr.player_off + (uint64_t)i * hdr.player_size, sizeof(rec));
+        if (rec.id == 0 || rec.id >= MAX_PLAYERS) {
+            fprintf(stderr, "bad player id = %u\n", rec.id);
+            continue;
+        }
+        player = player_alloc(db, rec.id);
+        if (!player) {
+            fprintf(stderr, "db_read_binary: out of memory at id %u\n", rec.id);
+            break;
+        }
+        if (player->valid) {
+            player_clear(player);
+        } else {
+            db->player_cnt++;
+        }
+        player->id = rec.id;
+        player->valid = TRUE;
+        if ((int)rec.id > db->max_player_id) {
+            db->max_player_id = rec.id;
+        }
+        if (*db_bin_string(buf, strings, hdr.string_size, rec.name)) {
+            player_set_name(db, player, buf);
+        }
+        if (*db_bin_string(buf, strings, hdr.string_size, rec.psn)) {
+            player_set_psn(db, player, buf);
+        }
+        db_bin_string(player->country, strings, hdr.string_size, rec.country);
+        player->div = rec.div;
+        player->sub_div = (rec.sub_div <= SUB_DIV_BRONZE ? rec.sub_div : SUB_DIV_GOLD);
+        // only positive ratings count, as in the text DB
+        if (rec.rating > 0) {
+            player->rating = db_fixed6_double(rec.rating);
+        }
+        if (rec.real_rating > 0) {
+            player->real_rating = db_fixed6_double(rec.real_rating);
+        }
+        if (player->rating <= 0.0f) {
+            player->rating = player->real_rating;
+        }
+        if (player->real_rating <= 0.0f) {
+            player->real_rating = player->rating;
+        }
+        player->total_weight = db_fixed6_double(rec.total_weight);
+        player->event_count = rec.event_count;
+        player->dq_count = rec.dq_count;
+        player->verified_count = rec.verified_count;
+        if (rec.qualifier.status != STATUS_NONE) {
+            db_bin_race_get(&player->qualifier, &rec.qualifier);
+            player->qualifier.race_id = 0;
+        }
+        cnt = rec.history_cnt;
+        if (rec.history > hdr.history_cnt || cnt > hdr.history_cnt - rec.history) {
+            fprintf(stderr, "db_read_binary: bad history for player %u\n", rec.id);
+            cnt = 0;
+        } else if (cnt > RACE_HISTORY) {
+            fprintf(stderr, "LABEL_HISTORY: too much history (%u) for player %u\n", cnt - 1, rec.id);
+            cnt = RACE_HISTORY;
+        }
+        for (j = 0; j < cnt; j++) {
+            memcpy(&race, base + hdr.history_off + (uint64_t)(rec.history + j) * hdr.race_size, sizeof(race));
+            db_bin_race_get(&player->history[j], &race);
         }
     }
-    fprintf(file, "\n# WRS DB END\n");
-    return retval;
+    fprintf(stderr, "db_read done: found %d players\n", db->player_cnt);
+    return db->player_cnt;
+}
+
+// db_read_image
+// load a DB image in either format.  Text may follow a binary snapshot,
+// such as its journal
+// returns: count of players read, FAILURE for a damaged binary snapshot
+int
+db_read_image(player_db_t *db, char *base, size_t size)
+{
+    size_t bin = db_bin_size(base, size);
+
+    db->binary = (bin > 0);
+    if (!bin && size >= sizeof(DB_BIN_MAGIC) && !memcmp(base, DB_BIN_MAGIC, sizeof(DB_BIN_MAGIC))) {
+        return FAILURE; // not text either: don't start the registry over
+    }
+    if (!bin) {
+        return db_read_mapped(db, base, size);
+    }
+    db_read_binary(db, base, bin);
+    if (bin < size) {
+        db_read_mapped(db, base + bin, size - bin);
+    }
+    return db->player_cnt;
 }
 
 void
@@ -2481,7 +4903,7 @@ race_result_swap(race_result_t *a, race_result_t *b)
 }
 
 void
-db_update()
+db_update(context_t *ctx)
 {
     player_t *player;
     entry_t *cur;
@@ -2491,18 +4913,21 @@ db_update()
     unsigned update_done;
     unsigned oldest_history;
     race_result_t tmp;
+    trace_span_t span;
 
+    trace_begin(ctx->db->trace, &span, "db_update");
     // XXX: tmp
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_ALL); cur; cur = entry_get_next(&iter)) {
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_ALL); cur; cur = entry_get_next(&iter)) {
         oldest_history = 999999;
-        player = player_get(cur->player_id);
+        player = player_get(ctx->db, cur->player_id);
         if (player && player->valid) {
-            race_result_set(player, g_event.week, g_event.status, cur->dq, g_event.weight, cur->rating);
+            player->dirty = TRUE;
+            race_result_set(player, ctx->event.week, ctx->event.status, cur->dq, ctx->event.weight, cur->rating);
             fold_rating = FALSE;
-            if (g_event.status == STATUS_FINAL) {
+            if (ctx->event.status == STATUS_FINAL) {
                 fold_rating = TRUE; // will fold, unless already accounted for
             }
-            if (g_event.week == EVENT_QUALIFIER) { // qualifier check
+            if (ctx->event.week == EVENT_QUALIFIER) { // qualifier check
                 if (player->qualifier.status == STATUS_FINAL) {
                     // already accounted for
                     fold_rating = FALSE;
@@ -2533,25 +4958,27 @@ db_update()
                         for (i = 0; i < RACE_HISTORY; i++) {
                             race_result_swap(&tmp, &player->history[i]);
                         }
+                        COUNT(COUNTER_HISTORY_SWAP, RACE_HISTORY);
                     }
                 }
             }
             if (fold_rating == TRUE) {
                 player_update_rating(player);
 // obsolete
-//                if (g_event.week == EVENT_QUALIFIER) {
-//                    player_div_set(player->id, player->rating);
+//                if (ctx->event.week == EVENT_QUALIFIER) {
+//                    player_div_set(ctx->db, player->id, player->rating);
 //                }
             }
         }
     }
+    trace_end(ctx->db->trace, &span, 0, ctx->entry_cnt);
 }
 
 /************************************************/
 /* output                                       */
 /************************************************/
 void
-rating_string(char *buffer, entry_t *e)
+rating_string(context_t *ctx, char *buffer, entry_t *e)
 {
     int i;
     int thumb_cnt = 0;
@@ -2560,7 +4987,7 @@ rating_string(char *buffer, entry_t *e)
 
     if (dq_ok(e->dq)) {
         // only :tup: when 3+ racer in div res
-        if (div_stat[entry_div(e)].count >=3 && e->hcp_delta <= -SUB_DIVISION_RANGE) {
+        if (ctx->div_stat[entry_div(e)].count >=3 && e->hcp_delta <= -SUB_DIVISION_RANGE) {
     //        thumb_cnt = -(3.0f * e->hcp_delta);
             thumb_cnt = 1;
     //    } else if (e->prov_div < entry_div(e)) {
@@ -2573,330 +5000,672 @@ rating_string(char *buffer, entry_t *e)
     }
 }
 
+// render_entry
+// one result line, into out
 void
-dump_entry(FILE *file, entry_t *e, display_opt_e opt, int place)
+render_entry(context_t *ctx, buf_t *out, entry_t *e, display_opt_e opt, int place)
 {
     int i;
     char rating[MAX_NAME_LEN];
     player_t *player;
+    char rbuf[MAX_NAME_LEN], nbuf[MAX_NAME_LEN];
+    ttime_t time;
 
     rating[0] = 0;
-    if (g_event.week == EVENT_QUALIFIER) {
-        player = player_get(e->player_id);
+    if (ctx->event.week == EVENT_QUALIFIER) {
+        player = player_get(ctx->db, e->player_id);
         if (!player) {
             return;
         }
         if (opt != SHOW_RATINGS) { // for display
-            fprintf(file, "%s / %s / %s (",
-                player->psn, player->name, player_country(e->player_id));
+            buf_put_str(out, player->psn);
+            buf_put_str(out, " / ");
+            buf_put_str(out, player->name);
+            buf_put_str(out, " / ");
+            buf_put_str(out, player_country(ctx->db, nbuf, e->player_id));
+            buf_put_str(out, " (");
             if (player->qualifier.rating > 0.0f) {
                 // if it's stored, use that
-                fprintf(file, "%1.3f", player->qualifier.rating);
+                buf_put_fixed(out, player->qualifier.rating, 3);
             } else {
                 // else, use the event rating
-                fprintf(file, "%1.3f", e->rating);
+                buf_put_fixed(out, e->rating, 3);
             }
             if (player->event_count > 1) {
-                fprintf(file, " / %1.3f", player->rating);
+                buf_put_str(out, " / ");
+                buf_put_fixed(out, player->rating, 3);
             }
             // TODO: qualifier hack
 //            fprintf(file, ") %s \n", g_dq_display_text[e->dq]);
-            fprintf(file, ") \n");
+            buf_put_str(out, ") \n");
         } else { // private
-            fprintf(file, "%s / %s %s (%1.3f) \n",
-                entry_psn(e), player_name(e->player_id),
-                time_display(&e->time), e->rating);
+            buf_put_str(out, entry_psn(e));
+            buf_put_str(out, " / ");
+            buf_put_str(out, player_name(ctx->db, nbuf, e->player_id));
+            buf_put_char(out, ' ');
+            buf_put_time(out, &e->time);
+            buf_put_str(out, " (");
+            buf_put_fixed(out, e->rating, 3);
+            buf_put_str(out, ") \n");
         }
         return; // done with entry, so exit
     } else if (!dq_ok(e->dq)) {
-        fprintf(file, "%sQ---%s---%s ", g_color_tag[entry_div(e)],
-                g_dq_display_text[e->dq], entry_psn(e));
+        buf_put_str(out, g_color_tag[entry_div(e)]);
+        buf_put_str(out, "Q---");
+        buf_put_str(out, g_dq_display_text[e->dq]);
+        buf_put_str(out, "---");
+        buf_put_str(out, entry_psn(e));
+        buf_put_char(out, ' ');
         if (e->dq >= DQ_NO_REPLAY) {
-            fprintf(file, "%s ", g_dq_flag_url[FLAG_BLACK]);
-        } else {
-            fprintf(file, "%s ", g_dq_flag_url[FLAG_RED]);
-        }
-    } else if (place < 10) {
-        if (opt == SHOW_RATING_DELTA) {
-            int usec;
-            ttime_t time;
-            usec = time_handicap(e);
-            time_from_usec(&time, usec);
-            fprintf(file, "%s%u---%s---(%s)-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&time), rating_delta_display(e),
-                    entry_rookie(e), entry_psn(e));
-//            fprintf(file, "%s%u--(%s)---%s ", g_color_tag[entry_div(e)],
-//                    place, rating_delta_display(e), entry_psn(e));
-        } else if (event_season_active() && opt == SHOW_FLAGS) {
-            fprintf(file, "%s%u---%s---%u-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&e->time), e->points,
-                    entry_rookie(e), entry_psn(e));
+            buf_put_str(out, g_dq_flag_url[FLAG_BLACK]);
         } else {
-            fprintf(file, "%s%u---%s-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&e->time), 
-                    entry_rookie(e), entry_psn(e));
+            buf_put_str(out, g_dq_flag_url[FLAG_RED]);
         }
+        buf_put_char(out, ' ');
     } else {
+        // places 1-9 get an extra dash, to line up with 10 and up
+        buf_put_str(out, g_color_tag[entry_div(e)]);
+        buf_put_int(out, (unsigned)place);
+        buf_put_str(out, (place < 10 ? "---" : "--"));
         if (opt == SHOW_RATING_DELTA) {
-            int usec;
-            ttime_t time;
-            usec = time_handicap(e);
-            time_from_usec(&time, usec);
-            fprintf(file, "%s%u--%s---(%s)-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&time), rating_delta_display(e),
-                    entry_rookie(e), entry_psn(e));
-//            fprintf(file, "%s%u--(%s)---%s ", g_color_tag[entry_div(e)],
-//                    place, rating_delta_display(e), entry_psn(e));
-        } else if (event_season_active() && opt == SHOW_FLAGS) {
-            fprintf(file, "%s%u--%s---%u-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&e->time), e->points, entry_rookie(e), entry_psn(e));
+            time_from_usec(&time, time_handicap(ctx, e));
+            buf_put_time(out, &time);
+            buf_put_str(out, "---(");
+            buf_put_str(out, rating_delta_display(rbuf, e));
+            buf_put_str(out, ")");
+        } else if (event_season_active(ctx) && opt == SHOW_FLAGS) {
+            buf_put_time(out, &e->time);
+            buf_put_str(out, "---");
+            buf_put_int(out, (unsigned)e->points);
         } else {
-            fprintf(file, "%s%u--%s-%c-%s ", g_color_tag[entry_div(e)],
-                    place, time_display(&e->time), entry_rookie(e), entry_psn(e));
+            buf_put_time(out, &e->time);
         }
+        buf_put_char(out, '-');
+        buf_put_char(out, entry_rookie(e));
+        buf_put_char(out, '-');
+        buf_put_str(out, entry_psn(e));
+        buf_put_char(out, ' ');
     }
     if (opt == SHOW_FLAGS) {
-        rating_string(rating, e);
-        fprintf(file, "%s %s %s", rating, entry_replay_string(e), entry_dq_flag(e));
+        rating_string(ctx, rating, e);
+        buf_put_str(out, rating);
+        buf_put_char(out, ' ');
+        buf_put_str(out, entry_replay_string(ctx, e));
+        buf_put_char(out, ' ');
+        buf_put_str(out, entry_dq_flag(e));
     } else if (opt == SHOW_RATINGS) {
-        fprintf(file, "r=%.3f ", e->rating);
-        fprintf(file, "(d%d/%.3f) ", e->prov_div, e->hcp_delta);
+        buf_put_str(out, "r=");
+        buf_put_fixed(out, e->rating, 3);
+        buf_put_str(out, " (d");
+        buf_put_int(out, e->prov_div);
+        buf_put_char(out, '/');
+        buf_put_fixed(out, e->hcp_delta, 3);
+        buf_put_str(out, ") ");
     } else if (opt == SHOW_ALL_TIMES) {
         for (i = 0; i < MAX_SPLITS; i++) {
             if (time_to_usec(&e->split[i])) {
-                fprintf(file, "%s ", time_display(&e->split[i]));
+                buf_put_time(out, &e->split[i]);
+                buf_put_char(out, ' ');
             }
         }
     }
-    fprintf(file, "[/COLOR]\n");
+    buf_put_str(out, "[/COLOR]\n");
+}
+
+// the par and trophy times heading each division of the overall results
+void
+render_div_times(context_t *ctx, buf_t *out, int div)
+{
+    buf_put_str(out, "\n>> Division ");
+    buf_put_int(out, div);
+    buf_put_str(out, ": Par: ");
+    buf_put_time(out, &ctx->div_stat[div].par);
+    buf_put_str(out, " Gold: ");
+    buf_put_time(out, &ctx->div_stat[div].gold);
+    buf_put_str(out, " Silver: ");
+    buf_put_time(out, &ctx->div_stat[div].silver);
+    buf_put_str(out, " Bronze: ");
+    buf_put_time(out, &ctx->div_stat[div].bronze);
+    buf_put_str(out, "\n");
 }
 
 void
-dump_qualifier_subdiv_heading(FILE *file, int div, int subdiv)
+render_qualifier_subdiv_heading(buf_t *out, int div, int subdiv)
 {
     switch(subdiv) {
     case SUB_DIV_GOLD:
-        fprintf(file, "\n[color=Gold][B][size=4]Division %d Gold (%d.000 - %d.333):[/size][/B][/COLOR]\n\n", div, (div==1?0:div), div);
+        buf_printf(out, "\n[color=Gold][B][size=4]Division %d Gold (%d.000 - %d.333):[/size][/B][/COLOR]\n\n", div, (div==1?0:div), div);
         break;
     case SUB_DIV_SILVER:
-        fprintf(file, "\n[color=Silver][B][size=4]Division %d Silver (%d.334 - %d.666):[/size][/B][/COLOR]\n\n", div, div, div);
+        buf_printf(out, "\n[color=Silver][B][size=4]Division %d Silver (%d.334 - %d.666):[/size][/B][/COLOR]\n\n", div, div, div);
         break;
     case SUB_DIV_BRONZE:
-        fprintf(file, "\n[color=#B88A00][B][size=4]Division %d Bronze (%d.667 - %d.999):[/size][/B][/COLOR]\n\n", div, div, div);
+        buf_printf(out, "\n[color=#B88A00][B][size=4]Division %d Bronze (%d.667 - %d.999):[/size][/B][/COLOR]\n\n", div, div, div);
         break;
     }
 }
 
+// render_qualifier
+// the registry into out; the new qualifier results into echo, if not 0
 void
-dump_qualifier(FILE *file)
+render_qualifier(context_t *ctx, buf_t *out, buf_t *echo)
 {
     entry_t *cur, *prior;
     player_t *player;
     entry_iter_t iter;
     int i, div, subdiv, title_printed, subdiv_printed;
+    char nbuf[MAX_NAME_LEN];
 
     // heading
-    fprintf(file, "[center][IMG]https://www.gtplanet.net/forum/attachments/wrs-tt-main-banner-png.693509/[/IMG]\n");
-    fprintf(file, "\n[B][size=6]:: Official GTSport WRS Registry ::[/size][/b][/center]\n\n");
+    buf_put_str(out, "[center][IMG]https://www.gtplanet.net/forum/attachments/wrs-tt-main-banner-png.693509/[/IMG]\n");
+    buf_put_str(out, "\n[B][size=6]:: Official GTSport WRS Registry ::[/size][/b][/center]\n\n");
             
 #if 0
     for (div = 1; div <= DIV_COUNT; div++) {
         title_printed = FALSE;
         for (subdiv = SUB_DIV_GOLD; subdiv <= SUB_DIV_BRONZE; subdiv++) {
             subdiv_printed = FALSE;
-            cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK);
+            cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK);
             if (!cur) {
                 continue;
             }
             prior = 0;
             for (i = 1; cur; i++, cur = entry_get_next(&iter)) {
-                if (player_subdiv(cur->player_id) != subdiv ||
-                        player_is_rookie(cur->player_id)) {
+                if (player_subdiv(ctx->db, cur->player_id) != subdiv ||
+                        player_is_rookie(ctx->db, cur->player_id)) {
                     continue;
                 }
                 if (title_printed == FALSE) {
                     title_printed = TRUE;
-                    fprintf(file, "\n\n[CENTER][B][size=6]:: Division %d ::[/size][/b][/CENTER]\n\n", div);
+                    buf_printf(out, "\n\n[CENTER][B][size=6]:: Division %d ::[/size][/b][/CENTER]\n\n", div);
                 }
                 if (subdiv_printed == FALSE) {
                     subdiv_printed = TRUE;
-                    dump_qualifier_subdiv_heading(file, div, subdiv);
+                    render_qualifier_subdiv_heading(out, div, subdiv);
                 }
-                dump_entry(file, cur, SHOW_NONE, cur->place);
+                render_entry(ctx, out, cur, SHOW_NONE, cur->place);
                 prior = cur;
             }
         }
     }
 #else
+    if (player_sort(ctx) != SUCCESS) {
+        return;
+    }
     for (div = 1; div <= DIV_COUNT; div++) {
         title_printed = FALSE;
         for (subdiv = SUB_DIV_GOLD; subdiv <= SUB_DIV_BRONZE; subdiv++) {
-            player_link_t *plink = player_sort(div, subdiv);
+            player_link_t *plink = player_bucket(ctx, div, subdiv);
             subdiv_printed = FALSE;
             for (; plink->player != 0; plink++) {
                 player = plink->player;
                 if (title_printed == FALSE) {
                     title_printed = TRUE;
-                    fprintf(file, "\n\n[CENTER][B][size=6]:: Division %d ::[/size][/b][/CENTER]\n\n", div);
+                    buf_printf(out, "\n\n[CENTER][B][size=6]:: Division %d ::[/size][/b][/CENTER]\n\n", div);
                 }
                 if (subdiv_printed == FALSE) {
                     subdiv_printed = TRUE;
-                    dump_qualifier_subdiv_heading(file, div, subdiv);
+                    render_qualifier_subdiv_heading(out, div, subdiv);
                 }
-                fprintf(file, "%s / %s / %s (%1.3f",
-                    player->psn, player->name, player_country(player->id), player->rating);
+                buf_put_str(out, player->psn);
+                buf_put_str(out, " / ");
+                buf_put_str(out, player->name);
+                buf_put_str(out, " / ");
+                buf_put_str(out, player_country(ctx->db, nbuf, player->id));
+                buf_put_str(out, " (");
+                buf_put_fixed(out, player->rating, 3);
                 if (player->qualifier.rating > 0.0f) {
                     // print qualifier rating if we have one
-                    fprintf(file, " / %1.3f", player->qualifier.rating);
+                    buf_put_str(out, " / ");
+                    buf_put_fixed(out, player->qualifier.rating, 3);
                 }
-                fprintf(file, ") \n");
+                buf_put_str(out, ") \n");
             }
         }
     }
 #endif
     // rookies
     title_printed = FALSE;
-    for (i = 1; i < player_cnt; i++) {
-        player = &player_db[i];
-        if (!player || !player_is_rookie(i) || player->verified_count == 0) {
+    for (i = 1; i < ctx->db->player_cnt; i++) {
+        player = player_get(ctx->db, i);
+        if (!player || !player_is_rookie(ctx->db, i) || player->verified_count == 0) {
             continue;
         }
         if (title_printed == FALSE) {
             title_printed = TRUE;
-            fprintf(file, "\n\n[CENTER][B][size=6]:: Rookies ::[/size][/b][/CENTER]\n\n", div);
+            buf_put_str(out, "\n\n[CENTER][B][size=6]:: Rookies ::[/size][/b][/CENTER]\n\n");
         }
 //        fprintf(file, "%s / %s (%1.3f) \n", player->psn, player->name, player->rating);
-        fprintf(file, "%s / %s / %s (%1.3f handicap) %d events \n",
-                player->psn, player->name, player->country, player->rating, player->verified_count);
+        buf_put_str(out, player->psn);
+        buf_put_str(out, " / ");
+        buf_put_str(out, player->name);
+        buf_put_str(out, " / ");
+        buf_put_str(out, player->country);
+        buf_put_str(out, " (");
+        buf_put_fixed(out, player->rating, 3);
+        buf_put_str(out, " handicap) ");
+        buf_put_int(out, (int)player->verified_count);
+        buf_put_str(out, " events \n");
+    }
+
+    // the new qualifier results are only echoed
+    if (!echo) {
+        return;
     }
-
-    fprintf(stdout, "\nNew Qualifier Results:\n");
+    buf_put_str(echo, "\nNew Qualifier Results:\n");
     for (div = 1; div <= DIV_COUNT; div++) {
         title_printed = FALSE;
         for (subdiv = SUB_DIV_GOLD; subdiv <= SUB_DIV_BRONZE; subdiv++) {
             subdiv_printed = FALSE;
-            cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK);
+            cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK);
             if (!cur) {
                 continue;
             }
             prior = 0;
             for (i = 1; cur; i++, cur = entry_get_next(&iter)) {
-                if (player_subdiv(cur->player_id) != subdiv) {
+                if (player_subdiv(ctx->db, cur->player_id) != subdiv) {
                     continue;
                 }
-                player = player_get(cur->player_id);
+                player = player_get(ctx->db, cur->player_id);
                 if (player->qualifier.status == STATUS_FINAL) {
                     // already accounted for
                     continue;
                 }
                 if (title_printed == FALSE) {
                     title_printed = TRUE;
-                    fprintf(stdout, "\n[B][size=4]:: Division %d ::[/size][/b]\n\n", div);
+                    buf_printf(echo, "\n[B][size=4]:: Division %d ::[/size][/b]\n\n", div);
                 }
                 if (subdiv_printed == FALSE) {
                     subdiv_printed = TRUE;
-                    dump_qualifier_subdiv_heading(stdout, div, subdiv);
+                    render_qualifier_subdiv_heading(echo, div, subdiv);
                 }
-                dump_entry(stdout, cur, SHOW_NONE, cur->place);
+                render_entry(ctx, echo, cur, SHOW_NONE, cur->place);
                 prior = cur;
             }
         }
     }
 
-    fprintf(stdout, "\nOverall Results:\n\n");
+    buf_put_str(echo, "\nOverall Results:\n\n");
     div = 1;
-    for (i = 1, cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); cur; i++, cur = entry_get_next(&iter)) {
-        if (time_to_usec(&cur->time) >= time_to_usec(&div_stat[div].par)) {
-            fprintf(stdout, "\n>> Division %d: ", div);
-            fprintf(stdout, "Par: %s ", time_display(&div_stat[div].par));
-            fprintf(stdout, "Gold: %s ", time_display(&div_stat[div].gold));
-            fprintf(stdout, "Silver: %s ", time_display(&div_stat[div].silver));
-            fprintf(stdout, "Bronze: %s\n", time_display(&div_stat[div].bronze));
+    for (i = 1, cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK); cur; i++, cur = entry_get_next(&iter)) {
+        if (time_to_usec(&cur->time) >= time_to_usec(&ctx->div_stat[div].par)) {
+            render_div_times(ctx, echo, div);
             div++;
         } 
-        //dump_entry(stdout, cur, SHOW_ALL_TIMES, cur->overall_place);
-        dump_entry(stdout, cur, SHOW_RATINGS, cur->overall_place);
+        //render_entry(ctx, echo, cur, SHOW_ALL_TIMES, cur->overall_place);
+        render_entry(ctx, echo, cur, SHOW_RATINGS, cur->overall_place);
+    }
+    buf_put_str(echo, "\nDisqualifications:\n");
+
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        render_entry(ctx, echo, cur, SHOW_NONE, cur->overall_place);
+    }
+}
+
+void
+dump_qualifier(context_t *ctx, FILE *file)
+{
+    buf_t out = { 0 }, echo = { 0 };
+    trace_span_t span;
+    size_t len;
+
+    trace_begin(ctx->db->trace, &span, "dump_qualifier");
+    render_qualifier(ctx, &out, (ctx->echo ? &echo : 0));
+    len = out.len;
+    buf_flush(&out, file);
+    trace_end(ctx->db->trace, &span, len, ctx->entry_cnt);
+    if (ctx->echo) {
+        buf_flush(&echo, ctx->echo);
+    }
+    buf_free(&out);
+    buf_free(&echo);
+}
+
+/************************************************/
+// results export: the computed entries and division stats as records for
+// other programs, JSON Lines or CSV.  Every record starts with its kind and
+// the event; CSV rows share one set of columns, left empty where a kind has
+// no value, and JSON leaves those keys out.  Times are in ms.
+
+// csv columns, in record order
+char g_export_columns[] =
+    "record,season,week,div,"
+    "player_id,psn,time_ms,place,div_place,prov_div,rating,hcp_delta,points,dq,"
+    "count,par_ms,gold_ms,silver_ms,bronze_ms,mean_ms,std_dev\n";
+
+#define EXPORT_ENTRY_COLUMNS 10 // player_id to dq
+#define EXPORT_TIME_COLUMNS 4   // par_ms to bronze_ms
+
+export_format_e
+export_format(char *name)
+{
+    if (!strcasecmp(name, "jsonl") || !strcasecmp(name, "json")) {
+        return EXPORT_JSONL;
+    }
+    if (!strcasecmp(name, "csv")) {
+        return EXPORT_CSV;
+    }
+    return EXPORT_NONE;
+}
+
+// a string value, quoted and escaped as the format wants
+void
+export_put_str(buf_t *out, export_format_e format, const char *str)
+{
+    const char *p;
+
+    if (format == EXPORT_CSV) {
+        if (!strpbrk(str, ",\"\r\n")) {
+            buf_put_str(out, str);
+            return;
+        }
+        buf_put_char(out, '"');
+        for (p = str; *p; p++) {
+            if (*p == '"') {
+                buf_put_char(out, '"');
+            }
+            buf_put_char(out, *p);
+        }
+        buf_put_char(out, '"');
+        return;
+    }
+    buf_put_char(out, '"');
+    for (p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            buf_put_char(out, '\\');
+            buf_put_char(out, *p);
+        } else if ((unsigned char)*p < 0x20) {
+            buf_put_str(out, "\\u00");
+            buf_put_char(out, "0123456789abcdef"[(*p >> 4) & 0xf]);
+            buf_put_char(out, "0123456789abcdef"[*p & 0xf]);
+        } else {
+            buf_put_char(out, *p);
+        }
+    }
+    buf_put_char(out, '"');
+}
+
+// start the next field: the separator, and the key for JSON
+void
+export_key(buf_t *out, export_format_e format, const char *key)
+{
+    buf_put_char(out, ',');
+    if (format == EXPORT_JSONL) {
+        buf_put_char(out, '"');
+        buf_put_str(out, key);
+        buf_put_str(out, "\":");
+    }
+}
+
+// columns a record has no value for
+void
+export_skip(buf_t *out, export_format_e format, int count)
+{
+    if (format == EXPORT_CSV) {
+        while (count-- > 0) {
+            buf_put_char(out, ',');
+        }
+    }
+}
+
+// record kind, event and division: the columns every record has
+void
+export_begin(context_t *ctx, buf_t *out, export_format_e format, const char *record, int div)
+{
+    if (format == EXPORT_JSONL) {
+        buf_put_str(out, "{\"record\":");
+    }
+    export_put_str(out, format, record);
+    export_key(out, format, "season");
+    buf_put_int(out, ctx->event.season);
+    export_key(out, format, "week");
+    buf_put_int(out, ctx->event.week);
+    export_key(out, format, "div");
+    buf_put_int(out, div);
+}
+
+void
+export_end(buf_t *out, export_format_e format)
+{
+    buf_put_str(out, (format == EXPORT_JSONL ? "}\n" : "\n"));
+}
+
+void
+render_export_entry(context_t *ctx, buf_t *out, export_format_e format, entry_t *e)
+{
+    export_begin(ctx, out, format, "entry", entry_div(e));
+    export_key(out, format, "player_id");
+    buf_put_int(out, e->player_id);
+    export_key(out, format, "psn");
+    export_put_str(out, format, entry_psn(e));
+    export_key(out, format, "time_ms");
+    buf_put_int(out, time_to_usec(&e->time));
+    export_key(out, format, "place");
+    buf_put_int(out, e->overall_place);
+    export_key(out, format, "div_place");
+    buf_put_int(out, e->place);
+    export_key(out, format, "prov_div");
+    buf_put_int(out, e->prov_div);
+    export_key(out, format, "rating");
+    buf_put_fixed(out, e->rating, 6);
+    export_key(out, format, "hcp_delta");
+    buf_put_fixed(out, e->hcp_delta, 6);
+    export_key(out, format, "points");
+    buf_put_int(out, e->points);
+    export_key(out, format, "dq");
+    export_put_str(out, format, g_dq_text[e->dq]);
+    export_skip(out, format, EXPORT_TIME_COLUMNS + 3);
+    export_end(out, format);
+}
+
+// a division's thresholds, or with div 0 the overall stats, which have none
+void
+render_export_stat(context_t *ctx, buf_t *out, export_format_e format, stat_t *stat, int div)
+{
+    export_begin(ctx, out, format, (div ? "division" : "overall"), div);
+    export_skip(out, format, EXPORT_ENTRY_COLUMNS);
+    export_key(out, format, "count");
+    buf_put_int(out, stat->count);
+    if (div) {
+        export_key(out, format, "par_ms");
+        buf_put_int(out, time_to_usec(&stat->par));
+        export_key(out, format, "gold_ms");
+        buf_put_int(out, time_to_usec(&stat->gold));
+        export_key(out, format, "silver_ms");
+        buf_put_int(out, time_to_usec(&stat->silver));
+        export_key(out, format, "bronze_ms");
+        buf_put_int(out, time_to_usec(&stat->bronze));
+    } else {
+        export_skip(out, format, EXPORT_TIME_COLUMNS);
+    }
+    export_key(out, format, "mean_ms");
+    buf_put_int(out, time_to_usec(&stat->mean));
+    export_key(out, format, "std_dev");
+    buf_put_fixed(out, stat->std_dev, 6);
+    export_end(out, format);
+}
+
+// every entry in overall order, disqualified entries last, then the stats
+void
+render_export(context_t *ctx, buf_t *out, export_format_e format)
+{
+    entry_t *cur;
+    entry_iter_t iter;
+    int div;
+
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
+        render_export_entry(ctx, out, format, cur);
+    }
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        render_export_entry(ctx, out, format, cur);
+    }
+    if (ctx->ostat.count == 0) {
+        return;
+    }
+    render_export_stat(ctx, out, format, &ctx->ostat, 0);
+    for (div = 1; div <= DIV_COUNT; div++) {
+        if (ctx->div_stat[div].count) {
+            render_export_stat(ctx, out, format, &ctx->div_stat[div], div);
+        }
     }
-    fprintf(stdout, "\nDisqualifications:\n");
+}
 
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
-        dump_entry(stdout, cur, SHOW_NONE, cur->overall_place);
+// once per export file, before the first event
+void
+dump_export_header(FILE *file, export_format_e format)
+{
+    if (format == EXPORT_CSV) {
+        fputs(g_export_columns, file);
     }
 }
 
+// the records of one collated event
+void
+dump_export(context_t *ctx, FILE *file, export_format_e format)
+{
+    buf_t out = { 0 };
+    trace_span_t span;
+    size_t len;
+
+    trace_begin(ctx->db->trace, &span, "dump_export");
+    render_export(ctx, &out, format);
+    len = out.len;
+    buf_flush(&out, file);
+    trace_end(ctx->db->trace, &span, len, ctx->entry_cnt);
+    buf_free(&out);
+}
+
+// render_event
+// the forum post of the event results, into out
 void
-dump_event(FILE *file)
+render_event(context_t *ctx, buf_t *out)
 {
     entry_t *cur;
     entry_iter_t iter;
     int i, div;
 
     // heading
-    fprintf(file, "\n%sWeek %d (%s): %s", g_results_text_1, g_event.week,
-            g_event.status==STATUS_FINAL?"Official":"Provisional",
-            g_event.description);
-    fprintf(file, "%s%s", g_results_text_2a, g_event.img[0]);
-    fprintf(file, "%s%s", g_results_text_2b, g_event.img[1]);
-    fprintf(file, "%s%s", g_results_text_2c, g_event.car[0]?g_event.car:"xxx_CAR");
-    fprintf(file, "%s%s", g_results_text_3a, g_event.img[2]);
-    fprintf(file, "%s%s", g_results_text_3b, g_event.track[0]?g_event.track:"xxx_TRACK");
-    fprintf(file, "%s%s%s", g_results_text_4a, g_event.comment, g_results_text_4b);
-    fprintf(file, "[LIST][*]gtpwrs%03d, essentials, pineapple[/LIST]\n", g_event.week);
-    fprintf(file, "%s", g_results_text_4c);
+    buf_put_str(out, "\n");
+    buf_put_str(out, g_results_text_1);
+    buf_put_str(out, "Week ");
+    buf_put_int(out, ctx->event.week);
+    buf_put_str(out, (ctx->event.status==STATUS_FINAL ? " (Official): " : " (Provisional): "));
+    buf_put_str(out, ctx->event.description);
+    buf_put_str(out, g_results_text_2a);
+    buf_put_str(out, ctx->event.img[0]);
+    buf_put_str(out, g_results_text_2b);
+    buf_put_str(out, ctx->event.img[1]);
+    buf_put_str(out, g_results_text_2c);
+    buf_put_str(out, ctx->event.car[0]?ctx->event.car:"xxx_CAR");
+    buf_put_str(out, g_results_text_3a);
+    buf_put_str(out, ctx->event.img[2]);
+    buf_put_str(out, g_results_text_3b);
+    buf_put_str(out, ctx->event.track[0]?ctx->event.track:"xxx_TRACK");
+    buf_put_str(out, g_results_text_4a);
+    buf_put_str(out, ctx->event.comment);
+    buf_put_str(out, g_results_text_4b);
+    buf_printf(out, "[LIST][*]gtpwrs%03d, essentials, pineapple[/LIST]\n", ctx->event.week);
+    buf_put_str(out, g_results_text_4c);
 
     for (div = 1; div <= DIV_COUNT; div++) {
-        cur = entry_get_first(&iter, ov_head, div, ITER_DQ_OK);
+        cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK);
         if (!cur) {
             continue;
         }
-        fprintf(file, "\nDivision %d:\n\n", div);
+        buf_put_str(out, "\nDivision ");
+        buf_put_int(out, div);
+        buf_put_str(out, ":\n\n");
         for (i = 1; cur; i++, cur = entry_get_next(&iter)) {
-            dump_entry(file, cur, SHOW_FLAGS, cur->place);
+            render_entry(ctx, out, cur, SHOW_FLAGS, cur->place);
         }
-        for (cur = entry_get_first(&iter, ov_head, div, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
-            dump_entry(file, cur, SHOW_NONE, cur->place);
+        for (cur = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+            render_entry(ctx, out, cur, SHOW_NONE, cur->place);
         }
     }
 
-    fprintf(file, "\n[img]%s[/img]\n", g_event.img[3]);
-    fprintf(file, "\nOverall Results:\n\n");
+    buf_put_str(out, "\n[img]");
+    buf_put_str(out, ctx->event.img[3]);
+    buf_put_str(out, "[/img]\n");
+    buf_put_str(out, "\nOverall Results:\n\n");
     div = 1;
-    for (i = 1, cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_OK); cur; i++, cur = entry_get_next(&iter)) {
-        if (time_to_usec(&cur->time) >= time_to_usec(&div_stat[div].par)) {
-            fprintf(file, "\n>> Division %d: ", div);
-            fprintf(file, "Par: %s ", time_display(&div_stat[div].par));
-            fprintf(file, "Gold: %s ", time_display(&div_stat[div].gold));
-            fprintf(file, "Silver: %s ", time_display(&div_stat[div].silver));
-            fprintf(file, "Bronze: %s\n", time_display(&div_stat[div].bronze));
+    for (i = 1, cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_OK); cur; i++, cur = entry_get_next(&iter)) {
+        if (time_to_usec(&cur->time) >= time_to_usec(&ctx->div_stat[div].par)) {
+            render_div_times(ctx, out, div);
             div++;
         } 
-        //dump_entry(file, cur, SHOW_ALL_TIMES, cur->overall_place);
-        dump_entry(file, cur, SHOW_RATINGS, cur->overall_place);
+        //render_entry(ctx, out, cur, SHOW_ALL_TIMES, cur->overall_place);
+        render_entry(ctx, out, cur, SHOW_RATINGS, cur->overall_place);
     }
-    fprintf(file, "\n");
-    for (cur = entry_get_first(&iter, ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
-        dump_entry(file, cur, SHOW_NONE, cur->overall_place);
+    buf_put_str(out, "\n");
+    for (cur = entry_get_first(ctx, &iter, ctx->ov_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        render_entry(ctx, out, cur, SHOW_NONE, cur->overall_place);
     }
 
-    fprintf(file, "\n[img]%s[/img]\n", g_event.img[4]);
-    fprintf(file, "\nHandicapped Results:\n\n");
-    for (i = 1, cur = entry_get_first(&iter, rat_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
+    buf_put_str(out, "\n[img]");
+    buf_put_str(out, ctx->event.img[4]);
+    buf_put_str(out, "[/img]\n");
+    buf_put_str(out, "\nHandicapped Results:\n\n");
+    for (i = 1, cur = entry_get_first(ctx, &iter, ctx->rat_head, DIV_ALL, ITER_DQ_OK); cur; cur = entry_get_next(&iter)) {
         if (entry_rookie(cur) == '-') { // not rookie
-            dump_entry(file, cur, SHOW_RATING_DELTA, i++);
+            render_entry(ctx, out, cur, SHOW_RATING_DELTA, i++);
         }
     }
-    fprintf(file, "\n");
-    for (cur = entry_get_first(&iter, rat_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
-        dump_entry(file, cur, SHOW_NONE, cur->overall_place);
+    buf_put_str(out, "\n");
+    for (cur = entry_get_first(ctx, &iter, ctx->rat_head, DIV_ALL, ITER_DQ_BAD); cur; cur = entry_get_next(&iter)) {
+        render_entry(ctx, out, cur, SHOW_NONE, cur->overall_place);
     }
 
-    fprintf(file, "\n(Settings: Weight = %.3f Squeeze = %.3f Scoot = %.3f)\n\n",
-            g_event.weight, g_event.squeeze, g_event.scoot);
-    fprintf(file, "%s", g_results_text_5);
+    buf_put_str(out, "\n(Settings: Weight = ");
+    buf_put_fixed(out, ctx->event.weight, 3);
+    buf_put_str(out, " Squeeze = ");
+    buf_put_fixed(out, ctx->event.squeeze, 3);
+    buf_put_str(out, " Scoot = ");
+    buf_put_fixed(out, ctx->event.scoot, 3);
+    buf_put_str(out, ")\n\n");
+    buf_put_str(out, g_results_text_5);
+}
+
+void
+dump_event(context_t *ctx, FILE *file)
+{
+    buf_t out = { 0 };
+    trace_span_t span;
+    size_t len;
+
+    trace_begin(ctx->db->trace, &span, "dump_event");
+    render_event(ctx, &out);
+    len = out.len;
+    buf_flush(&out, file);
+    trace_end(ctx->db->trace, &span, len, ctx->entry_cnt);
+    buf_free(&out);
+}
+
+// a watch or struggle list line
+void
+render_watch_entry(buf_t *out, entry_t *e)
+{
+    buf_put_char(out, ' ');
+    buf_put_str(out, entry_psn(e));
+    buf_put_str(out, " D");
+    buf_put_int(out, entry_div(e));
+    buf_put_char(out, ' ');
+    buf_put_str(out, g_subdiv_text[entry_subdiv(e)]);
+    buf_put_str(out, " >>> D");
+    buf_put_int(out, e->prov_div);
+    buf_put_char(out, ' ');
+    buf_put_str(out, g_subdiv_text[(int)((e->rating-e->prov_div)*3)]);
+    buf_put_str(out, " (rating ");
+    buf_put_fixed(out, e->rating, 3);
+    buf_put_str(out, " hcp delta ");
+    buf_put_fixed(out, e->hcp_delta, 3);
+    buf_put_str(out, ")\n");
 }
 
+// render_stats
+// the event statistics into out; with detail, the hcp delta lines are
+// also copied into echo, if not 0
 void
-dump_stats(FILE *file, int detail)
+render_stats(context_t *ctx, buf_t *out, int detail, buf_t *echo)
 {
     int div, i;
     entry_t *e;
@@ -2905,116 +5674,170 @@ dump_stats(FILE *file, int detail)
     ttime_t delta;
 
     // info
-    fprintf(file, "\nWRS Stats for Week %d (%s):\n", g_event.week,
-            g_event.status==STATUS_FINAL?"Official":"Provisional");
-    if (g_event.description[0]) {
-        fprintf(file, "%s\n", g_event.description);
-    }
-    if (g_event.car[0]) {
-        fprintf(file, "Car: %s\n", g_event.car);
-    }
-    if (g_event.track[0]) {
-        fprintf(file, "Track: %s\n", g_event.track);
-    }
-    fprintf(file, "(Settings: Weight = %.3f Squeeze = %.3f Scoot = %.3f)\n",
-            g_event.weight, g_event.squeeze, g_event.scoot);
-
-    fprintf(file, "\nStatistics: ");
-    fprintf(file, "\n\nOverall Mean time: %s ", time_display(&ostat.mean));
+    buf_put_str(out, "\nWRS Stats for Week ");
+    buf_put_int(out, ctx->event.week);
+    buf_put_str(out, (ctx->event.status==STATUS_FINAL ? " (Official):\n" : " (Provisional):\n"));
+    if (ctx->event.description[0]) {
+        buf_put_str(out, ctx->event.description);
+        buf_put_str(out, "\n");
+    }
+    if (ctx->event.car[0]) {
+        buf_put_str(out, "Car: ");
+        buf_put_str(out, ctx->event.car);
+        buf_put_str(out, "\n");
+    }
+    if (ctx->event.track[0]) {
+        buf_put_str(out, "Track: ");
+        buf_put_str(out, ctx->event.track);
+        buf_put_str(out, "\n");
+    }
+    buf_put_str(out, "(Settings: Weight = ");
+    buf_put_fixed(out, ctx->event.weight, 3);
+    buf_put_str(out, " Squeeze = ");
+    buf_put_fixed(out, ctx->event.squeeze, 3);
+    buf_put_str(out, " Scoot = ");
+    buf_put_fixed(out, ctx->event.scoot, 3);
+    buf_put_str(out, ")\n");
+
+    buf_put_str(out, "\nStatistics: ");
+    buf_put_str(out, "\n\nOverall Mean time: ");
+    buf_put_time(out, &ctx->ostat.mean);
+    buf_put_char(out, ' ');
     if (detail) {
-        fprintf(file, "Dev/Min: %.3f ",
-            (ostat.mean.time > 0.0f) ? ostat.std_dev*60.0f/ostat.mean.time : 0.0f);
-    }
-    fprintf(file, "Deviation: %.3f \n", ostat.std_dev);
-    fprintf(file, "Quality Mean time: %s ", time_display(&ostat.q_mean));
+        buf_put_str(out, "Dev/Min: ");
+        buf_put_fixed(out, (ctx->ostat.mean.time > 0.0f) ? ctx->ostat.std_dev*60.0f/ctx->ostat.mean.time : 0.0f, 3);
+        buf_put_char(out, ' ');
+    }
+    buf_put_str(out, "Deviation: ");
+    buf_put_fixed(out, ctx->ostat.std_dev, 3);
+    buf_put_str(out, " \nQuality Mean time: ");
+    buf_put_time(out, &ctx->ostat.q_mean);
+    buf_put_char(out, ' ');
     if (detail) {
-        fprintf(file, "Dev/Min: %.3f ",
-            (ostat.q_mean.time > 0.0f) ? ostat.q_std_dev*60.0f/ostat.q_mean.time : 0.0f);
+        buf_put_str(out, "Dev/Min: ");
+        buf_put_fixed(out, (ctx->ostat.q_mean.time > 0.0f) ? ctx->ostat.q_std_dev*60.0f/ctx->ostat.q_mean.time : 0.0f, 3);
+        buf_put_char(out, ' ');
     }
-    fprintf(file, "Deviation: %.3f \n", ostat.q_std_dev);
+    buf_put_str(out, "Deviation: ");
+    buf_put_fixed(out, ctx->ostat.q_std_dev, 3);
+    buf_put_str(out, " \n");
     if (detail) {
-        fprintf(file, "    average hcp delta: %.3f\n", ostat.hcp_delta);
-        if (file != stdout) { // dump this to stdout if we aren't already
-            printf("Overall average hcp delta: %.3f\n", ostat.hcp_delta);
+        buf_put_str(out, "    average hcp delta: ");
+        buf_put_fixed(out, ctx->ostat.hcp_delta, 3);
+        buf_put_str(out, "\n");
+        if (echo) {
+            buf_put_str(echo, "Overall average hcp delta: ");
+            buf_put_fixed(echo, ctx->ostat.hcp_delta, 3);
+            buf_put_str(echo, "\n");
         }
     }
     for (div = 1; div <= DIV_IN_USE; div++) {
-        stat = &div_stat[div];
+        stat = &ctx->div_stat[div];
 
         if (stat->mean.time <= 0.0f) {
             continue;
         }
         if (!detail) {
-            fprintf(file, "%s >>> Division %d: ", g_color_tag[div], div);
+            buf_put_str(out, g_color_tag[div]);
+            buf_put_str(out, " >>> Division ");
         } else {
-            fprintf(file, "D%d: ", div);
+            buf_put_str(out, "D");
         }
-        fprintf(file, "Mean: %s ", time_display(&stat->mean));
-        fprintf(file, "Dev: %.3f ", stat->std_dev);
+        buf_put_int(out, div);
+        buf_put_str(out, ": Mean: ");
+        buf_put_time(out, &stat->mean);
+        buf_put_str(out, " Dev: ");
+        buf_put_fixed(out, stat->std_dev, 3);
+        buf_put_char(out, ' ');
         if (detail) {
-            fprintf(file, "Dev/Min: %.3f ", 
-                (stat->mean.time > 0.0f) ? stat->std_dev*60.0f/stat->mean.time : 0.0f);
-            fprintf(file, "Par: %s \n", time_display(&stat->par));
-            fprintf(file, "    q_mean = %s ", time_display(&stat->q_mean));
-            fprintf(file, "q_dev = %.3f, q_dev/min = %.3f\n", stat->q_std_dev,
-                (stat->q_mean.time > 0.0f) ? stat->q_std_dev*60.0f/stat->q_mean.time : 0.0f);
-            fprintf(file, "    -(%d %d %d)+ average hcp delta: %.3f",
-                stat->perf[0], stat->perf[1], stat->perf[2], stat->hcp_delta);
-            if (file != stdout) { // dump this to stdout if we aren't already
-                printf("D%d: -(%d %d %d)+ average hcp delta: %.3f\n", div,
-                    stat->perf[0], stat->perf[1], stat->perf[2], stat->hcp_delta);
+            buf_put_str(out, "Dev/Min: ");
+            buf_put_fixed(out, (stat->mean.time > 0.0f) ? stat->std_dev*60.0f/stat->mean.time : 0.0f, 3);
+            buf_put_str(out, " Par: ");
+            buf_put_time(out, &stat->par);
+            buf_put_str(out, " \n    q_mean = ");
+            buf_put_time(out, &stat->q_mean);
+            buf_put_str(out, " q_dev = ");
+            buf_put_fixed(out, stat->q_std_dev, 3);
+            buf_put_str(out, ", q_dev/min = ");
+            buf_put_fixed(out, (stat->q_mean.time > 0.0f) ? stat->q_std_dev*60.0f/stat->q_mean.time : 0.0f, 3);
+            buf_printf(out, "\n    -(%d %d %d)+ average hcp delta: ", stat->perf[0], stat->perf[1], stat->perf[2]);
+            buf_put_fixed(out, stat->hcp_delta, 3);
+            if (echo) {
+                buf_printf(echo, "D%d: -(%d %d %d)+ average hcp delta: ", div,
+                    stat->perf[0], stat->perf[1], stat->perf[2]);
+                buf_put_fixed(echo, stat->hcp_delta, 3);
+                buf_put_str(echo, "\n");
             }
         } else {
-            fprintf(file, "[/color]");
+            buf_put_str(out, "[/color]");
         }
-        fprintf(file, "\n");
+        buf_put_str(out, "\n");
     }
-    if (detail && g_event.week != EVENT_QUALIFIER) {
-        fprintf(file, "\nWatch List:\n");
+    if (detail && ctx->event.week != EVENT_QUALIFIER) {
+        buf_put_str(out, "\nWatch List:\n");
         for (div = 1; div <= DIV_COUNT; div++) {
-            for (e = entry_get_first(&iter, ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
+            for (e = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
                 for (i = 0; i < (int)-(e->hcp_delta*3.0f); i++) {
-                    fprintf(file, "*");
+                    buf_put_char(out, '*');
                 }
                 if (entry_watch(e)) {
-                    fprintf(file, " %s D%d %s >>> D%d %s (rating %.3f hcp delta %.3f)\n",
-                            entry_psn(e),
-                            entry_div(e), g_subdiv_text[entry_subdiv(e)],
-                            e->prov_div, g_subdiv_text[(int)((e->rating-e->prov_div)*3)],
-                            e->rating, e->hcp_delta);
+                    render_watch_entry(out, e);
                 }
             }
         }
-        fprintf(file, "\nStruggle List:\n");
+        buf_put_str(out, "\nStruggle List:\n");
         for (div = 1; div <= DIV_COUNT; div++) {
-            for (e = entry_get_first(&iter, ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
+            for (e = entry_get_first(ctx, &iter, ctx->ov_head, div, ITER_DQ_OK); e; e = entry_get_next(&iter)) {
                 if (entry_struggle(e)) {
-                    fprintf(file, " %s D%d %s >>> D%d %s (rating %.3f hcp delta %.3f)\n",
-                            entry_psn(e),
-                            entry_div(e), g_subdiv_text[entry_subdiv(e)],
-                            e->prov_div, g_subdiv_text[(int)((e->rating-e->prov_div)*3)],
-                            e->rating, e->hcp_delta);
-
+                    render_watch_entry(out, e);
                 }
             }
         }
     }
     if (detail) {
-        fprintf(file, "\nDivision thresholds:\n");
+        buf_put_str(out, "\nDivision thresholds:\n");
         for (div = 0; div <= DIV_IN_USE; div++) {
-            fprintf(file, "D%d Par: (%s) ", div, time_display(&div_stat[div].par));
-            fprintf(file, "G: (%s) ", time_display(&div_stat[div].gold));
-            fprintf(file, "S: (%s) ", time_display(&div_stat[div].silver));
-            fprintf(file, "B: (%s) ", time_display(&div_stat[div].bronze));
-            time_subtract(&delta, &div_stat[div].bronze, &div_stat[div].par);
-            fprintf(file, "range: (%.3f)\n", delta.time);
+            buf_put_str(out, "D");
+            buf_put_int(out, div);
+            buf_put_str(out, " Par: (");
+            buf_put_time(out, &ctx->div_stat[div].par);
+            buf_put_str(out, ") G: (");
+            buf_put_time(out, &ctx->div_stat[div].gold);
+            buf_put_str(out, ") S: (");
+            buf_put_time(out, &ctx->div_stat[div].silver);
+            buf_put_str(out, ") B: (");
+            buf_put_time(out, &ctx->div_stat[div].bronze);
+            time_subtract(&delta, &ctx->div_stat[div].bronze, &ctx->div_stat[div].par);
+            buf_put_str(out, ") range: (");
+            buf_put_fixed(out, delta.time, 3);
+            buf_put_str(out, ")\n");
         }
     }
 }
 
+void
+dump_stats(context_t *ctx, FILE *file, int detail)
+{
+    buf_t out = { 0 }, echo = { 0 };
+    int echo_copy = (ctx->echo && file != ctx->echo); // echo this if we aren't already
+    trace_span_t span;
+    size_t len;
+
+    trace_begin(ctx->db->trace, &span, "dump_stats");
+    render_stats(ctx, &out, detail, (echo_copy ? &echo : 0));
+    len = out.len;
+    buf_flush(&out, file);
+    trace_end(ctx->db->trace, &span, len, ctx->entry_cnt);
+    if (echo_copy) {
+        buf_flush(&echo, ctx->echo);
+    }
+    buf_free(&out);
+    buf_free(&echo);
+}
+
 /************************************************/
 void
-dump_promotion_report(FILE *file, int detail)
+dump_promotion_report(context_t *ctx, FILE *file, int detail)
 {
     player_t *player;
     player_iter_t iter;
@@ -3022,13 +5845,15 @@ dump_promotion_report(FILE *file, int detail)
     double delta;
     int update_db = FALSE;
     int double_promotion = FALSE;
+    trace_span_t span;
 
-    if (g_event.status == STATUS_FINAL) {
+    if (ctx->event.status == STATUS_FINAL) {
         update_db = TRUE;
     }
 
+    trace_begin(ctx->db->trace, &span, "dump_promotion_report");
     fprintf(file, "-------------- promotions -----------------\n");
-    for (player = player_get_first(&iter); player; player = player_get_next(&iter)) {
+    for (player = player_get_first(ctx->db, &iter); player; player = player_get_next(&iter)) {
         delta = (player->div*3 + player->sub_div + 1) - (player->rating*3);
         if (player->verified_count < MIN_PROMOTION_EVENT_COUNT) {
             continue;
@@ -3050,6 +5875,8 @@ dump_promotion_report(FILE *file, int detail)
             if (update_db == TRUE) {
                 player->div = p_div;
                 player->sub_div = (int)(3*(player->rating-p_div));
+                player->dirty = TRUE;
+                div_index_invalidate(ctx);
             }
         }
     }
@@ -3057,8 +5884,8 @@ dump_promotion_report(FILE *file, int detail)
         fprintf(file, "9.999 * Denotes double promotion\n");
     }
     fprintf(file, "----------- rookie placement --------------\n");
-    for (player = player_get_first(&iter); player; player = player_get_next(&iter)) {
-        if ((player->div == 0) && (player_is_rookie(player->id)==FALSE)) {
+    for (player = player_get_first(ctx->db, &iter); player; player = player_get_next(&iter)) {
+        if ((player->div == 0) && (player_is_rookie(ctx->db, player->id)==FALSE)) {
             p_div = (int)player->rating;
             fprintf(file, "9%.3f %s (@%s) -> D%d %s (%.5f)\n",
                     player->rating, player->psn, player->name,
@@ -3067,10 +5894,13 @@ dump_promotion_report(FILE *file, int detail)
             if (update_db == TRUE) {
                 player->div = p_div;
                 player->sub_div = (int)(3*(player->rating-p_div));
+                player->dirty = TRUE;
+                div_index_invalidate(ctx);
             }
         }
     }
     fprintf(file, "---------------------------------\n");
+    trace_end(ctx->db->trace, &span, 0, ctx->db->player_cnt);
 }
 
 /************************************************/
@@ -3083,6 +5913,7 @@ player_fix_total_weight(player_t *p)
     double wt=0, rating=0;
 
     if (p && p->valid) {
+        p->dirty = TRUE;
         p->qualifier.weight = 2.0f;
         wt = p->qualifier.weight;
         rating = p->qualifier.rating * p->qualifier.weight;
@@ -3106,125 +5937,17 @@ player_fix_total_weight(player_t *p)
     }
 }
 
+// echo: where to list the players fixed, 0 for nowhere
 void
-fix_all_weight()
+fix_all_weight(player_db_t *db, FILE *echo)
 {
     player_t *p;
     player_iter_t iter;
 
-    for (p = player_get_first(&iter); p; p = player_get_next(&iter)) {
+    for (p = player_get_first(db, &iter); p; p = player_get_next(&iter)) {
         player_fix_total_weight(p);
-        fprintf(stdout, "update player %s, wt = %.3f\n", p->psn, p->total_weight);
-    }
-}
-
-/************************************************/
-/* main/etc */
-
-void
-usage()
-{
-    fprintf(stderr, "wrsort usage:\n");
-    fprintf(stderr, "wrsort <eventfile> [dbfile]\n");
-}
-
-int
-main(int argc, char **argv)
-{
-    char eventfilename[MAX_STR_LEN];
-    char dbfilename[MAX_STR_LEN];
-    FILE *eventfile, *dbfile, *outfile;
-
-    init_db();
-    if (argc < 2) {
-        usage();
-        return -1;
-    }
-    strcpy(eventfilename, argv[1]);
-    if (argc == 3) {
-        strcpy(dbfilename, argv[2]);
-    } else {
-        strcpy(dbfilename, DEFAULT_DB_NAME);
-    }
-    fprintf(stderr, "------wrsort------\n");
-    fprintf(stderr, "input file: %s\n", eventfilename);
-
-    eventfile = fopen(eventfilename, "r");
-    if (!eventfile) {
-        fprintf(stderr, "wrsort error: file '%s' not found\n", eventfilename);
-        return -1;
-    }
-    dbfile = fopen(dbfilename, "r"); // open for reading
-
-    if (dbfile) {
-        fprintf(stderr, "------db read------\n");
-        fprintf(stderr, "db file: %s\n", dbfilename);
-        db_read(dbfile);
-        fclose(dbfile);
-    }
-    fprintf(stderr, "------parse------\n");
-    scan_event(eventfile);
-    fclose(eventfile);
-
-    outfile = stdout;
-    if (g_event.outfile[0]) {
-        outfile = fopen(g_event.outfile, "w"); // overwrite outfile
-        if (!outfile) {
-            fprintf(stderr, "Failed to open outfile '%s', dumping to stdout\n", g_event.outfile);
-            outfile = stdout;
-        }
-    }
-    if (g_run_mode == RUN_MODE_REPORT) {
-        dump_promotion_report(outfile, FALSE);
-        if (g_event.status != STATUS_FINAL) {
-            fprintf(stderr, "-------done-------\n");
-            return 0;
-        }
-    } else if (g_run_mode == RUN_MODE_DB_FIX) {
-        fix_all_weight(); 
-    } else { 
-        fprintf(stderr, "------stats------\n");
-        collate_stats();
-
-        fprintf(stderr, "-------results--------\n");
-        dump_stats(stdout, FALSE);
-        fprintf(stdout, "\n-----------------------------------\n");
-        if (g_event.week == EVENT_QUALIFIER) {
-            dump_qualifier(outfile);
-        } else {
-            dump_event(outfile);
-        }
-
-        if (strcmp(g_event.outfile, g_event.statfile)) {
-            if (outfile != stdout) {
-                fclose(outfile);
-            }
-            outfile = fopen(g_event.statfile, "w"); // overwrite statfile
-            if (!outfile) {
-                fprintf(stderr, "Failed to open statfile '%s', dumping to stdout\n", g_event.statfile);
-                outfile = stdout;
-            }
+        if (echo) {
+            fprintf(echo, "update player %s, wt = %.3f\n", p->psn, p->total_weight);
         }
-
-        fprintf(stderr, "-------stats-------\n");
-        dump_stats(outfile, TRUE);
-    }
-    if (outfile != stdout) {
-        fclose(outfile);
-    }
-
-    dbfile = fopen(dbfilename, "w"); // overwrite database
-    if (dbfile) {
-        fprintf(stderr, "------db update------\n");
-        fprintf(stderr, "db file: %s\n", dbfilename);
-        db_update(); // update database
-        db_write(dbfile);
-        fclose(dbfile);
-    } else {
-        fprintf(stderr, "Failed to open dbfile '%s'\n", dbfilename);
     }
-
-    fprintf(stderr, "-------done-------\n");
-    return 0;
 }
-
@@ -0,0 +1,651 @@
+/*
+ * Filename: wrsort.h
+ *
+ * Purpose: GTPlanet WRS results sorter, internal types and calls
+ *
+ * Shared by the library (wrsort.c, capper.c) and the wrsort command line
+ * (wrmain.c).  Programs using the library include capper.h instead.
+ */
+#ifndef WRSORT_H
+#define WRSORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+
+/************************************************/
+/* defines */
+
+#define MAX_LINE_LEN 512
+#define MAX_STR_LEN 128
+#define MAX_NAME_LEN 32
+#define NUM_MAX_LEN 32 // num_format_*() output, with its null
+#define MAX_PLAYERS (1 << 24) // sanity limit on player ids
+#define POOL_CHUNK_SHIFT 10 // 1024 elements per pool chunk
+#define POOL_CHUNK_SIZE (1 << POOL_CHUNK_SHIFT)
+#define RACE_HISTORY 20 // count of "active" races
+#define MAX_SPLITS  5
+#define MAX_IMAGES  7
+#define MAX_POINTS_PLACES  10 // maximum number of places earning points
+#define MAX_RACER_POINTS   20 // maximum number of racers in the points table
+#define MIN_POINTS 0 // minimum points awarded for a valid finish
+#define MAX_SEASON_LENGTH 15
+
+#define DIV_IN_USE  4 // maximum allowable division setting
+#define DIV_COUNT   8 // number of division ranking calculated
+#define DIV_ALL     0 // for iterator
+#define ROOKIE_TIME 3 // events needed to lose rookie status
+
+#define TRUE 1
+#define FALSE 0
+
+#define SUCCESS 1
+#define FAILURE -1
+
+#define BASE_DIV_PER_MIN 0.35f
+#define DEFAULT_DIVISION_STEPPING 0.875f
+#define DEFAULT_SQUEEZE 1.2f  // determines crowding, 1.2 = 5 divisions
+#define DEFAULT_SCOOT  0.0f  // multiplied by zero par to adjust
+#define AUTO_CYCLE_CNT 10 // number of cycles for auto squeeze/scoot calc
+#define AUTO_SCOOT_HOLD 2 // last cycles that adjust squeeze alone
+#define AUTO_EPSILON 0.000005 // converged once a cycle moves neither by this much (5 usec of scoot)
+#define AUTO_DIVERGE_CNT 3 // growing cycles in a row before the early stop is off
+#define AUTO_SCOOT_FRACTION 5 // 1/x of submissions used for auto scoot
+#define SUB_DIVISION_RANGE (1.0f/3.0f)
+#define RATING_WEIGHT_CAP 5 // rating weight cap
+#define MIN_PROMOTION_EVENT_COUNT 4 // minimum events completed prior to promo
+#define NO_HARM_HANDICAP TRUE // prevent submission from harming handicap
+
+#define NULL_PLAYER 0 // "safe" non-player ID
+#define INDEX_EMPTY NULL_PLAYER // player 0 is never indexed
+#define INDEX_DELETED ((unsigned)-1)
+#define INDEX_MIN_SIZE 1024 // initial hash index slot count
+#define EVENT_QUALIFIER 0 // week 0 is qualifier
+
+#define GTP_TAG "GTP"
+#define DEFAULT_DB_NAME "gt7wrs.wdb"
+#define DB_JOURNAL_EXT ".jnl" // dbfile + this: changed players since the snapshot
+#define DB_JOURNAL_RATIO 2 // compact once the journal passes 1/x of the snapshot
+#define DB_JOURNAL_COMMIT "# WRS COMMIT" // ends each batch of the journal
+#define DB_BIN_MAGIC "WRSDBIN" // binary snapshot, with its null: 8 bytes
+#define DB_BIN_VERSION 1
+#define DB_BIN_ORDER 0x01020304u // as written, to catch a foreign byte order
+#define DB_FIXED6_NEG_ZERO INT64_MIN // "-0.000000"
+#define DB_FIXED6_MAX 9007199254.0 // 2^53 millionths: exact in a double
+#define DB_READ_CHUNK_MIN (4 << 20) // smallest text DB chunk given its own thread
+#define DB_READ_THREADS_MAX 64
+#define DB_WRITE_BATCH 4096 // players each thread formats per write
+#define TRACE_PHASES_MAX 32 // distinct phase names totalled per trace
+#define TRACE_THREADS_MAX 64 // threads told apart in a trace
+
+/************************************************/
+/* enum types */
+
+typedef enum {
+    RUN_MODE_EVENT, // normal mode
+    RUN_MODE_QUALIFIER, // TBD
+    RUN_MODE_REPORT, // check DB for promotions
+    RUN_MODE_DB_FIX, // fix DB weight, etc
+} run_mode_e;
+
+typedef enum {
+    SUB_DIV_GOLD,
+    SUB_DIV_SILVER,
+    SUB_DIV_BRONZE
+} sub_div_e;
+
+typedef enum {
+    SHOW_NONE,
+    SHOW_ALL_TIMES,
+    SHOW_FLAGS,
+    SHOW_RATINGS,
+    SHOW_RATING_DELTA,
+} display_opt_e;
+
+typedef enum {
+    EXPORT_NONE,
+    EXPORT_JSONL, // one JSON object per line
+    EXPORT_CSV,   // one header line, then one row per record
+} export_format_e;
+
+typedef enum {
+    // error
+    LABEL_NONE,
+    // general
+    LABEL_COMMENT,
+    // event
+    LABEL_WEEK,
+    LABEL_SEASON,
+    LABEL_SEASON_RACE,
+    LABEL_EVENT_STATUS,   // provisional/final result (only save final)
+    LABEL_CAR,
+    LABEL_TRACK,
+    LABEL_DESC,
+    LABEL_OUTFILE,
+    LABEL_STATFILE,
+    LABEL_SHAPE,  // par curve shape
+    LABEL_GOLD_SHIFT,  // trophy curve shift
+    LABEL_SQUEEZE,  // par scaling
+    LABEL_SCOOT,    // zero par adjust
+    LABEL_WEIGHT,   // rating weight
+    LABEL_NOTE,   // WRS admin comments field
+    LABEL_IMAGE,   // Images in report
+    LABEL_REPORT,  // Evaluate DB for promotions
+    LABEL_DB_FIX,  // Fix DB
+    // submission/player
+    LABEL_USER,
+    LABEL_NAME,
+    LABEL_PSN,
+    LABEL_COUNTRY,
+    LABEL_TIME,
+    LABEL_TOTAL, // alias for TIME
+    LABEL_SPLIT,
+    LABEL_SECTOR, // alias for SPLIT
+    LABEL_M3, // M3 label, for GT6 qualifier
+    LABEL_MEGANE, // MEGANE label, for GT6 qualifier
+    LABEL_STATUS,
+    LABEL_DISQ,   // alias for LABEL_STATUS
+    // player
+    LABEL_PLAYER_ID, 
+    LABEL_DIV,
+    LABEL_SUB_DIV,
+    LABEL_RATING,
+    LABEL_REAL_RATING,
+    LABEL_EVENT_CNT,
+    LABEL_DQ_CNT,
+    LABEL_VERIFIED_CNT,
+    // player submodes
+    LABEL_QUALIFIER,
+    LABEL_HISTORY,
+    // count of labels
+    LABEL_ENUM_COUNT
+} label_e;
+
+typedef enum {
+    STATUS_NONE, // unset
+    STATUS_PROVISIONAL,
+    STATUS_FINAL,
+} event_status_e;
+
+typedef enum {
+    DQ_OK, // not a DQ... unchecked but assumed ok
+    DQ_SUBMITTED, // not a DQ... replay submitted but not checked
+    DQ_VERIFIED, // not a DQ... verified
+    DQ_OFF_TRACK, // more than 2 wheels off track
+    DQ_CONTACT, // racer hit wall or car
+    DQ_NO_REPLAY, // racer did not provide requested replay
+    DQ_TIME_ERROR, // splits do not add up to final time
+    DQ_NAME_VIOLATION, // name or tag is not appropriate
+    DQ_CUSTOM_VIOLATION, // custom violation, attitude, publicly revealing times, etc
+} dq_reason_e;
+
+typedef enum {
+    FLAG_GREEN,
+    FLAG_RED,
+    FLAG_BLACK,
+} flag_url_e;
+
+typedef enum {
+    ITER_DQ_ALL, // return all entries
+    ITER_DQ_OK, // return only good entries
+    ITER_DQ_BAD, // return only bad entries
+} dq_iter_e;
+
+// what collate_update() had to redo for one entry change
+typedef enum {
+    RECALC_NONE,  // same place in every list, only the entry's flag changed
+    RECALC_LISTS, // a disqualified entry moved, stats are untouched
+    RECALC_FULL,  // the good entries changed: stats, par and auto adjust again
+} recalc_e;
+
+// hot-path counters, see counter_flush()
+typedef enum {
+    COUNTER_LABEL_LOOKUP,     // label_lookup() calls
+    COUNTER_LABEL_MISS,       // of those, LABEL_NONE
+    COUNTER_LABEL_PARSE_FAIL, // "Failed label parse" in event files
+    COUNTER_PSN_LOOKUP,       // player lookups by PSN
+    COUNTER_PSN_PROBE,        // index slots they scanned
+    COUNTER_NAME_LOOKUP,      // player lookups by user name
+    COUNTER_NAME_PROBE,
+    COUNTER_PROBE_MAX,        // longest scan of one lookup (a maximum)
+    COUNTER_ENTRY_NEXT,       // entry_get_next() calls
+    COUNTER_ENTRY_VISIT,      // list nodes they visited
+    COUNTER_TIME_TO_USEC,     // time_to_usec() conversions
+    COUNTER_AUTO_CYCLE,       // auto_adjust() iterations
+    COUNTER_HISTORY_SWAP,     // db_update() history swaps
+    COUNTER_ENUM_COUNT
+} counter_e;
+
+/************************************************/
+/* data types */
+
+typedef struct {
+    unsigned min;
+    unsigned sec;
+    unsigned msec;
+    double time;
+} ttime_t;
+
+typedef struct _str_view {
+    char *ptr; // not null terminated
+    int len;
+} str_view_t;
+
+typedef struct _race_result {
+    unsigned    race_id; // week
+    unsigned    status; // provisional/final
+    unsigned    points; // season points for a race
+    dq_reason_e dq;
+    double      rating;
+    double      weight;
+} race_result_t;
+
+typedef struct _player {
+    unsigned        id;             // unique ID
+    unsigned        valid;
+    unsigned        dirty;          // changed since the DB was read or saved
+    char            name[MAX_NAME_LEN]; // GTPlanet user name
+    char            psn[MAX_NAME_LEN]; // screen "GTP tag" name
+    char            country[MAX_NAME_LEN]; // residence of user
+    double          real_rating;
+    double          rating;
+    double          total_weight;
+    unsigned        div;     // division 1-5
+    unsigned        sub_div; // gold/silver/bronze
+    unsigned        event_count;
+    unsigned        dq_count; // count of DQ incidences
+    unsigned        verified_count; // count of verified replays
+    unsigned        history_count; // count of events in history
+    race_result_t   qualifier;
+    race_result_t   history[RACE_HISTORY];
+    race_result_t   season[MAX_SEASON_LENGTH];
+    race_result_t   latest;
+} player_t;
+
+typedef struct _player_iter {
+    struct _player_db *db;
+    unsigned idx;
+} player_iter_t;
+
+// chunked pool: elements never move once allocated, so pointers into the
+// pool stay valid as it grows, and only chunks actually used are allocated
+typedef struct _pool {
+    char **chunk;       // chunk directory
+    unsigned chunk_cnt; // directory size
+    size_t elem_size;
+} pool_t;
+
+// growable byte buffer for text formatted away from stdio
+typedef struct _buf {
+    char *data;
+    size_t len;
+    size_t size;
+    int failed; // an append ran out of memory; sticky until buf_free()
+} buf_t;
+
+// one run of a phase, from trace_begin() to trace_end()
+typedef struct _trace_span {
+    const char *name; // 0 when not tracing
+    double wall;      // monotonic s at the start
+    double cpu;       // thread CPU s at the start
+} trace_span_t;
+
+// what a trace adds up per phase name
+typedef struct _trace_total {
+    const char *name;
+    unsigned count;
+    double wall;
+    double cpu;
+    int64_t bytes;
+    int64_t items;
+} trace_total_t;
+
+// phase timing: wall and CPU time, bytes and items of each phase, totalled
+// and optionally kept as Chrome trace events.  Hung off the player DB, so
+// every context rated against it reports to the same trace
+typedef struct _trace {
+    pthread_mutex_t lock;
+    FILE *file;     // Chrome trace-event JSON, 0 for the totals only
+    buf_t events;   // the events so far, written out by trace_free()
+    double start;   // monotonic s at trace_create()
+    pthread_t thread[TRACE_THREADS_MAX]; // trace thread id - 1
+    unsigned thread_cnt;
+    trace_total_t total[TRACE_PHASES_MAX];
+    unsigned total_cnt;
+} trace_t;
+
+typedef struct _index_slot {
+    unsigned id;   // player id, INDEX_EMPTY or INDEX_DELETED
+    unsigned hash; // cached key hash
+} index_slot_t;
+
+// binary DB snapshot (db_write_binary()): a header, then player, history
+// and string tables of fixed size records, read straight from the mapped
+// file.  Host byte order.  Numbers are kept in millionths, exactly as the
+// text DB prints them, so converting either way is lossless
+typedef struct _db_bin_race {
+    int64_t  rating;  // millionths
+    int64_t  weight;
+    uint32_t race_id;
+    uint16_t status;  // STATUS_NONE: no race
+    uint16_t dq;
+} db_bin_race_t;
+
+typedef struct _db_bin_player {
+    uint32_t id;
+    uint32_t name;    // string table offsets
+    uint32_t psn;
+    uint32_t country;
+    int64_t  rating;  // millionths
+    int64_t  real_rating;
+    int64_t  total_weight;
+    uint32_t div;
+    uint32_t sub_div;
+    uint32_t event_count;
+    uint32_t dq_count;
+    uint32_t verified_count;
+    uint32_t history;     // first row in the history table
+    uint32_t history_cnt;
+    uint32_t reserved;
+    db_bin_race_t qualifier;
+} db_bin_player_t;
+
+typedef struct _db_bin_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t order;
+    uint32_t header_size; // sizes as written: later versions only add fields at the end
+    uint32_t player_size;
+    uint32_t race_size;
+    uint32_t player_cnt;
+    uint32_t history_cnt;
+    uint32_t reserved;
+    uint64_t player_off;  // offsets from the start of the snapshot
+    uint64_t history_off;
+    uint64_t string_off;
+    uint64_t string_size;
+    uint64_t total_size;  // of the snapshot; journal text may follow
+} db_bin_header_t;
+
+// open-addressing hash index on a player_t string field
+typedef struct _player_index {
+    index_slot_t *slot;
+    unsigned size;  // slot count, power of 2
+    unsigned used;  // live + deleted slots
+    size_t key;     // offset of key field in player_t
+} player_index_t;
+
+typedef struct _player_link {
+    player_t *player;
+} player_link_t;
+
+typedef struct _entry {
+    unsigned    player_id;
+    player_t    *player; // cached player_get(player_id)
+    dq_reason_e dq;
+    ttime_t     time;
+    ttime_t     split[MAX_SPLITS];
+    int         prov_div;
+    int         overall_place;
+    int         place;
+    int         points;
+    double      hcp_delta;
+    double      rating;
+} entry_t;
+
+typedef struct _entry_link {
+    struct _entry_link *next;
+    entry_t     *entry;
+} entry_link_t;
+
+typedef struct _time_key {
+    unsigned key; // sort key from msec time
+    entry_t *entry;
+} time_key_t;
+
+typedef struct _rating_key {
+    double key;   // rating delta against handicap
+    unsigned seq; // position in input, keeps ties stable
+    entry_t *entry;
+} rating_key_t;
+
+typedef struct _entry_iter {
+    int div;
+    dq_iter_e dq;
+    entry_link_t *cur;
+    entry_t **pos; // set when walking div_index instead of a list
+    entry_t **end;
+} entry_iter_t;
+
+// entries of the overall list grouped by division, then by dq class, each
+// group in time order.  group DIV_ALL holds every entry.  ms[] and hcp[]
+// are columns parallel to entry[] for the stats kernels; div[] and div_pos[]
+// are per DIV_ALL row (the first entry_cnt rows).
+typedef struct _div_index {
+    entry_t **entry;
+    int64_t *ms;        // entry time in msec
+    double *hcp;        // hcp_delta, filled in by rate_times()
+    unsigned char *div; // prov_div
+    unsigned *div_pos;  // row of the same entry in its division group
+    unsigned size;  // capacity of entry[]
+    unsigned start[DIV_COUNT+1][2]; // [div][0 = ok, 1 = bad]
+    unsigned count[DIV_COUNT+1][2];
+    int valid;
+} div_index_t;
+
+typedef struct _stat {
+    unsigned count;
+    ttime_t mean;
+    ttime_t par; // min time for division
+    ttime_t gold;
+    ttime_t silver;
+    ttime_t bronze; // max time for division
+    double std_dev;
+    ttime_t q_mean; // mean of best half (overall) or range selection
+    double q_std_dev; // standard deviation of best half
+    unsigned perf[3]; // <, =, > relative div count
+    double hcp_delta; // average handicap delta
+} stat_t;
+
+typedef struct _event {
+    int week;
+    int season;
+    int season_race;
+    event_status_e status;
+    double *par_multiple; 
+    double *trophy_multiple; 
+    double squeeze; 
+    double scoot; 
+    double weight; 
+    int auto_squeeze;
+    int auto_scoot;
+    char car[MAX_STR_LEN];
+    char track[MAX_STR_LEN];
+    char description[MAX_STR_LEN];
+    char outfile[MAX_STR_LEN];
+    char statfile[MAX_STR_LEN];
+    char img[MAX_IMAGES][MAX_STR_LEN];
+    char comment[MAX_STR_LEN];
+} event_t;
+
+// db_read_player() state carried from one DB line to the next.  each chunk
+// of a text DB parsed in parallel has its own
+typedef struct _db_reader {
+    struct _player_db *db;
+    player_t *player; // player of the last Player_id line
+    int history;      // and its last history row
+    pthread_mutex_t *lock; // set for a parallel chunk: guards the pool and counts
+    int *abort;       // parallel chunks: set once an id repeats, to reread serially
+} db_reader_t;
+
+// the player DB
+typedef struct _player_db {
+    pool_t pool;
+    int player_cnt;
+    int max_player_id;
+    player_index_t psn_index;
+    player_index_t name_index;
+    db_reader_t reader;    // db_read_player(): the serial reader
+    size_t journal_len;    // committed bytes of the journal, as db_journal_replay() found it
+    int binary;            // read from a binary snapshot, so saved as one
+    trace_t *trace;        // phase timing, 0 when off
+} player_db_t;
+
+// evaluation context: one event, its entries and their stats, rated against
+// a player DB.  contexts share nothing but the DB, so any number can be
+// evaluated at once; from several threads only while the DB isn't changing
+// (scan_event() adds and renames players, so scan serially, then copy)
+typedef struct _context {
+    player_db_t *db;
+    FILE *echo; // console copy of results and settings, 0 for none
+    run_mode_e run_mode;
+    event_t event;
+    pool_t entry_pool;
+    pool_t time_sort;
+    pool_t rating_sort;
+    unsigned entry_cnt;
+    entry_link_t *ov_head;
+    entry_link_t *rat_head;
+    div_index_t div_index;
+    stat_t div_stat[DIV_COUNT+1];
+    stat_t ostat;
+    double scoot_start;   // event.scoot/squeeze before auto_adjust() moved them
+    double squeeze_start;
+    double custom_par_multiple[DIV_COUNT+2];
+    double custom_trophy_adjust[DIV_COUNT+2];
+    player_link_t *p_sort;
+    unsigned p_sort_size;
+    unsigned p_bucket[DIV_COUNT+1][SUB_DIV_BRONZE+1]; // start of each p_sort bucket
+} context_t;
+
+/************************************************/
+/* tables (wrsort.c) */
+extern char g_label[][MAX_NAME_LEN];
+
+// hot-path counters: each thread counts into its own, so counting takes no
+// lock.  Build with -DWRSORT_NO_COUNTERS to leave them out
+#ifdef WRSORT_NO_COUNTERS
+#define COUNT(c, n) ((void)(n))
+#define COUNT_MAX(c, v) ((void)(v))
+#else
+extern __thread uint64_t g_thread_counter[COUNTER_ENUM_COUNT];
+#define COUNT(c, n) (g_thread_counter[c] += (n))
+#define COUNT_MAX(c, v) ((void)(g_thread_counter[c] < (uint64_t)(v) && (g_thread_counter[c] = (v))))
+#endif
+
+/************************************************/
+/* calls (wrsort.c) */
+
+// player DB and evaluation contexts
+player_db_t *player_db_create(void);
+void player_db_free(player_db_t *db);
+void init_players(player_db_t *db);
+context_t *context_create(player_db_t *db);
+void context_free(context_t *ctx);
+void context_copy(context_t *ctx, context_t *src);
+void init_event(context_t *ctx);
+
+// byte buffers
+int buf_reserve(buf_t *buf, size_t n);
+int buf_printf(buf_t *buf, const char *fmt, ...);
+int buf_flush(buf_t *buf, FILE *file);
+void buf_free(buf_t *buf);
+int buf_append(buf_t *buf, const char *str, size_t len);
+int buf_put_str(buf_t *buf, const char *str);
+int buf_put_int(buf_t *buf, int64_t val);
+int buf_put_char(buf_t *buf, char c);
+int buf_put_pad(buf_t *buf, unsigned val, int width);
+int buf_put_time(buf_t *buf, ttime_t *time);
+int buf_put_fixed(buf_t *buf, double x, int decimals);
+
+// numeric codecs
+int num_parse_int(char *str, char **end);
+double num_parse_double(char *str, char **end);
+char *num_format_int(char *out, int64_t val);
+int64_t num_fixed(double x, int decimals);
+char *num_format_fixed(char *out, double x, int decimals);
+char *num_format_pad(char *out, unsigned val, int width);
+
+// phase tracing
+trace_t *trace_create(FILE *file);
+void trace_free(trace_t *trace, FILE *summary);
+void trace_begin(trace_t *trace, trace_span_t *span, const char *name);
+void trace_end(trace_t *trace, trace_span_t *span, int64_t bytes, int64_t items);
+
+// hot-path counters
+void counter_flush(void);
+void counter_report(FILE *file, int json);
+
+// players and entries
+int dq_ok(dq_reason_e dq);
+dq_reason_e dq_parse(char *ptr);
+player_t *player_get(player_db_t *db, unsigned id);
+player_t *player_lookup_by_psn(player_db_t *db, char *psn);
+player_t *player_get_first(player_db_t *db, player_iter_t *iter);
+player_t *player_get_next(player_iter_t *iter);
+unsigned player_is_rookie(player_db_t *db, unsigned id);
+entry_t *entry_get(context_t *ctx, unsigned idx);
+entry_t *entry_find(context_t *ctx, entry_t *entry);
+unsigned entry_div(entry_t *entry);
+int entry_index(context_t *ctx, unsigned player_id);
+void entry_remove(context_t *ctx, unsigned idx);
+entry_t *entry_get_first(context_t *ctx, entry_iter_t *iter, entry_link_t *head, int div, dq_iter_e dq);
+entry_t *entry_get_next(entry_iter_t *iter);
+int time_to_usec(ttime_t *t);
+char *time_display(char *out, ttime_t *time);
+
+// event files
+label_e label_get(char *string);
+char *label_skip(char *str);
+int event_process_line(context_t *ctx, char *line, entry_t *entry);
+int scan_event(context_t *ctx, FILE *file);
+void collate_stats(context_t *ctx);
+recalc_e collate_update(context_t *ctx, unsigned player_id, entry_t *next);
+
+// DB files
+int db_read_mapped(player_db_t *db, char *base, size_t size);
+int db_read_chunked(player_db_t *db, char *base, size_t size, unsigned threads);
+int db_read_image(player_db_t *db, char *base, size_t size);
+int64_t db_fixed6(double x);
+double db_fixed6_double(int64_t m);
+size_t db_bin_size(char *base, size_t size);
+int db_read_binary(player_db_t *db, char *base, size_t size);
+int db_write_binary(player_db_t *db, FILE *file);
+int db_load(player_db_t *db, int fd);
+int db_format_player(buf_t *out, player_t *player);
+int db_write_player(FILE *file, player_t *player);
+int db_write(player_db_t *db, FILE *file);
+int db_write_threads(player_db_t *db, FILE *file, unsigned threads);
+int db_reload(player_db_t *db);
+char *db_journal_name(char *out, char *dbfilename);
+size_t db_journal_committed(char *base, size_t size);
+int db_journal_replay(player_db_t *db, char *dbfilename);
+int db_save(player_db_t *db, char *dbfilename, int journal);
+void db_update(context_t *ctx);
+void fix_all_weight(player_db_t *db, FILE *echo);
+
+// output
+void dump_qualifier(context_t *ctx, FILE *file);
+void dump_event(context_t *ctx, FILE *file);
+void dump_stats(context_t *ctx, FILE *file, int detail);
+void dump_promotion_report(context_t *ctx, FILE *file, int detail);
+export_format_e export_format(char *name);
+void dump_export_header(FILE *file, export_format_e format);
+void dump_export(context_t *ctx, FILE *file, export_format_e format);
+
+/************************************************/
+/* calls (wrmain.c, wrdaemon.c) */
+void usage();
+int daemon_main(int argc, char **argv);
+
+#endif /* WRSORT_H */